@@ -1,10 +1,21 @@
-
 #include <benchmark/benchmark.h>
 
 #include "app/facade.hpp"
+#include "hardware/batch_executor.hpp"
+#include "hardware/brain.hpp"
+#include "hardware/command_config.hpp"
+#include "hardware/compile_args.hpp"
+#include "hardware/compiler.hpp"
+#include "hardware/hardware_manager.hpp"
+#include "hardware/machine_code.hpp"
+#include "hardware/optimizer.hpp"
+#include "hardware/parser.hpp"
+#include "hardware/program_executor.hpp"
+#include "utils/thread_pool.hpp"
 
 static void run_save(benchmark::State& state, std::string const& filename) {
-    ProjectArguments config("", "../assets/saves/" + filename, false, false, true);
+    ProjectArguments config("", "../assets/saves/" + filename, "", "", false,
+                            false, true);
     AntGameFacade game(config);
     for(auto _ : state) {
         for(ulong i = 0; i < 600; ++i) {
@@ -26,6 +37,297 @@ static void run_counter(benchmark::State& state) {
 BENCHMARK(run_mid);
 // BENCHMARK(run_counter);
 
+static std::vector<std::string> const bench_program = {
+    "LOAD A 1000",  //
+    "top:",         //
+    "LT",           //
+    "RT",           //
+    "INC B",        //
+    "COPY B A",     //
+    "CHK",          //
+    "DEC A",        //
+    "JNZ top",      //
+    "MOVE",         //
+    "JMP top",      //
+};
+
+static MachineCode parse_bench_program(CommandMap const& command_map) {
+    Parser parser(command_map);
+    MachineCode code;
+    Status status;
+    parser.parse(bench_program, code, status);
+    return code;
+}
+
+// Runs a single program executor without the job pool or the map so that
+// only instruction dispatch is measured. Sync instructions are executed
+// directly as if the sync phase ran every tick.
+static void run_executor(benchmark::State& state, ExecutionMode mode) {
+    CommandMap command_map;
+    Compiler compiler(command_map);
+    MachineCode code = parse_bench_program(command_map);
+
+    ulong instr_clock = 0;
+    DualRegisters cpu;
+    ThreadPool<AsyncProgramJob> job_pool(1);
+    ProgramExecutor executor(instr_clock, 500, cpu.instr_ptr_register,
+                             job_pool);
+    DecodedProgram program;
+    CompileArgs args(code.code, cpu, executor._ops);
+    if(mode == ExecutionMode::DECODED) {
+        args.instructions = &program.instructions;
+    }
+    compiler.compile(args);
+    if(args.is_decoded()) {
+        program.build_blocks();
+        executor.use_decoded(cpu, program);
+    }
+
+    ulong num_instructions = 0;
+    for(auto _ : state) {
+        num_instructions += executor.run_async();
+        if(cpu.instr_ptr_register < executor.size()) {
+            executor.execute();
+            ++num_instructions;
+        }
+        cpu.is_move_flag = false;
+    }
+    state.counters["instructions"] = benchmark::Counter(
+        static_cast<double>(num_instructions), benchmark::Counter::kIsRate);
+}
 
+static void run_closure_executor(benchmark::State& state) {
+    run_executor(state, ExecutionMode::CLOSURE);
+}
+static void run_decoded_executor(benchmark::State& state) {
+    run_executor(state, ExecutionMode::DECODED);
+}
+BENCHMARK(run_closure_executor);
+BENCHMARK(run_decoded_executor);
+
+// Same as run_executor for state.range(0) ants sharing one program - one
+// iteration is one tick of the whole colony on the calling thread. The ants
+// see different surroundings so CHK results differ between them.
+static void run_colony(benchmark::State& state, ExecutionMode mode) {
+    CommandMap command_map;
+    Compiler compiler(command_map);
+    MachineCode code = parse_bench_program(command_map);
+
+    DualRegisters decode_cpu;
+    std::vector<Op> unused_ops;
+    DecodedProgram program;
+    CompileArgs args(code.code, decode_cpu, unused_ops, program.instructions);
+    compiler.compile(args);
+    program.build_blocks();
+
+    ulong const num_ants = static_cast<ulong>(state.range(0));
+    ulong instr_clock = 0;
+    ThreadPool<AsyncProgramJob> job_pool(1);
+    std::vector<DualRegisters> cpus(num_ants);
+    std::vector<std::unique_ptr<ProgramExecutor>> executors;
+    for(ulong i = 0; i < num_ants; ++i) {
+        cpus[i].is_space_empty_flags = static_cast<uchar>(i % 16);
+        executors.push_back(std::make_unique<ProgramExecutor>(
+            instr_clock, 500, cpus[i].instr_ptr_register, job_pool));
+        executors.back()->use_decoded(cpus[i], program);
+    }
+
+    BatchExecutor batch_executor;
+    ulong num_instructions = 0;
+    for(auto _ : state) {
+        batch_executor.clear();
+        for(auto& executor : executors) {
+            if(!executor->begin_async()) continue;
+            if(mode == ExecutionMode::BATCH) {
+                batch_executor.add(*executor);
+            } else {
+                num_instructions += executor->run_async();
+            }
+        }
+        for(ProgramBatch& batch : batch_executor) {
+            batch.run();
+            num_instructions += batch.num_executed;
+        }
+        for(ulong i = 0; i < num_ants; ++i) {
+            if(cpus[i].instr_ptr_register < executors[i]->size()) {
+                executors[i]->execute();
+                ++num_instructions;
+            }
+            executors[i]->instr_trigger = 0;
+            cpus[i].is_move_flag = false;
+        }
+    }
+    state.counters["instructions"] = benchmark::Counter(
+        static_cast<double>(num_instructions), benchmark::Counter::kIsRate);
+}
+
+static void run_decoded_colony(benchmark::State& state) {
+    run_colony(state, ExecutionMode::DECODED);
+}
+static void run_batch_colony(benchmark::State& state) {
+    run_colony(state, ExecutionMode::BATCH);
+}
+BENCHMARK(run_decoded_colony)->Arg(1000)->Arg(10000);
+BENCHMARK(run_batch_colony)->Arg(1000)->Arg(10000);
+
+// 1000 boxed in ants polling CHK for a free space that never shows up - one
+// iteration is one tick. state.range(0) switches parking of ants stuck in a
+// cycle off (0) or on (1).
+static void run_polling_colony(benchmark::State& state) {
+    std::vector<std::string> const lines = {
+        "top:", "CHK", "JNF go", "JMP top", "go:", "MOVE", "JMP top",
+    };
+    CommandMap command_map;
+    Parser parser(command_map);
+    Compiler compiler(command_map);
+    MachineCode code;
+    Status status;
+    parser.parse(lines, code, status);
+
+    DualRegisters decode_cpu;
+    std::vector<Op> unused_ops;
+    DecodedProgram program;
+    CompileArgs args(code.code, decode_cpu, unused_ops, program.instructions);
+    compiler.compile(args);
+    program.build_blocks();
+
+    ulong const num_ants = 1000;
+    ulong instr_clock = 0;
+    ThreadPool<AsyncProgramJob> job_pool(1);
+    std::vector<DualRegisters> cpus(num_ants);
+    std::vector<std::unique_ptr<ProgramExecutor>> executors;
+    for(ulong i = 0; i < num_ants; ++i) {
+        cpus[i].is_space_empty_flags = 0;
+        executors.push_back(std::make_unique<ProgramExecutor>(
+            instr_clock, 500, cpus[i].instr_ptr_register, job_pool));
+        executors.back()->use_decoded(cpus[i], program);
+        executors.back()->is_parking_enabled = state.range(0) != 0;
+    }
+
+    for(auto _ : state) {
+        for(auto& executor : executors) {
+            executor->reset();
+            if(executor->begin_async()) executor->run_async();
+            executor->execute_sync();
+        }
+    }
+}
+BENCHMARK(run_polling_colony)->Arg(0)->Arg(1);
+
+// One tick of 10000 ants through HardwareManager and the job pool like
+// PrimaryMode::update with state.range(0) executors per job - 0 picks the
+// span adaptively. A span of 1 is one job per ant.
+static void run_job_spans(benchmark::State& state) {
+    CommandMap command_map;
+    HardwareManager hardware_manager(command_map);
+    hardware_manager.set_job_span(static_cast<ulong>(state.range(0)));
+    MachineCode code = parse_bench_program(command_map);
+    Status status;
+    DecodedProgram const* program = hardware_manager.get_program(code, status);
+
+    ulong const num_ants = 10000;
+    ulong instr_clock = 0;
+    ThreadPool<AsyncProgramJob> job_pool(4);
+    std::vector<DualRegisters> cpus(num_ants);
+    std::vector<std::unique_ptr<ProgramExecutor>> executors;
+    for(ulong i = 0; i < num_ants; ++i) {
+        cpus[i].is_space_empty_flags = static_cast<uchar>(i % 16);
+        executors.push_back(std::make_unique<ProgramExecutor>(
+            instr_clock, 50, cpus[i].instr_ptr_register, job_pool));
+        executors.back()->use_decoded(cpus[i], *program);
+        hardware_manager.push_back(executors.back().get());
+    }
+
+    for(auto _ : state) {
+        hardware_manager.begin_tick();
+        for(ProgramExecutor* exec : hardware_manager.ready()) exec->reset();
+        hardware_manager.execute_async_spans(job_pool);
+        job_pool.await_jobs();
+        for(ProgramExecutor* exec : hardware_manager.ready()) {
+            exec->execute_sync();
+        }
+        hardware_manager.end_tick();
+    }
+}
+BENCHMARK(run_job_spans)
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(16)
+    ->Arg(64)
+    ->Arg(256)
+    ->Arg(1024)
+    ->Arg(0)
+    ->UseRealTime();
+
+// One iteration runs the program once around its outer loop: the async
+// inner loop up to the MOVE and the MOVE itself. Fused instructions execute
+// fewer dispatches per iteration, so compare the time per iteration.
+static void run_optimizer(benchmark::State& state, OptimizerPasses passes) {
+    std::vector<std::string> const lines = {
+        "top:",       //
+        "LOAD A 50",  //
+        "loop:",      //
+        "LT",         //
+        "LT",         //
+        "PUSH B",     //
+        "POP B",      //
+        "INC B",      //
+        "CHK",        //
+        "DEC A",      //
+        "JNZ loop",   //
+        "LOAD A 1",   //
+        "JNZ hop",    //
+        "hop:",       //
+        "JMP out",    //
+        "out:",       //
+        "RT",         //
+        "MOVE",       //
+        "JMP top",    //
+    };
+    CommandMap command_map;
+    Parser parser(command_map);
+    Compiler compiler(command_map);
+    MachineCode code;
+    Status status;
+    parser.parse(lines, code, status);
+
+    ulong instr_clock = 0;
+    DualRegisters cpu;
+    ThreadPool<AsyncProgramJob> job_pool(1);
+    ProgramExecutor executor(instr_clock, 500, cpu.instr_ptr_register,
+                             job_pool);
+    DecodedProgram program;
+    CompileArgs args(code.code, cpu, executor._ops, program.instructions);
+    compiler.compile(args);
+    optimize(program.instructions, passes);
+    program.build_blocks();
+    executor.use_decoded(cpu, program);
+
+    for(auto _ : state) {
+        executor.run_async();
+        if(cpu.instr_ptr_register < executor.size()) executor.execute();
+        cpu.is_move_flag = false;
+    }
+}
+
+static OptimizerPasses only(bool OptimizerPasses::*pass) {
+    OptimizerPasses passes = OptimizerPasses::none();
+    passes.*pass = true;
+    return passes;
+}
+BENCHMARK_CAPTURE(run_optimizer, none, OptimizerPasses::none());
+BENCHMARK_CAPTURE(run_optimizer, fuse_turns,
+                  only(&OptimizerPasses::fuse_turns));
+BENCHMARK_CAPTURE(run_optimizer, fuse_turn_move,
+                  only(&OptimizerPasses::fuse_turn_move));
+BENCHMARK_CAPTURE(run_optimizer, fuse_counter_jumps,
+                  only(&OptimizerPasses::fuse_counter_jumps));
+BENCHMARK_CAPTURE(run_optimizer, fuse_push_pop,
+                  only(&OptimizerPasses::fuse_push_pop));
+BENCHMARK_CAPTURE(run_optimizer, fold_zero_flag,
+                  only(&OptimizerPasses::fold_zero_flag));
+BENCHMARK_CAPTURE(run_optimizer, thread_jumps,
+                  only(&OptimizerPasses::thread_jumps));
+BENCHMARK_CAPTURE(run_optimizer, all, OptimizerPasses());
 
 BENCHMARK_MAIN();
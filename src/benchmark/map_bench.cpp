@@ -0,0 +1,340 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <optional>
+
+#include "app/globals.hpp"
+#include "map/baked_world.hpp"
+#include "map/generator.hpp"
+#include "map/map.hpp"
+#include "map/pager.hpp"
+#include "map/world.hpp"
+#include "map/zone_grid.hpp"
+#include "utils/task_graph.hpp"
+#include "utils/thread_pool.hpp"
+
+namespace {
+// A map with every chunk of a size x size square around the origin built
+Map make_bench_map(long size) {
+    Map map(true, [](long, long) {});
+    map.dig(-size / 2, -size / 2, size / 2 - 1, size / 2 - 1);
+    return map;
+}
+
+// Cheap deterministic coordinates within [-size / 2, size / 2)
+struct CoordStream {
+    ulong state = 0x2545F4914F6CDD1Dul;
+    long size;
+    long next() {
+        state = state * 6364136223846793005ul + 1442695040888963407ul;
+        return static_cast<long>((state >> 33) % static_cast<ulong>(size)) -
+               size / 2;
+    }
+};
+}  // namespace
+
+// Column by column scan of a map window - what set_window_tiles does
+static void run_map_window_scan(benchmark::State& state) {
+    long const size = 120;
+    Map map = make_bench_map(size);
+    for(auto _ : state) {
+        ulong walls = 0;
+        for(long x = -size / 2; x < size / 2; ++x) {
+            for(long y = -size / 2; y < size / 2; ++y) {
+                walls += map.is_wall(x, y);
+            }
+        }
+        benchmark::DoNotOptimize(walls);
+    }
+    state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(run_map_window_scan);
+
+// The same scan through the read-only query - what the renderer does
+static void run_map_window_read(benchmark::State& state) {
+    long const size = 120;
+    Map const map = make_bench_map(size);
+    for(auto _ : state) {
+        ulong walls = 0;
+        for(long x = -size / 2; x < size / 2; ++x) {
+            for(long y = -size / 2; y < size / 2; ++y) {
+                walls += map.read_tile(x, y).is_wall;
+            }
+        }
+        benchmark::DoNotOptimize(walls);
+    }
+    state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(run_map_window_read);
+
+// The same window as row spans - a chunk lookup per chunk, not per tile
+static void run_map_window_spans(benchmark::State& state) {
+    long const size = 120;
+    Map const map = make_bench_map(size);
+    for(auto _ : state) {
+        ulong walls = 0;
+        map.read_spans(-size / 2, -size / 2, size / 2, size / 2,
+                       [&walls](ConstTileSpan const& span) {
+                           for(ulong offset = 0; offset < span.length;
+                               ++offset) {
+                               walls += span.snapshot(offset).is_wall;
+                           }
+                       });
+        benchmark::DoNotOptimize(walls);
+    }
+    state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(run_map_window_spans);
+
+// A tile and its four neighbours at scattered positions - the reads of a
+// Map::move_entity. state.range(0) is the side of the built square.
+static void run_map_neighbour_reads(benchmark::State& state) {
+    long const size = state.range(0);
+    Map map = make_bench_map(size);
+    CoordStream coords{.size = size - 2};
+    for(auto _ : state) {
+        long const x = coords.next(), y = coords.next();
+        ulong scents = map.get_tile_scents_by_coord(x, y);
+        scents += map.get_tile_scents_by_coord(x + 1, y);
+        scents += map.get_tile_scents_by_coord(x, y - 1);
+        scents += map.get_tile_scents_by_coord(x - 1, y);
+        scents += map.get_tile_scents_by_coord(x, y + 1);
+        benchmark::DoNotOptimize(scents);
+    }
+    state.SetItemsProcessed(state.iterations() * 5);
+}
+BENCHMARK(run_map_neighbour_reads)->Arg(64)->Arg(1024);
+
+// The same reads through a tile stencil - the other chunks come from the
+// center chunk's neighbour links, not the chunk table
+static void run_map_stencil_reads(benchmark::State& state) {
+    long const size = state.range(0);
+    Map map = make_bench_map(size);
+    CoordStream coords{.size = size - 2};
+    for(auto _ : state) {
+        long const x = coords.next(), y = coords.next();
+        TileStencil around = map.get_stencil(x, y);
+        ulong scents = around.tile(0, 0).scents();
+        scents += around.tile(1, 0).scents();
+        scents += around.tile(0, -1).scents();
+        scents += around.tile(-1, 0).scents();
+        scents += around.tile(0, 1).scents();
+        benchmark::DoNotOptimize(scents);
+    }
+    state.SetItemsProcessed(state.iterations() * 5);
+}
+BENCHMARK(run_map_stencil_reads)->Arg(64)->Arg(1024);
+
+// Bytes per chunk of a dug out map without entities, the chunk table
+// included - reported as counters, the time is that of Map::memory_usage
+static void run_map_memory(benchmark::State& state) {
+    long const size = 256;
+    Map map = make_bench_map(size);
+    ulong bytes = 0;
+    for(auto _ : state) {
+        bytes = map.memory_usage();
+        benchmark::DoNotOptimize(bytes);
+    }
+    ulong const num_chunks =
+        static_cast<ulong>(size * size / globals::CHUNK_AREA);
+    state.counters["bytes_per_chunk"] =
+        static_cast<double>(bytes) / static_cast<double>(num_chunks);
+    state.counters["chunk_bytes"] = static_cast<double>(sizeof(Chunk));
+}
+BENCHMARK(run_map_memory);
+
+// Evicting a column of chunks and exploring a new one - the arena recycles
+// the evicted chunks, so the slab count stays put once warm
+static void run_map_chunk_churn(benchmark::State& state) {
+    long const side = 32;  // chunks per column and columns kept
+    Chunks chunks;
+    long column = 0;
+    for(auto _ : state) {
+        long const x = column++ * globals::CHUNK_LENGTH;
+        chunks.erase_if([x](Chunk const& chunk) {
+            return chunk.x <= x - side * globals::CHUNK_LENGTH;
+        });
+        for(long y = 0; y < side; ++y) {
+            chunks.create(x, y * globals::CHUNK_LENGTH, true);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * side);
+    state.counters["slabs"] =
+        static_cast<double>(chunks.get_arena().num_slabs());
+}
+BENCHMARK(run_map_chunk_churn);
+
+// Paging every chunk of a map out and reading a tile of each back in
+static void run_map_paging(benchmark::State& state) {
+    long const size = 128;
+    Map map = make_bench_map(size);
+    map.enable_paging(
+        (std::filesystem::temp_directory_path() / "ants_bench_map.pages")
+            .string());
+    std::vector<Chunk*> cold;
+    for(auto _ : state) {
+        map.advance_access_clock();
+        cold.clear();
+        map.for_each_cold_chunk([&](Chunk& chunk) { cold.push_back(&chunk); });
+        map.page_out(cold);
+        ulong walls = 0;
+        for(long x = -size / 2; x < size / 2; x += globals::CHUNK_LENGTH) {
+            for(long y = -size / 2; y < size / 2; y += globals::CHUNK_LENGTH) {
+                walls += map.is_wall(x, y);
+            }
+        }
+        benchmark::DoNotOptimize(walls);
+    }
+    state.SetItemsProcessed(state.iterations() * size * size /
+                            globals::CHUNK_AREA);
+    ChunkPagerStats const stats = map.get_pager()->get_stats();
+    state.counters["page_outs"] = static_cast<double>(stats.page_outs);
+    state.counters["file_bytes"] = static_cast<double>(stats.file_bytes);
+}
+BENCHMARK(run_map_paging);
+
+// The section plans of the chunks in view while the player walks across
+// regions and back - what Regions::build_section looks up for every unbuilt
+// chunk. The regions are planned before the timing.
+static void run_map_section_lookup(benchmark::State& state) {
+    long const num_regions = 16;
+    long const view_w = 80, view_h = 48;
+    long const walk = num_regions * globals::WORLD_LENGTH;
+    Regions regions(7, 11);
+    for(long x = 0; x < walk + view_w; x += globals::WORLD_LENGTH) {
+        regions.region(x, 0);
+        regions.region(x, view_h);
+    }
+    long step = 0;
+    for(auto _ : state) {
+        long const player_x = step++ % (walk / globals::CHUNK_LENGTH) *
+                              globals::CHUNK_LENGTH;
+        ulong found = 0;
+        for(long x = player_x; x < player_x + view_w;
+            x += globals::CHUNK_LENGTH) {
+            for(long y = 0; y < view_h; y += globals::CHUNK_LENGTH) {
+                found += regions.section_plan(x, y, 0) != nullptr;
+            }
+        }
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(state.iterations() * view_w * view_h /
+                            globals::CHUNK_AREA);
+}
+BENCHMARK(run_map_section_lookup);
+
+// Planning the regions of a row west to east - the zone placement, the
+// section plans and their index of Region::do_blueprint_planning
+static void run_region_planning(benchmark::State& state) {
+    long x = 0;
+    for(auto _ : state) {
+        Region region = Regions::plan({x++, 0}, 7, 11);
+        benchmark::DoNotOptimize(region.plan_grid.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(run_region_planning);
+
+// The zone placement of a region planning on its own, with regions of
+// state.range(0) chunks per side - the regions are WORLD_LENGTH /
+// CHUNK_LENGTH = 32 chunks per side
+static void run_zone_placement(benchmark::State& state) {
+    ulong const length = static_cast<ulong>(state.range(0));
+    Peaceful_Cavern cavern;
+    std::vector<Zone_Placement> placed;
+    uint32_t seed = 0;
+    for(auto _ : state) {
+        ZoneGrid grid(length, globals::MAX_LEVEL_DEPTH);
+        std::vector<Zone*> shapes = {&cavern};
+        TCODRandom randomizer(seed++);
+        placed.clear();
+        Region::place_zones(grid, shapes, randomizer, placed);
+        benchmark::DoNotOptimize(placed.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["zones"] = static_cast<double>(placed.size());
+}
+BENCHMARK(run_zone_placement)->Arg(32)->Arg(64)->Arg(128);
+
+// Starting a world and loading the 3 x 3 regions around the origin on the
+// top level - state.range(0) loads them from a world baked beforehand
+// instead of generating them
+static void run_map_cold_start(benchmark::State& state) {
+    std::string const path =
+        (std::filesystem::temp_directory_path() / "ants_bench_world.bake")
+            .string();
+    BakeSpec spec;
+    spec.seed_x = 7;
+    spec.seed_y = 11;
+    if(state.range(0) != 0) {
+        ThreadPool<AsyncProgramJob> pool(default_thread_count());
+        BakedWorld::bake(path, spec, pool);
+    }
+    long const len = globals::WORLD_LENGTH;
+    for(auto _ : state) {
+        std::optional<MapWorld> world;
+        if(state.range(0) != 0) {
+            world.emplace(Rect(0, 0, 80, 48), true, BakedWorld::open(path));
+        } else {
+            world.emplace(Rect(0, 0, 80, 48), true, spec.seed_x, spec.seed_y);
+        }
+        world->levels[0].map.load_chunks(-len, -len, 2 * len, 2 * len);
+        benchmark::DoNotOptimize(world->levels[0].map.num_resident_chunks());
+    }
+    std::filesystem::remove(path);
+    state.SetItemsProcessed(state.iterations() * 9 * len * len /
+                            globals::CHUNK_AREA);
+}
+BENCHMARK(run_map_cold_start)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// A frame of walking the map window east into new sections, 2 tiles per
+// frame. state.range(0) turns the background generation on - without it the
+// window builds the sections it runs into on the spot. max_frame_ms is the
+// slowest frame, chunks what was generated - ahead of the window as well
+// with the background generation.
+static void run_map_explore_frames(benchmark::State& state) {
+    using Clock = std::chrono::steady_clock;
+    ThreadPool<AsyncProgramJob> pool(default_thread_count());
+    MapWorld world(Rect(0, 0, 80, 48), true, 7, 11);
+    if(state.range(0) != 0) world.enable_background_generation();
+    TaskGraph graph;
+    long x = 40;
+    double max_frame_ns = 0;
+    for(auto _ : state) {
+        Clock::time_point const start = Clock::now();
+        world.map_window.set_center(x, 24);
+        x += 2;
+        world.queue_sections_ahead();
+        graph.clear();
+        world.add_generation_tasks(graph);
+        graph.add(
+            "view",
+            [&world]() {
+                Rect const& border = world.map_window.border;
+                world.current_level().map.load_chunks(
+                    border.x1, border.y1, border.x2 + 1, border.y2 + 1);
+            },
+            {}, TaskGraph::Affinity::CALLER);
+        graph.run(pool);
+        world.load_generated_sections();
+        max_frame_ns = std::max(
+            max_frame_ns,
+            static_cast<double>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - start)
+                    .count()));
+    }
+    state.counters["max_frame_ms"] = max_frame_ns / 1e6;
+    state.counters["chunks"] =
+        static_cast<double>(world.current_level().map.num_resident_chunks());
+    if(SectionGenerator const* generator = world.get_generator()) {
+        SectionGeneratorStats const stats = generator->get_stats();
+        state.counters["mean_latency_ms"] = stats.mean_latency_ms();
+        state.counters["max_queue"] = static_cast<double>(stats.max_queue_depth);
+        state.counters["on_demand"] =
+            static_cast<double>(stats.built_on_demand);
+    }
+}
+BENCHMARK(run_map_explore_frames)->Arg(0)->Arg(1)->Iterations(2000);
@@ -0,0 +1,104 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+#include "utils/parallel.hpp"
+#include "utils/thread_pool.hpp"
+
+namespace {
+// A few hundred nanoseconds of work - about what a span of ant programs
+// costs per executor.
+struct SpinJob {
+    std::atomic<ulong>* counter = nullptr;
+    void run() {
+        ulong value = 0;
+        for(ulong i = 0; i < 200; ++i) benchmark::DoNotOptimize(value += i);
+        counter->fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+struct RangeJob {
+    ParallelRange const* range;
+    ulong job;
+    RangeJob(ParallelRange const& range, ulong job) : range(&range), job(job) {}
+    void run() { range->run_job(job); }
+};
+}  // namespace
+
+// CPU time the pool burns while it has nothing to do, as a fraction of one
+// core (idle_cores). One iteration is 20ms of wall time.
+static void run_pool_idle(benchmark::State& state) {
+    ThreadPool<SpinJob> pool(static_cast<ulong>(state.range(0)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    double cpu_seconds = 0, wall_seconds = 0;
+    for(auto _ : state) {
+        std::clock_t const cpu_start = std::clock();
+        auto const wall_start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        cpu_seconds +=
+            static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+        wall_seconds += std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - wall_start)
+                            .count();
+    }
+    state.counters["idle_cores"] = cpu_seconds / wall_seconds;
+}
+BENCHMARK(run_pool_idle)->Arg(4)->Arg(8)->UseRealTime();
+
+// One tick: submit state.range(0) jobs to a pool of state.range(1) threads
+// and wait for them like PrimaryMode::update does with the async program
+// jobs. The last thread count is default_thread_count(), what the game picks
+// for --threads auto.
+static void run_pool_tick(benchmark::State& state) {
+    ThreadPool<SpinJob> pool(static_cast<ulong>(state.range(1)));
+    std::atomic<ulong> counter = 0;
+    ulong const num_jobs = static_cast<ulong>(state.range(0));
+    for(auto _ : state) {
+        for(ulong i = 0; i < num_jobs; ++i) {
+            SpinJob job{&counter};
+            pool.submit_job(job);
+        }
+        pool.await_jobs();
+    }
+    state.counters["jobs"] = benchmark::Counter(
+        static_cast<double>(counter.load()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(run_pool_tick)
+    ->ArgsProduct({{16, 256, 4096},
+                   {0, 1, 2, 4, 8,
+                    static_cast<long>(default_thread_count())}})
+    ->ArgNames({"jobs", "threads"})
+    ->UseRealTime();
+
+// A 120x120 map window worth of tiles with a cost that grows along the
+// range, split with the partition state.range(0) (0 static, 1 dynamic) in
+// chunks of state.range(1) indices over 4 threads.
+static void run_parallel_for(benchmark::State& state) {
+    ThreadPool<RangeJob> pool(4);
+    Partition const partition =
+        state.range(0) == 0 ? Partition::STATIC : Partition::DYNAMIC;
+    ulong const grain = static_cast<ulong>(state.range(1));
+    ulong const num_tiles = 120 * 120;
+    std::vector<ulong> tiles(num_tiles);
+    for(auto _ : state) {
+        parallel_for(
+            pool, 0, num_tiles, grain,
+            [&](ulong idx) {
+                ulong value = tiles[idx];
+                for(ulong i = 0; i < idx / 512; ++i) {
+                    benchmark::DoNotOptimize(value += i);
+                }
+                tiles[idx] = value;
+            },
+            partition);
+    }
+    state.SetItemsProcessed(static_cast<long>(state.iterations() * num_tiles));
+}
+BENCHMARK(run_parallel_for)
+    ->ArgsProduct({{0, 1}, {64, 1024}})
+    ->ArgNames({"dynamic", "grain"})
+    ->UseRealTime();
@@ -1,37 +1,52 @@
 #include "app/arg_parse.hpp"
 
+#include <algorithm>
 #include <cctype>
 #include <chrono>
+#include <cstdlib>
 #include <filesystem>
 #include <iostream>
+#include <sstream>
+#include <utility>
 
 #include "spdlog/spdlog.h"
 // ArgumentParser
 // ============================================================================
 ArgumentParser::ArgumentParser() {}
-ArgumentParser::ArgumentParser(int argc, char* argv[]) {
-    for(int i = 1; i < argc; i += 2) {
+ArgumentParser::ArgumentParser(int argc, char* argv[])
+    : ArgumentParser(to_args(argc, argv)) {}
+
+ArgumentParser::ArgumentParser(std::vector<std::string> const& args) {
+    for(ulong i = 0; i < args.size(); ++i) {
+        std::string const& key = args[i];
         // Check if the argument is a key
-        if(argv[i][0] != '-' || argv[i][1] != '-') {
-            std::cerr << "Invalid argument key: " << argv[i] << std::endl;
+        if(key.size() < 2 || key[0] != '-' || key[1] != '-') {
+            std::cerr << "Invalid argument key: " << key << std::endl;
             exit(1);
         }
 
         // Check if the argument does not have a value
         // It doesn't have a value if it is the last argument or the next
         // argument is a key
-        if(i + 1 >= argc || argv[i + 1][0] == '-' || argv[i + 1][1] == '-') {
-            arguments[argv[i] + 2] = "1";
-            --i;  // decrement i so that the next iteration will not skip an
-                  // argument
+        if(i + 1 >= args.size() || args[i + 1].empty() ||
+           args[i + 1][0] == '-' ||
+           (args[i + 1].size() > 1 && args[i + 1][1] == '-')) {
+            arguments[key.substr(2)] = "1";
             continue;
         }
 
         // Add the key and value to the arguments map
-        arguments[argv[i] + 2] = argv[i + 1];
+        arguments[key.substr(2)] = args[++i];
     }
 }
 
+// Skips the program name
+std::vector<std::string> ArgumentParser::to_args(int argc, char* argv[]) {
+    std::vector<std::string> args;
+    for(int i = 1; i < argc; ++i) args.push_back(argv[i]);
+    return args;
+}
+
 bool ArgumentParser::hasKey(const std::string& key) const {
     return arguments.find(key) != arguments.end();
 }
@@ -93,8 +108,87 @@ static std::string resolve_save_path(const std::string& save_path) {
     return save_path;
 }
 
+static ExecutionMode parse_execution_mode(const std::string& executor) {
+    if(executor == "closure") return ExecutionMode::CLOSURE;
+    if(executor == "batch") return ExecutionMode::BATCH;
+    if(executor != "decoded") {
+        std::cerr << "Invalid executor: " << executor << std::endl;
+        exit(1);
+    }
+    return ExecutionMode::DECODED;
+}
+
+// "auto" lets HardwareManager size the spans by ant and thread count
+static ulong parse_job_span(const std::string& job_span) {
+    if(job_span == "auto") return 0;
+    char* end = nullptr;
+    long const span = std::strtol(job_span.c_str(), &end, 10);
+    if(end == job_span.c_str() || *end != '\0' || span <= 0) {
+        std::cerr << "Invalid job span: " << job_span << std::endl;
+        exit(1);
+    }
+    return static_cast<ulong>(span);
+}
+
+// "auto" leaves one hardware thread to the game loop, which helps with the
+// jobs. 0 runs every job inline on the game loop.
+static ulong parse_thread_count(const std::string& threads) {
+    if(threads == "auto") return default_thread_count();
+    char* end = nullptr;
+    long const count = std::strtol(threads.c_str(), &end, 10);
+    if(end == threads.c_str() || *end != '\0' || count < 0) {
+        std::cerr << "Invalid thread count: " << threads << std::endl;
+        exit(1);
+    }
+    return static_cast<ulong>(count);
+}
+
+// Accepts "all", "none" or a comma separated list of the passes to enable.
+static OptimizerPasses parse_optimizer_passes(const std::string& optimize) {
+    if(optimize == "all") return {};
+    OptimizerPasses passes = OptimizerPasses::none();
+    if(optimize == "none") return passes;
+
+    std::pair<char const*, bool OptimizerPasses::*> const pass_names[] = {
+        {"fuse_turns", &OptimizerPasses::fuse_turns},
+        {"fuse_turn_move", &OptimizerPasses::fuse_turn_move},
+        {"fuse_counter_jumps", &OptimizerPasses::fuse_counter_jumps},
+        {"fuse_push_pop", &OptimizerPasses::fuse_push_pop},
+        {"merge_nops", &OptimizerPasses::merge_nops},
+        {"fold_zero_flag", &OptimizerPasses::fold_zero_flag},
+        {"thread_jumps", &OptimizerPasses::thread_jumps},
+    };
+    std::stringstream stream(optimize);
+    std::string name;
+    while(std::getline(stream, name, ',')) {
+        auto it = std::find_if(
+            std::begin(pass_names), std::end(pass_names),
+            [&name](auto const& pass) { return name == pass.first; });
+        if(it == std::end(pass_names)) {
+            std::cerr << "Invalid optimizer pass: " << name << std::endl;
+            exit(1);
+        }
+        passes.*(it->second) = true;
+    }
+    return passes;
+}
+
+// Mebibytes of resident chunks, 0 keeps them all
+static ulong parse_map_memory(const std::string& map_memory) {
+    char* end = nullptr;
+    long const mebibytes = std::strtol(map_memory.c_str(), &end, 10);
+    if(end == map_memory.c_str() || *end != '\0' || mebibytes < 0) {
+        std::cerr << "Invalid map memory: " << map_memory << std::endl;
+        exit(1);
+    }
+    return static_cast<ulong>(mebibytes) << 20;
+}
+
 ProjectArguments::ProjectArguments(int argc, char* argv[])
-        : parser(argc, argv),
+    : ProjectArguments(ArgumentParser::to_args(argc, argv)) {}
+
+ProjectArguments::ProjectArguments(std::vector<std::string> const& args)
+        : parser(args),
             default_map_file_path(parser.getString("map_path")),
             save_path(resolve_save_path(parser.getString("save_path"))),
     replay_record_path(parser.getString("record_replay")),
@@ -102,7 +196,20 @@ ProjectArguments::ProjectArguments(int argc, char* argv[])
       is_render(!parser.getBool("no_render", false)),
       is_debug_graphics(parser.getBool("debug_graphics", false)),
       is_walls_enabled(!parser.getBool("disable_walls", false)),
-      no_fov(!parser.getBool("no_fov", false)) {
+      no_fov(!parser.getBool("no_fov", false)),
+      execution_mode(
+          parse_execution_mode(parser.getString("executor", "decoded"))),
+      optimizer_passes(
+          parse_optimizer_passes(parser.getString("optimize", "all"))),
+      is_profiling_blocks(parser.getBool("profile_blocks", false)),
+      job_span(parse_job_span(parser.getString("job_span", "auto"))),
+      num_threads(parse_thread_count(parser.getString("threads", "auto"))),
+      is_pinning_threads(parser.getBool("pin_threads", false)),
+      is_parallel_loops(parser.getBool("parallel_loops", false)),
+      map_memory_budget(
+          parse_map_memory(parser.getString("map_memory", "0"))),
+      is_background_generation(parser.getBool("background_gen", false)),
+      baked_world_path(parser.getString("baked_world")) {
     if(parser.hasKey("help")) {
         help();
         exit(0);
@@ -140,6 +247,31 @@ void ProjectArguments::help() const {
     std::cout << "  --no_fov             Everything is in fov\n";
     std::cout
         << "  --disable_walls      The player and ants can traverse walls\n";
+    std::cout << "  --executor <mode>    Ant program executor - options: decoded,\n";
+    std::cout << "                        closure, batch. default: decoded\n";
+    std::cout << "  --optimize <passes>  Peephole passes for decoded programs - all,\n";
+    std::cout << "                        none or a comma separated list of:\n";
+    std::cout << "                        fuse_turns, fuse_turn_move,\n";
+    std::cout << "                        fuse_counter_jumps, fuse_push_pop,\n";
+    std::cout << "                        merge_nops, fold_zero_flag,\n";
+    std::cout << "                        thread_jumps. default: all\n";
+    std::cout << "  --profile_blocks     Log how often each basic block of the\n";
+    std::cout << "                        decoded programs ran on exit\n";
+    std::cout << "  --job_span <n>       Ants per async job - a number or auto.\n";
+    std::cout << "                        default: auto\n";
+    std::cout << "  --threads <n>        Worker threads of the job pool - a number,\n";
+    std::cout << "                        auto (one per cpu besides the game loop)\n";
+    std::cout << "                        or 0 to run the jobs inline. default: auto\n";
+    std::cout << "  --pin_threads        Pin each worker thread to its own cpu (Linux)\n";
+    std::cout << "  --parallel_loops     Split the map's tile loops (field of view,\n";
+    std::cout << "                        saving chunks) across the job pool\n";
+    std::cout << "  --map_memory <MiB>   Page the least recently used map chunks\n";
+    std::cout << "                        out to a file beyond this size. default:\n";
+    std::cout << "                        0 (keep every chunk in memory)\n";
+    std::cout << "  --background_gen     Generate the map sections ahead of the\n";
+    std::cout << "                        player and the ants on the job pool\n";
+    std::cout << "  --baked_world <path> Start in the world baked by ants_pregen -\n";
+    std::cout << "                        its chunks are loaded, not generated\n";
     std::cout
         << "  --log_level <level>  Set the runtime log level - options: trace, "
            "debug, info, warn, error, critical, and off. default: info. Note "
@@ -2,6 +2,11 @@
 
 #include <map>
 #include <string>
+#include <vector>
+
+#include "hardware/instruction.hpp"
+#include "hardware/optimizer.hpp"
+#include "utils/thread_pool.hpp"
 
 class ArgumentParser {
    private:
@@ -10,6 +15,9 @@ class ArgumentParser {
    public:
     ArgumentParser();
     ArgumentParser(int argc, char* argv[]);
+    // the options without the program name - {"--threads", "4"}
+    explicit ArgumentParser(std::vector<std::string> const& args);
+    static std::vector<std::string> to_args(int argc, char* argv[]);
 
     bool hasKey(const std::string& key) const;
 
@@ -35,7 +43,22 @@ class ProjectArguments {
     bool const is_debug_graphics = {};
     bool const is_walls_enabled = {};
     bool const no_fov = {};
+    ExecutionMode const execution_mode = ExecutionMode::DECODED;
+    OptimizerPasses const optimizer_passes = {};
+    bool const is_profiling_blocks = {};
+    ulong const job_span = {};  // 0 - adaptive
+    ulong const num_threads = default_thread_count();  // 0 - inline
+    bool const is_pinning_threads = {};
+    // run the map's tile and chunk loops with parallel_for on the job pool
+    bool const is_parallel_loops = {};
+    // bytes of resident map chunks before they are paged out, 0 - no paging
+    ulong const map_memory_budget = {};
+    // generate the sections ahead of the player and the ants on the job pool
+    bool const is_background_generation = {};
+    // world baked by ants_pregen to load the map from, empty - generate it
+    std::string const baked_world_path = {};
     ProjectArguments(int argc, char* argv[]);
+    explicit ProjectArguments(std::vector<std::string> const& args);
     ProjectArguments(std::string const& default_map_file_path,
                      std::string const& save_path,
                      std::string const& replay_record_path,
@@ -19,6 +19,10 @@ Engine::Engine(ProjectArguments& config)
     : config(config), renderer(create_renderer()), state(create_state()) {
     initialize();
 }
+Engine::Engine(std::vector<std::string> const& args)
+    : config(args), renderer(create_renderer()), state(create_state()) {
+    initialize();
+}
 
 Engine::~Engine() {
     SPDLOG_INFO("Destructing engine");
@@ -35,6 +39,8 @@ void Engine::initialize() {
                  config.is_debug_graphics ? "YES" : "NO");
     SPDLOG_DEBUG("Project configs - walls enabled: {}",
                  config.is_walls_enabled ? "YES" : "NO");
+    SPDLOG_DEBUG("Project configs - pool threads: {} pinned: {}",
+                 config.num_threads, config.is_pinning_threads ? "YES" : "NO");
 
     SPDLOG_DEBUG("Defined globals - COLS: {}, ROWS: {}, NUM_BUTTON_LAYERS: {}",
                  globals::COLS, globals::ROWS, globals::NUM_BUTTON_LAYERS);
@@ -115,6 +121,12 @@ ReplayError Engine::replay_last_error() const {
 
 bool Engine::replay_done() const { return state->replay_done(); }
 
+ThreadPoolStats Engine::job_pool_stats() const {
+    return state->job_pool_stats();
+}
+
+void Engine::reset_job_pool_stats() { state->reset_job_pool_stats(); }
+
 void Engine::action_move_player(long dx, long dy) {
     state->action_move_player(dx, dy);
 }
@@ -3,6 +3,7 @@
 #include "app/arg_parse.hpp"
 #include "app/clock_speed.hpp"
 #include "ui/replay.hpp"
+#include "utils/thread_pool.hpp"
 
 #include <string>
 #include <vector>
@@ -19,6 +20,7 @@ class Engine {
     Engine();
     Engine(int argc, char* argv[]);
     Engine(ProjectArguments& config);
+    explicit Engine(std::vector<std::string> const& args);
     ~Engine();
     void update();
     void render();
@@ -33,6 +35,9 @@ class Engine {
     ReplayError replay_last_error() const;
     bool replay_done() const;
 
+    ThreadPoolStats job_pool_stats() const;
+    void reset_job_pool_stats();
+
     void action_move_player(long dx, long dy);
     void action_dig(long dx, long dy);
     void action_create_ant();
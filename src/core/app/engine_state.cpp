@@ -17,6 +17,8 @@
 #include "app/engine.hpp"
 #include "app/globals.hpp"
 #include "entity/entity_actions.hpp"
+#include "map/baked_world.hpp"
+#include "map/generator.hpp"
 #include "engine.pb.h"
 #include "replay.pb.h"
 #include "spdlog/spdlog.h"
@@ -65,10 +67,11 @@ Start_Data ensure_start_info(MapWorld& map_world) {
 EngineState::EngineState(ProjectArguments& config, Renderer* renderer)
         : renderer(*renderer),
             box_manager(globals::COLS, globals::ROWS),
-      job_pool(8),
+      job_pool(config.num_threads),
       map_world(Rect(0, 0, box_manager.map_box->get_width(),
                      box_manager.map_box->get_height()),
-                config.is_walls_enabled),
+                config.is_walls_enabled,
+                BakedWorld::open(config.baked_world_path)),
       map_manager(globals::COLS * 2, globals::ROWS * 2, config, map_world),
       entity_manager(map_manager, map_world,
                  ensure_start_info(map_world).player_x,
@@ -78,7 +81,8 @@ EngineState::EngineState(ProjectArguments& config, Renderer* renderer)
                    entity_manager, map_manager, map_world, *renderer,
                                      is_reload_game,
                                      [this]() { return box_manager.is_sidebar_expanded(); },
-                                     job_pool),
+                                     job_pool, config.execution_mode,
+                                     config.optimizer_passes),
       editor_mode(*renderer, *box_manager.text_editor_content_box,
                   software_manager, map_world.levels),
             state(&primary_mode, &editor_mode),
@@ -86,6 +90,7 @@ EngineState::EngineState(ProjectArguments& config, Renderer* renderer)
             save_path(config.save_path) {
     SPDLOG_INFO("Creating engine state");
     add_listeners(config);
+    configure_hardware(config);
     SPDLOG_INFO("Engine initialized without backup");
     configure_replay(config);
 }
@@ -94,7 +99,7 @@ EngineState::EngineState(ProjectArguments& config, Renderer* renderer,
                                                  const ant_proto::ReplayEnvironment* env)
         : renderer(*renderer),
             box_manager(globals::COLS, globals::ROWS),
-            job_pool(8),
+            job_pool(config.num_threads),
             map_world(Rect(0, 0, box_manager.map_box->get_width(),
                                          box_manager.map_box->get_height()),
                                 config.is_walls_enabled, env ? env->region_seed_x() : 0,
@@ -108,7 +113,8 @@ EngineState::EngineState(ProjectArguments& config, Renderer* renderer,
                                      entity_manager, map_manager, map_world, *renderer,
                                      is_reload_game,
                                      [this]() { return box_manager.is_sidebar_expanded(); },
-                                     job_pool),
+                                     job_pool, config.execution_mode,
+                                     config.optimizer_passes),
             editor_mode(*renderer, *box_manager.text_editor_content_box,
                                     software_manager, map_world.levels),
             state(&primary_mode, &editor_mode),
@@ -116,6 +122,7 @@ EngineState::EngineState(ProjectArguments& config, Renderer* renderer,
             save_path(config.save_path) {
         SPDLOG_INFO("Creating engine state (seeded)");
         add_listeners(config);
+        configure_hardware(config);
         SPDLOG_INFO("Engine initialized without backup");
         configure_replay(config);
 }
@@ -124,7 +131,7 @@ EngineState::EngineState(const ant_proto::EngineState& msg,
                                                  ProjectArguments& config, Renderer* renderer)
         : renderer(*renderer),
             box_manager(globals::COLS, globals::ROWS),
-      job_pool(8),
+      job_pool(config.num_threads),
       map_world(msg.map_world(), job_pool, config.is_walls_enabled),
       map_manager(msg.map_manager(), map_world),
       entity_manager(msg.entity_manager(), map_manager, map_world, job_pool),
@@ -133,13 +140,15 @@ EngineState::EngineState(const ant_proto::EngineState& msg,
                    software_manager, entity_manager, map_manager, map_world,
                                      *renderer, is_reload_game,
                                      [this]() { return box_manager.is_sidebar_expanded(); },
-                                     job_pool),
+                                     job_pool, config.execution_mode,
+                                     config.optimizer_passes),
       editor_mode(*renderer, *box_manager.text_editor_content_box,
                   software_manager, map_world.levels),
             state(&primary_mode, &editor_mode),
             sidebar_menu(),
             save_path(config.save_path) {
     add_listeners(config);
+    configure_hardware(config);
     SPDLOG_INFO("Engine initialized with backup");
     configure_replay(config);
 }
@@ -176,6 +185,21 @@ void EngineState::add_listeners(ProjectArguments& config) {
         BACKSPACE_KEY_EVENT, new SidebarNavHandler(*this, sidebar_menu));
 }
 
+void EngineState::configure_hardware(ProjectArguments& config) {
+    SPDLOG_INFO("Job pool - {} threads", job_pool.size());
+    if(config.is_pinning_threads) job_pool.pin_threads();
+    if(config.is_parallel_loops) map_world.loop_pool = &job_pool;
+    if(config.map_memory_budget != 0) {
+        map_world.enable_paging(config.map_memory_budget);
+    }
+    if(config.is_background_generation) {
+        map_world.enable_background_generation();
+    }
+    HardwareManager& hardware_manager = primary_mode.get_hardware_manager();
+    hardware_manager.set_block_profiling(config.is_profiling_blocks);
+    hardware_manager.set_job_span(config.job_span);
+}
+
 void EngineState::configure_replay(ProjectArguments& config) {
     if(!config.replay_play_path.empty() &&
        !config.replay_record_path.empty()) {
@@ -484,6 +508,13 @@ void EngineState::render() {
     if(state.is_primary() && box_manager.is_sidebar_expanded()) {
         renderer.render_sidebar(*box_manager.sidebar_box, sidebar_menu,
                                 clock_speed);
+        std::vector<std::string> stats = job_pool.stats().summary();
+        if(SectionGenerator const* generator = map_world.get_generator()) {
+            std::vector<std::string> const gen_stats =
+                generator->get_stats().summary();
+            stats.insert(stats.end(), gen_stats.begin(), gen_stats.end());
+        }
+        renderer.render_sidebar_stats(*box_manager.sidebar_box, stats);
     }
     renderer.render_toggle_button(box_manager.is_sidebar_expanded());
 }
@@ -533,6 +564,7 @@ void EngineState::handle_sidebar_action(SidebarMenuAction action) {
 }
 
 Packer& operator<<(Packer& p, EngineState const& obj) {
+    obj.primary_mode.get_hardware_manager().store_wait_ticks();
     ant_proto::EngineState msg;
     *msg.mutable_entity_manager() = obj.entity_manager.get_proto();
     *msg.mutable_software_manger() = obj.software_manager.get_proto();
@@ -76,6 +76,9 @@ struct EngineState {
     }
     bool replay_done() const { return is_replay_complete; }
 
+    ThreadPoolStats job_pool_stats() const { return job_pool.stats(); }
+    void reset_job_pool_stats() { job_pool.reset_stats(); }
+
     void action_move_player(long dx, long dy);
     void action_dig(long dx, long dy);
     void action_create_ant();
@@ -86,6 +89,7 @@ struct EngineState {
 
    private:
     void add_listeners(ProjectArguments&);
+    void configure_hardware(ProjectArguments&);
     void dispatch_mouse_event(const MouseEvent& mouse_event);
     void dispatch_key_down(SDL_Keysym const& key_sym,
                            KeyboardEvent& keyboard_event,
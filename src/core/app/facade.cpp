@@ -9,6 +9,8 @@ AntGameFacade::AntGameFacade(int argc, char* argv[])
     : engine(argc, argv), clock_timeout(SDL_GetTicks64()) {}
 AntGameFacade::AntGameFacade(ProjectArguments& config)
     : engine(config), clock_timeout(SDL_GetTicks64()) {}
+AntGameFacade::AntGameFacade(std::vector<std::string> const& args)
+    : engine(args), clock_timeout(SDL_GetTicks64()) {}
 
 bool AntGameFacade::update() {
     if(clock_timeout >= SDL_GetTicks64()) return false;
@@ -43,6 +45,12 @@ ReplayError AntGameFacade::replay_last_error() const {
 
 bool AntGameFacade::replay_done() const { return engine.replay_done(); }
 
+ThreadPoolStats AntGameFacade::job_pool_stats() const {
+    return engine.job_pool_stats();
+}
+
+void AntGameFacade::reset_job_pool_stats() { engine.reset_job_pool_stats(); }
+
 void AntGameFacade::action_move_player(long dx, long dy) {
     engine.action_move_player(dx, dy);
 }
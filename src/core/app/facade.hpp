@@ -12,6 +12,8 @@ class AntGameFacade {
     AntGameFacade();
     AntGameFacade(int argc, char* argv[]);
     AntGameFacade(ProjectArguments& config);
+    // command line options without the program name - {"--threads", "0"}
+    explicit AntGameFacade(std::vector<std::string> const& args);
 
     bool update();
     void engine_update();
@@ -23,6 +25,9 @@ class AntGameFacade {
     ReplayError replay_last_error() const;
     bool replay_done() const;
 
+    ThreadPoolStats job_pool_stats() const;
+    void reset_job_pool_stats();
+
     void action_move_player(long dx, long dy);
     void action_dig(long dx, long dy);
     void action_create_ant();
@@ -33,9 +33,11 @@ PrimaryMode::PrimaryMode(LayoutBox& box, CommandMap const& command_map,
                          MapWorld& map_world, Renderer& renderer,
                                                  bool& is_reload_game,
                                                  std::function<bool()> input_blocker,
-                         const ThreadPool<AsyncProgramJob>& job_pool)
+                         ThreadPool<AsyncProgramJob>& job_pool,
+                         ExecutionMode execution_mode,
+                         OptimizerPasses optimizer_passes)
     : box(box),
-      hardware_manager(command_map),
+      hardware_manager(command_map, execution_mode, optimizer_passes),
       entity_manager(entity_manager),
       map_manager(map_manager),
       map_world(map_world),
@@ -53,9 +55,12 @@ PrimaryMode::PrimaryMode(const ant_proto::HardwareManager msg, LayoutBox& box,
                          MapWorld& map_world, Renderer& renderer,
                                                  bool& is_reload_game,
                                                  std::function<bool()> input_blocker,
-                         const ThreadPool<AsyncProgramJob>& job_pool)
+                         ThreadPool<AsyncProgramJob>& job_pool,
+                         ExecutionMode execution_mode,
+                         OptimizerPasses optimizer_passes)
     : box(box),
-      hardware_manager(msg, command_map),
+      hardware_manager(msg, command_map, execution_mode,
+                       optimizer_passes),
       entity_manager(entity_manager),
       map_manager(map_manager),
       map_world(map_world),
@@ -215,20 +220,43 @@ void PrimaryMode::render() {
     }
 }
 
+// The async phase only reads the ant registers, so it overlaps the view
+// update of the entity manager. See TaskGraph for the waves.
 void PrimaryMode::update() {
-    entity_manager.update();
+    map_world.queue_sections_ahead();
+    frame_graph.clear();
+    std::vector<TaskGraph::TaskId> const actions =
+        entity_manager.add_update_tasks(frame_graph);
+    // no dependencies - the sections are generated alongside the frame
+    map_world.add_generation_tasks(frame_graph);
+    TaskGraph::TaskId const async_phase = frame_graph.add(
+        "programs async",
+        [this]() {
+            // only the executors that are not waiting, parked or finished
+            hardware_manager.begin_tick();
+            for(ProgramExecutor* exec : hardware_manager.ready()) {
+                exec->reset();
+            }
+            if(hardware_manager.execution_mode == ExecutionMode::BATCH) {
+                hardware_manager.execute_async_batched(job_pool);
+            } else {
+                hardware_manager.execute_async_spans(job_pool);
+            }
+        },
+        actions, TaskGraph::Affinity::CALLER);
+    frame_graph.add(
+        "programs sync",
+        [this]() {
+            for(ProgramExecutor* exec : hardware_manager.ready()) {
+                exec->execute_sync();
+            }
+            hardware_manager.end_tick();
+        },
+        {async_phase}, TaskGraph::Affinity::CALLER);
+    SPDLOG_TRACE("Frame graph\n{}", frame_graph.describe());
 
-    for(ProgramExecutor* exec : hardware_manager) {
-        exec->reset();
-    }
-
-    for(ProgramExecutor* exec : hardware_manager) {
-        exec->execute_async();
-    }
-
-    job_pool.await_jobs();
-
-    for(ProgramExecutor* exec : hardware_manager) {
-        exec->execute_sync();
-    }
+    frame_graph.run(job_pool);
+    // no task holds a chunk between frames
+    map_world.load_generated_sections();
+    map_world.page_out_cold_chunks();
 }
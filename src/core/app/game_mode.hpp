@@ -15,6 +15,7 @@
 #include "map/manager.hpp"
 #include "ui/event_system.hpp"
 #include "ui/render.hpp"
+#include "utils/task_graph.hpp"
 #include "utils/thread_pool.hpp"
 
 struct Level;
@@ -94,8 +95,9 @@ class PrimaryMode : public Mode {
     MapWorld& map_world;
     Renderer& renderer;
     bool& is_reload_game;
-    const ThreadPool<AsyncProgramJob>& job_pool;
+    ThreadPool<AsyncProgramJob>& job_pool;
     std::function<bool()> input_blocker;
+    TaskGraph frame_graph;  // rebuilt by every update
 
    public:
     PrimaryMode(LayoutBox& box, CommandMap const& command_map,
@@ -103,7 +105,9 @@ class PrimaryMode : public Mode {
                 EntityManager& entity_manager, MapManager& map_manager,
                 MapWorld& map_world, Renderer& renderer, bool& is_reload_game,
                 std::function<bool()> input_blocker,
-                const ThreadPool<AsyncProgramJob>& job_pool);
+                ThreadPool<AsyncProgramJob>& job_pool,
+                ExecutionMode execution_mode,
+                OptimizerPasses optimizer_passes);
 
     PrimaryMode(const ant_proto::HardwareManager msg, LayoutBox& box,
                 CommandMap const& command_map,
@@ -111,7 +115,9 @@ class PrimaryMode : public Mode {
                 EntityManager& entity_manager, MapManager& map_manager,
                 MapWorld& map_world, Renderer& renderer, bool& is_reload_game,
                 std::function<bool()> input_blocker,
-                const ThreadPool<AsyncProgramJob>& job_pool);
+                ThreadPool<AsyncProgramJob>& job_pool,
+                ExecutionMode execution_mode,
+                OptimizerPasses optimizer_passes);
 
     void initialize(SoftwareManager& software_manager);
     bool is_editor() override { return false; }
@@ -141,6 +147,11 @@ class PrimaryMode : public Mode {
     }
 
     HardwareManager& get_hardware_manager() { return hardware_manager; }
+    HardwareManager const& get_hardware_manager() const {
+        return hardware_manager;
+    }
+    // the schedule of the last update - see TaskGraph::describe
+    TaskGraph const& get_frame_graph() const { return frame_graph; }
 
     ant_proto::HardwareManager get_proto() const {
         ant_proto::HardwareManager msg;
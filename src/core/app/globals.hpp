@@ -1,7 +1,6 @@
 #pragma once
 
 #include <cstdint>
-#include <mutex>
 
 #include "utils/types.hpp"
 using cpu_word_size = unsigned int;
@@ -25,5 +24,4 @@ namespace globals {
     const long REGBOXWIDTH = 8;
     const long REGBOXHEIGHT = 1;
 
-    extern std::mutex threadpool_mutex;
 };  // namespace globals
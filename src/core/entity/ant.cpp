@@ -59,12 +59,20 @@ EntityData& Worker::get_data() { return data; }
 
 void Worker::request_move() { program_executor.execute_sync(); }
 
+// The flags are an input of the ant program, so a change wakes an ant that
+// is parked in a loop polling them.
 void Worker::handle_empty_space(uchar bits) {
-    cpu.is_space_empty_flags |= bits;
+    uchar const flags = cpu.is_space_empty_flags | bits;
+    if(flags == cpu.is_space_empty_flags) return;
+    cpu.is_space_empty_flags = flags;
+    program_executor.wake();
 }
 
 void Worker::handle_full_space(uchar bits) {
-    cpu.is_space_empty_flags &= ~bits;
+    uchar const flags = static_cast<uchar>(cpu.is_space_empty_flags & ~bits);
+    if(flags == cpu.is_space_empty_flags) return;
+    cpu.is_space_empty_flags = flags;
+    program_executor.wake();
 }
 
 ant_proto::Worker Worker::get_proto() {
@@ -103,6 +111,7 @@ void Worker::move_callback(EntityMoveUpdate const& update) {
     ScentBehaviors& scent_behaviors = cpu.scent_behaviors;
     scent_behaviors.read_scent_behavior((ulong*)update.abs_scents);
     scent_behaviors.write_scent_behavior();
+    program_executor.wake();  // the scent directions changed
 
     // SPDLOG_INFO("Move callback - worker - {}", cpu.is_space_empty_flags);
 }
@@ -47,59 +47,102 @@ void EntityManager::update_fov() {
     SPDLOG_TRACE("FOV updated");
 }
 
-void EntityManager::update() {
-    ++map_world.instr_action_clock;
-    // Move / dig the ants on the map
-    for(auto& level : map_world.levels) {
-        for(Worker* worker : level.workers) {
-            DualRegisters& cpu = worker->cpu;
-
-            // Direction Truth Table
-            // A B | DX DY
-            // 0 0 |  1  0
-            // 0 1 |  0 -1
-            // 1 0 | -1  0
-            // 1 1 |  0  1
-
-            long dx = (1 - cpu.dir_flag2) * (-2 * cpu.dir_flag1 + 1);
-            long dy = cpu.dir_flag2 * (2 * cpu.dir_flag1 - 1);
-            if(cpu.is_move_flag) {
-                cpu.is_move_flag = false;
-                SPDLOG_DEBUG("Moving worker - dx: {} dy: {}", dx, dy);
-                cpu.instr_failed_flag = !level.map.move_entity(*worker, dx, dy);
+// Every tile a move or dig of the level's ants can touch lies within two
+// tiles of the ant. Creating their chunks up front keeps the chunk
+// generation, which writes to the shared regions, out of apply_actions so
+// the levels can run concurrently.
+void EntityManager::load_action_chunks(Level& level) {
+    for(Worker* worker : level.workers) {
+        DualRegisters const& cpu = worker->cpu;
+        if(!cpu.is_move_flag && !cpu.is_dig_flag) continue;
+        EntityData const& data = worker->get_data();
+        for(long dx : {-2, 2}) {
+            for(long dy : {-2, 2}) {
+                level.map.create_chunk(data.x + dx, data.y + dy);
             }
-            if(cpu.is_dig_flag) {
-                cpu.is_dig_flag = false;
-                SPDLOG_DEBUG("Digging worker - dx: {} dy: {}", dx, dy);
-                cpu.instr_failed_flag = !level.map.dig(*worker, dx, dy);
-            }
-            if(cpu.delta_scents) {
-                ulong& tile_scents = level.map.get_tile_scents(*worker);
-
-                ulong updated_scents = 0;
-                ulong offset = 0;
-                while(cpu.delta_scents != 0) {
-                    ulong delta_scent = cpu.delta_scents & 0xFF;
-                    ulong prev_scent = tile_scents & 0xFF;
-                    ulong scent = (prev_scent + delta_scent) & 0xFF;
-                    updated_scents |= (scent << offset);
-
-                    tile_scents >>= 8;
-                    cpu.delta_scents >>= 8;
-                    offset += 8;
-                }
-                tile_scents = updated_scents;
-                // SPDLOG_INFO("Tile scent: {} - x: {} y: {}", tile_scents,
-                // worker->get_data().x, worker->get_data().y);
+        }
+    }
+}
+
+// Move / dig the ants of the level and drop their scents
+void EntityManager::apply_actions(Level& level) {
+    for(Worker* worker : level.workers) {
+        DualRegisters& cpu = worker->cpu;
+
+        // Direction Truth Table
+        // A B | DX DY
+        // 0 0 |  1  0
+        // 0 1 |  0 -1
+        // 1 0 | -1  0
+        // 1 1 |  0  1
+
+        long dx = (1 - cpu.dir_flag2) * (-2 * cpu.dir_flag1 + 1);
+        long dy = cpu.dir_flag2 * (2 * cpu.dir_flag1 - 1);
+        if(cpu.is_move_flag) {
+            cpu.is_move_flag = false;
+            SPDLOG_DEBUG("Moving worker - dx: {} dy: {}", dx, dy);
+            cpu.instr_failed_flag = !level.map.move_entity(*worker, dx, dy);
+        }
+        if(cpu.is_dig_flag) {
+            cpu.is_dig_flag = false;
+            SPDLOG_DEBUG("Digging worker - dx: {} dy: {}", dx, dy);
+            cpu.instr_failed_flag = !level.map.dig(*worker, dx, dy);
+        }
+        if(cpu.delta_scents) {
+            ulong& tile_scents = level.map.get_tile_scents(*worker);
+
+            ulong updated_scents = 0;
+            ulong offset = 0;
+            while(cpu.delta_scents != 0) {
+                ulong delta_scent = cpu.delta_scents & 0xFF;
+                ulong prev_scent = tile_scents & 0xFF;
+                ulong scent = (prev_scent + delta_scent) & 0xFF;
+                updated_scents |= (scent << offset);
+
+                tile_scents >>= 8;
+                cpu.delta_scents >>= 8;
+                offset += 8;
             }
+            tile_scents = updated_scents;
+            // SPDLOG_INFO("Tile scent: {} - x: {} y: {}", tile_scents,
+            // worker->get_data().x, worker->get_data().y);
         }
     }
+}
 
+void EntityManager::update_view() {
     if(!map_manager.update_current_level(player.get_data())) return;
     SPDLOG_TRACE("Updating EntityManager");
     update_fov();
 }
 
+// One task per level with ants - a level's actions only touch its own map
+// and ants once load_action_chunks ran. The view reads the current level
+// and may generate chunks of any level, so it waits for all of them. It
+// runs on the calling thread, which owns the pool its tile loops use.
+std::vector<TaskGraph::TaskId> EntityManager::add_update_tasks(
+    TaskGraph& graph) {
+    std::vector<TaskGraph::TaskId> actions;
+    actions.push_back(graph.add(
+        "load action chunks",
+        [this]() {
+            ++map_world.instr_action_clock;
+            for(Level& level : map_world.levels) load_action_chunks(level);
+        },
+        {}, TaskGraph::Affinity::CALLER));
+    TaskGraph::TaskId const load_chunks = actions.front();
+    for(Level& level : map_world.levels) {
+        if(level.workers.empty()) continue;
+        actions.push_back(
+            graph.add("actions L" + std::to_string(level.depth),
+                      [this, &level]() { apply_actions(level); },
+                      {load_chunks}));
+    }
+    graph.add("view", [this]() { update_view(); }, actions,
+              TaskGraph::Affinity::CALLER);
+    return actions;
+}
+
 void EntityManager::create_ant(HardwareManager& hardware_manager,
                                SoftwareManager& software_manager) {
     // if(key_sym == SDLK_a && player->bldgId.has_value()) {
@@ -154,14 +197,25 @@ bool EntityManager::build_ant(HardwareManager& hardware_manager, Worker& worker,
     SPDLOG_TRACE("Building ant program - x: {} y: {} - machine_code: {} bytes",
                  worker.get_data().x, worker.get_data().y, machine_code.size());
 
-    CompileArgs compile_args(machine_code.code, worker.cpu,
-                             worker.program_executor._ops);
-    hardware_manager.compile(compile_args);
-    if(compile_args.status.p_err) {
-        SPDLOG_ERROR("Failed to compile the program for the ant");
-        return false;
+    ProgramExecutor& executor = worker.program_executor;
+    if(hardware_manager.execution_mode != ExecutionMode::CLOSURE) {
+        Status status;
+        DecodedProgram const* program =
+            hardware_manager.get_program(machine_code, status);
+        if(status.p_err) {
+            SPDLOG_ERROR("Failed to compile the program for the ant");
+            return false;
+        }
+        executor.use_decoded(worker.cpu, *program);
+    } else {
+        CompileArgs compile_args(machine_code.code, worker.cpu, executor._ops);
+        hardware_manager.compile(compile_args);
+        if(compile_args.status.p_err) {
+            SPDLOG_ERROR("Failed to compile the program for the ant");
+            return false;
+        }
     }
-    hardware_manager.push_back(&worker.program_executor);
+    hardware_manager.push_back(&executor);
     SPDLOG_TRACE("Successfully compiled worker program");
     return true;
 }
@@ -177,7 +231,8 @@ void EntityManager::rebuild_workers(HardwareManager& hardware_manager,
             ++ant_idx;
         }
     }
-    SPDLOG_TRACE("Completed rebuilding worker ant programs");
+    SPDLOG_TRACE("Completed rebuilding worker ant programs - {} distinct programs",
+                 hardware_manager.num_programs());
 }
 
 // returns the total number of workers accross all levels
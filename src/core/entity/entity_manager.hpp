@@ -8,6 +8,7 @@
 #include "hardware/software_manager.hpp"
 #include "map/manager.hpp"
 #include "map/world.hpp"
+#include "utils/task_graph.hpp"
 #include "utils/thread_pool.hpp"
 
 struct EntityManager {
@@ -26,7 +27,12 @@ struct EntityManager {
     ~EntityManager();
 
     void update_fov();
-    void update();
+    void load_action_chunks(Level& level);
+    void apply_actions(Level& level);
+    void update_view();
+    // Declares the frame's ant actions and view update. Returns the tasks
+    // the ant programs of the frame have to wait for.
+    std::vector<TaskGraph::TaskId> add_update_tasks(TaskGraph& graph);
     void create_ant(HardwareManager& hardware_manager,
                     SoftwareManager& software_manager);
     bool build_ant(HardwareManager& hardware_manager, Worker& worker,
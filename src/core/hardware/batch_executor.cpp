@@ -0,0 +1,428 @@
+#include "hardware/batch_executor.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#include "hardware/brain.hpp"
+#include "hardware/program_executor.hpp"
+#include "spdlog/spdlog.h"
+
+namespace {
+// Lanes that converged on one instruction are a contiguous range of lanes.
+// The index is widened so the compiler can prove the accesses are
+// consecutive and vectorize the loop.
+struct LaneRange {
+    ulong first;
+    ulong operator[](ulong i) const { return first + i; }
+};
+
+struct LaneList {
+    ushort const* lanes;
+    ulong operator[](ulong i) const { return lanes[i]; }
+};
+}  // namespace
+
+void ProgramBatch::clear(DecodedProgram const& program,
+                         ulong max_instruction_per_tick) {
+    this->program = &program;
+    this->max_instruction_per_tick = max_instruction_per_tick;
+    num_lanes = 0;
+    num_executed = 0;
+}
+
+void ProgramBatch::add(ProgramExecutor& executor) {
+    assert(num_lanes < lane_count);
+    assert(executor.program == program);
+    assert(executor.max_instruction_per_tick == max_instruction_per_tick);
+    executors[num_lanes++] = &executor;
+}
+
+void ProgramBatch::load_lane(ushort lane) {
+    DualRegisters const& cpu = *executors[lane]->cpu;
+    registers[0][lane] = cpu.registers[0];
+    registers[1][lane] = cpu.registers[1];
+    instr_ptr[lane] = cpu.instr_ptr_register;
+    zero_flag[lane] = cpu.zero_flag;
+    instr_failed_flag[lane] = cpu.instr_failed_flag;
+    dir_flag1[lane] = cpu.dir_flag1;
+    dir_flag2[lane] = cpu.dir_flag2;
+    is_space_empty_flags[lane] = cpu.is_space_empty_flags;
+}
+
+void ProgramBatch::store_lane(ushort lane) {
+    DualRegisters& cpu = *executors[lane]->cpu;
+    cpu.registers[0] = registers[0][lane];
+    cpu.registers[1] = registers[1][lane];
+    cpu.instr_ptr_register = instr_ptr[lane];
+    cpu.zero_flag = zero_flag[lane];
+    cpu.instr_failed_flag = instr_failed_flag[lane];
+    cpu.dir_flag1 = dir_flag1[lane];
+    cpu.dir_flag2 = dir_flag2[lane];
+}
+
+// Semantics match interpret() in hardware/instruction.cpp. Only async
+// instructions reach this point - the sync ones stop the lane beforehand.
+// Branches leave the address of the lane's next instruction in instr_ptr.
+template <class Lanes>
+void ProgramBatch::step_lanes(Instruction const& instr, ushort address,
+                              Lanes lanes, ulong num_selected) {
+    ushort const next = static_cast<ushort>(address + 1 + instr.skip);
+    ushort const target = static_cast<ushort>(instr.address + 1);
+    switch(instr.opcode) {
+        case OpCode::LOAD:
+        case OpCode::LOAD_JMP: {
+            cpu_word_size* reg = registers[instr.arg0];
+            uchar const is_zero = instr.value == 0;
+            for(ulong i = 0; i < num_selected; ++i) {
+                reg[lanes[i]] = instr.value;
+                zero_flag[lanes[i]] = is_zero;
+            }
+            break;
+        }
+        case OpCode::COPY: {
+            cpu_word_size const* src = registers[instr.arg0];
+            cpu_word_size* dst = registers[instr.arg1];
+            for(ulong i = 0; i < num_selected; ++i) {
+                cpu_word_size const value = src[lanes[i]];
+                dst[lanes[i]] = value;
+                zero_flag[lanes[i]] = value == 0;
+            }
+            break;
+        }
+        case OpCode::ADD: {
+            cpu_word_size const* src = registers[instr.arg0];
+            cpu_word_size* dst = registers[instr.arg1];
+            for(ulong i = 0; i < num_selected; ++i) {
+                cpu_word_size const value = dst[lanes[i]] + src[lanes[i]];
+                dst[lanes[i]] = value;
+                zero_flag[lanes[i]] = value == 0;
+            }
+            break;
+        }
+        case OpCode::SUB: {
+            cpu_word_size const* src = registers[instr.arg0];
+            cpu_word_size* dst = registers[instr.arg1];
+            for(ulong i = 0; i < num_selected; ++i) {
+                cpu_word_size const value = dst[lanes[i]] - src[lanes[i]];
+                dst[lanes[i]] = value;
+                zero_flag[lanes[i]] = value == 0;
+            }
+            break;
+        }
+        case OpCode::INC: {
+            cpu_word_size* reg = registers[instr.arg0];
+            for(ulong i = 0; i < num_selected; ++i) {
+                cpu_word_size const value = reg[lanes[i]] + 1;
+                reg[lanes[i]] = value;
+                zero_flag[lanes[i]] = value == 0;
+            }
+            break;
+        }
+        case OpCode::DEC: {
+            cpu_word_size* reg = registers[instr.arg0];
+            for(ulong i = 0; i < num_selected; ++i) {
+                cpu_word_size const value = reg[lanes[i]] - 1;
+                reg[lanes[i]] = value;
+                zero_flag[lanes[i]] = value == 0;
+            }
+            break;
+        }
+        case OpCode::JMP:
+            break;  // every lane takes the jump - see run()
+        case OpCode::JNZ:
+            for(ulong i = 0; i < num_selected; ++i) {
+                instr_ptr[lanes[i]] = zero_flag[lanes[i]] ? next : target;
+            }
+            break;
+        case OpCode::JNF:
+            for(ulong i = 0; i < num_selected; ++i) {
+                instr_ptr[lanes[i]] =
+                    instr_failed_flag[lanes[i]] ? next : target;
+            }
+            break;
+        case OpCode::INC_JNZ: {
+            cpu_word_size* reg = registers[instr.arg0];
+            for(ulong i = 0; i < num_selected; ++i) {
+                cpu_word_size const value = reg[lanes[i]] + 1;
+                reg[lanes[i]] = value;
+                zero_flag[lanes[i]] = value == 0;
+                instr_ptr[lanes[i]] = value == 0 ? next : target;
+            }
+            break;
+        }
+        case OpCode::DEC_JNZ: {
+            cpu_word_size* reg = registers[instr.arg0];
+            for(ulong i = 0; i < num_selected; ++i) {
+                cpu_word_size const value = reg[lanes[i]] - 1;
+                reg[lanes[i]] = value;
+                zero_flag[lanes[i]] = value == 0;
+                instr_ptr[lanes[i]] = value == 0 ? next : target;
+            }
+            break;
+        }
+        case OpCode::LT:
+            for(ulong i = 0; i < num_selected; ++i) {
+                uchar const dir2 = dir_flag2[lanes[i]];
+                dir_flag1[lanes[i]] ^= dir2;
+                dir_flag2[lanes[i]] = dir2 ^ 1;
+            }
+            break;
+        case OpCode::RT:
+            for(ulong i = 0; i < num_selected; ++i) {
+                uchar const dir2 = dir_flag2[lanes[i]];
+                dir_flag1[lanes[i]] ^= dir2 ^ 1;
+                dir_flag2[lanes[i]] = dir2 ^ 1;
+            }
+            break;
+        case OpCode::TURN_AROUND:
+            for(ulong i = 0; i < num_selected; ++i) {
+                dir_flag1[lanes[i]] ^= 1;
+            }
+            break;
+        case OpCode::CHECK:
+            for(ulong i = 0; i < num_selected; ++i) {
+                uchar const idx = static_cast<uchar>(
+                    (dir_flag1[lanes[i]] << 1) | dir_flag2[lanes[i]]);
+                instr_failed_flag[lanes[i]] =
+                    ((is_space_empty_flags[lanes[i]] >> idx) & 1) ^ 1;
+            }
+            break;
+        default:
+            // stack, ram and scent ops run against the ant's own registers
+            for(ulong i = 0; i < num_selected; ++i) {
+                ushort const lane = static_cast<ushort>(lanes[i]);
+                instr_ptr[lane] = address;
+                store_lane(lane);
+                interpret(instr, *executors[lane]->cpu);
+                load_lane(lane);
+                ++instr_ptr[lane];
+            }
+            break;
+    }
+}
+
+void ProgramBatch::step(Instruction const& instr, LaneGroup const& group) {
+    if(group.first_lane != none) {
+        step_lanes(instr, group.instr_ptr, LaneRange{group.first_lane},
+                   group.num_lanes);
+    } else {
+        step_lanes(instr, group.instr_ptr, LaneList{group.lanes},
+                   group.num_lanes);
+    }
+}
+
+bool ProgramBatch::is_async(ulong address) const {
+    return address < program->size() &&
+           program->instructions[address].num_ticks == 0;
+}
+
+// Appends one successor group per distinct instr_ptr of the lanes. The lanes
+// are copied to out starting at used.
+void ProgramBatch::split(ushort const* lanes, ulong num_selected, ushort* out,
+                         ulong& used) {
+    touched.clear();
+    for(ulong i = 0; i < num_selected; ++i) {
+        ushort const lane = lanes[i];
+        ushort const address = instr_ptr[lane];
+        if(address >= program->size()) continue;  // ran off the program
+        if(lane_tail[address] == none) {
+            lane_head[address] = lane;
+            touched.push_back(address);
+        } else {
+            next_lane[lane_tail[address]] = lane;
+        }
+        lane_tail[address] = lane;
+    }
+
+    for(ushort const address : touched) {
+        ushort* group_lanes = out + used;
+        ushort count = 0, min_lane = none, max_lane = 0;
+        for(ushort lane = lane_head[address];; lane = next_lane[lane]) {
+            group_lanes[count++] = lane;
+            min_lane = std::min(min_lane, lane);
+            max_lane = std::max(max_lane, lane);
+            if(lane == lane_tail[address]) break;
+        }
+        lane_tail[address] = none;
+        used += count;
+        bool const is_range = max_lane - min_lane + 1 == count;
+        successors.push_back(
+            {address, count, is_range ? min_lane : none, group_lanes});
+    }
+}
+
+// Conditional jumps send every lane to one of two addresses. Lanes that
+// agree keep their group as is, otherwise the lanes are partitioned into
+// out.
+void ProgramBatch::split_two_way(LaneGroup const& group, ushort next,
+                                 ushort target, ushort* out, ulong& used) {
+    ulong num_taken = 0;
+    for(ulong i = 0; i < group.num_lanes; ++i) {
+        num_taken += instr_ptr[group.lanes[i]] == target;
+    }
+    if(num_taken == 0 || num_taken == group.num_lanes) {
+        ushort const address = num_taken == 0 ? next : target;
+        successors.push_back(
+            {address, group.num_lanes, group.first_lane, group.lanes});
+        return;
+    }
+
+    ushort* taken = out + used;
+    ushort* not_taken = taken + num_taken;
+    ulong num_not_taken = 0;
+    num_taken = 0;
+    for(ulong i = 0; i < group.num_lanes; ++i) {
+        ushort const lane = group.lanes[i];
+        if(instr_ptr[lane] == target) {
+            taken[num_taken++] = lane;
+        } else {
+            not_taken[num_not_taken++] = lane;
+        }
+    }
+    used += group.num_lanes;
+    successors.push_back(
+        {target, static_cast<ushort>(num_taken), none, taken});
+    successors.push_back(
+        {next, static_cast<ushort>(num_not_taken), none, not_taken});
+}
+
+// Turns this round's successors into the next round's groups. Successors
+// that reached a sync instruction or the end of the program stop, the rest
+// are merged by instruction and their lanes copied to out.
+void ProgramBatch::regroup(ushort* out, bool is_budget_spent) {
+    touched.clear();
+    for(ulong idx = 0; idx < successors.size(); ++idx) {
+        LaneGroup const& successor = successors[idx];
+        ushort const address = successor.instr_ptr;
+        if(is_budget_spent || !is_async(address)) {
+            // still running async instructions - spun the whole budget
+            bool const is_spinning = is_budget_spent && is_async(address);
+            for(ulong i = 0; i < successor.num_lanes; ++i) {
+                ushort const lane = successor.lanes[i];
+                instr_ptr[lane] = address;
+                if(is_spinning) executors[lane]->watch_for_cycle();
+            }
+            continue;
+        }
+        if(successor_tail[address] == none) {
+            successor_head[address] = static_cast<ushort>(idx);
+            touched.push_back(address);
+        } else {
+            successors[successor_tail[address]].next = static_cast<ushort>(idx);
+        }
+        successor_tail[address] = static_cast<ushort>(idx);
+    }
+
+    groups.clear();
+    ulong used = 0;
+    for(ushort const address : touched) {
+        LaneGroup const& head = successors[successor_head[address]];
+        ushort* group_lanes = out + used;
+        if(head.next == none) {
+            std::copy_n(head.lanes, head.num_lanes, group_lanes);
+            groups.push_back(
+                {address, head.num_lanes, head.first_lane, group_lanes});
+        } else {
+            ushort count = 0, min_lane = none, max_lane = 0;
+            for(ushort idx = successor_head[address]; idx != none;
+                idx = successors[idx].next) {
+                LaneGroup const& successor = successors[idx];
+                for(ulong i = 0; i < successor.num_lanes; ++i) {
+                    ushort const lane = successor.lanes[i];
+                    group_lanes[count++] = lane;
+                    min_lane = std::min(min_lane, lane);
+                    max_lane = std::max(max_lane, lane);
+                }
+            }
+            bool const is_range = max_lane - min_lane + 1 == count;
+            groups.push_back(
+                {address, count, is_range ? min_lane : none, group_lanes});
+        }
+        used += groups.back().num_lanes;
+        successor_tail[address] = none;
+    }
+}
+
+static bool is_branch(OpCode opcode) {
+    return opcode == OpCode::CALL || opcode == OpCode::RET;
+}
+
+static bool is_conditional_branch(OpCode opcode) {
+    return opcode == OpCode::JNZ || opcode == OpCode::JNF ||
+           opcode == OpCode::INC_JNZ || opcode == OpCode::DEC_JNZ;
+}
+
+void ProgramBatch::run() {
+    ulong const program_size = program->size();
+    // the bucket tails are all none between rounds
+    if(lane_tail.size() < program_size) {
+        lane_head.resize(program_size, none);
+        lane_tail.resize(program_size, none);
+        successor_head.resize(program_size, none);
+        successor_tail.resize(program_size, none);
+    }
+
+    num_executed = 0;
+    ushort* split_lanes = lane_buffers[2];
+    ulong split_used = 0;
+    ushort* started = lane_buffers[0];
+    ulong num_started = 0;
+    for(ushort lane = 0; lane < num_lanes; ++lane) {
+        load_lane(lane);
+        if(max_instruction_per_tick > 0 && is_async(instr_ptr[lane])) {
+            started[num_started++] = lane;
+        }
+    }
+    successors.clear();
+    split(started, num_started, split_lanes, split_used);
+    ulong current = 0;
+    regroup(lane_buffers[current], false);
+
+    // Every round runs one instruction on each lane that is still running.
+    for(ulong round = 1; !groups.empty(); ++round) {
+        successors.clear();
+        split_used = 0;
+        for(LaneGroup const& group : groups) {
+            Instruction const& instr = program->instructions[group.instr_ptr];
+            step(instr, group);
+            num_executed += group.num_lanes;
+            ushort const next =
+                static_cast<ushort>(group.instr_ptr + 1 + instr.skip);
+            ushort const target = static_cast<ushort>(instr.address + 1);
+            if(is_conditional_branch(instr.opcode)) {
+                split_two_way(group, next, target, split_lanes, split_used);
+                continue;
+            }
+            if(is_branch(instr.opcode)) {
+                split(group.lanes, group.num_lanes, split_lanes, split_used);
+                continue;
+            }
+            bool const is_jump = instr.opcode == OpCode::JMP ||
+                                 instr.opcode == OpCode::LOAD_JMP;
+            successors.push_back({is_jump ? target : next, group.num_lanes,
+                                  group.first_lane, group.lanes});
+        }
+        current ^= 1;
+        regroup(lane_buffers[current], round >= max_instruction_per_tick);
+    }
+
+    for(ushort lane = 0; lane < num_lanes; ++lane) store_lane(lane);
+    SPDLOG_TRACE("Batch ran {} instructions over {} lanes", num_executed,
+                 num_lanes);
+}
+
+void BatchExecutor::clear() {
+    num_batches = 0;
+    open_batches.clear();
+}
+
+void BatchExecutor::add(ProgramExecutor& executor) {
+    ProgramBatch*& batch = open_batches[executor.program];
+    if(batch == nullptr || batch->num_lanes == ProgramBatch::lane_count ||
+       batch->max_instruction_per_tick != executor.max_instruction_per_tick) {
+        if(num_batches == batches.size()) batches.emplace_back();
+        batch = &batches[num_batches++];
+        batch->clear(*executor.program, executor.max_instruction_per_tick);
+    }
+    batch->add(executor);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "app/globals.hpp"
+#include "hardware/instruction.hpp"
+#include "utils/types.hpp"
+
+struct ProgramExecutor;
+
+// Runs the async phase for up to lane_count ants that share one decoded
+// program. The hot registers and flags are copied into columns (one lane per
+// ant) and the lanes are stepped in lockstep. Lanes sitting on the same
+// instruction form a LaneGroup and every round runs each group's instruction
+// once over all of its lanes. Straight line instructions keep a group
+// together; branches split it by target and groups reaching the same
+// instruction are merged again. A group of consecutive lanes runs as a plain
+// loop over the columns which the compiler vectorizes.
+//
+// Ops touching the stack, ram or scent state are rare in ant programs and
+// run on the ant's own DualRegisters through interpret().
+struct ProgramBatch {
+    static constexpr ulong lane_count = 256;
+
+    DecodedProgram const* program = nullptr;
+    ulong max_instruction_per_tick = 0;
+    ulong num_lanes = 0;
+    ulong num_executed = 0;  // instructions executed by the last run
+    ProgramExecutor* executors[lane_count] = {};
+
+    void clear(DecodedProgram const& program, ulong max_instruction_per_tick);
+    void add(ProgramExecutor&);
+    void run();
+
+   private:
+    static constexpr ushort none = 0xFFFF;
+
+    struct LaneGroup {
+        ushort instr_ptr;
+        ushort num_lanes;
+        // none unless the lanes are first_lane, first_lane + 1, ... in any
+        // order
+        ushort first_lane;
+        ushort const* lanes;
+        ushort next = none;  // next group merging into the same instruction
+    };
+
+    // columns - indexed by lane
+    cpu_word_size registers[2][lane_count] = {};
+    ushort instr_ptr[lane_count] = {};  // only current once the lane stops
+    uchar zero_flag[lane_count] = {};
+    uchar instr_failed_flag[lane_count] = {};
+    uchar dir_flag1[lane_count] = {};
+    uchar dir_flag2[lane_count] = {};
+    uchar is_space_empty_flags[lane_count] = {};
+
+    // lanes of the current and next round and of the groups split this round
+    ushort lane_buffers[3][lane_count] = {};
+    ushort next_lane[lane_count] = {};
+    std::vector<LaneGroup> groups;
+    std::vector<LaneGroup> successors;
+    // indexed by instruction address - all none between rounds
+    std::vector<ushort> lane_head, lane_tail;
+    std::vector<ushort> successor_head, successor_tail;
+    std::vector<ushort> touched;
+
+    void load_lane(ushort lane);
+    void store_lane(ushort lane);
+    bool is_async(ulong address) const;
+    void split(ushort const* lanes, ulong num_selected, ushort* out,
+               ulong& used);
+    void split_two_way(LaneGroup const&, ushort next, ushort target,
+                       ushort* out, ulong& used);
+    void regroup(ushort* out, bool is_budget_spent);
+    void step(Instruction const&, LaneGroup const&);
+    template <class Lanes>
+    void step_lanes(Instruction const&, ushort address, Lanes lanes,
+                    ulong num_selected);
+};
+
+// Groups the executors that are due this tick by program into batches.
+// Batches are reused between ticks so the columns are not reallocated.
+class BatchExecutor {
+    using BatchList = std::deque<ProgramBatch>;
+    BatchList batches;
+    ulong num_batches = 0;
+    // batch of each program that still has free lanes
+    std::unordered_map<DecodedProgram const*, ProgramBatch*> open_batches;
+
+   public:
+    void clear();
+    void add(ProgramExecutor&);
+    ulong size() const { return num_batches; }
+
+    BatchList::iterator begin() { return batches.begin(); }
+    BatchList::iterator end() {
+        return batches.begin() + static_cast<long>(num_batches);
+    }
+};
@@ -3,6 +3,7 @@
 #include "hardware/brain.hpp"
 #include "hardware/command_config.hpp"
 #include "hardware/compile_args.hpp"
+#include "hardware/instruction.hpp"
 #include "hardware/op_def.hpp"
 #include "hardware/program_executor.hpp"
 #include "spdlog/spdlog.h"
@@ -15,7 +16,12 @@ template <typename Operation, unsigned short TickCount = 0>
 struct NoArgCommandCompiler {
     void operator()(CommandConfig const& config, CompileArgs& args) {
         SPDLOG_TRACE("Compiling {} command", config.command_string);
-        args.ops.push_back({TickCount, Operation(args.cpu)});
+        if(args.is_decoded()) {
+            args.instructions->push_back(
+                {.opcode = Operation::opcode, .num_ticks = TickCount});
+        } else {
+            args.ops.push_back({TickCount, Operation(args.cpu)});
+        }
         ++args.code_it;
         SPDLOG_TRACE("{} command compiled", config.command_string);
         (void)config;
@@ -35,8 +41,17 @@ struct LoadConstantCompiler {
 
         cpu_word_size const value = v0 | (v1 << 8) | (v2 << 16) << (v3 << 24);
 
-        args.ops.push_back(
-            {TickCount, Operation(args.cpu, args.cpu[register_idx], value)});
+        if(args.is_decoded()) {
+            args.instructions->push_back(
+                {.opcode = Operation::opcode,
+                 .arg0 = static_cast<uchar>(register_idx),
+                 .num_ticks = TickCount,
+                 .value = value});
+        } else {
+            args.ops.push_back({TickCount, Operation(args.cpu,
+                                                     args.cpu[register_idx],
+                                                     value)});
+        }
 
         ++args.code_it;
         SPDLOG_TRACE("{} command compiled", config.command_string);
@@ -51,9 +66,16 @@ struct TwoRegisterCommandCompiler {
         uchar const register_names = *args.code_it;
         uchar const reg_src_idx = ((register_names >> 1) & 1);
         uchar const reg_dst_idx = (register_names & 1);
-        args.ops.push_back(
-            {TickCount, Operation(args.cpu, args.cpu[reg_src_idx],
-                                  args.cpu[reg_dst_idx])});
+        if(args.is_decoded()) {
+            args.instructions->push_back({.opcode = Operation::opcode,
+                                          .arg0 = reg_src_idx,
+                                          .arg1 = reg_dst_idx,
+                                          .num_ticks = TickCount});
+        } else {
+            args.ops.push_back(
+                {TickCount, Operation(args.cpu, args.cpu[reg_src_idx],
+                                      args.cpu[reg_dst_idx])});
+        }
 
         ++args.code_it;
         SPDLOG_TRACE("{} command compiled", config.command_string);
@@ -66,8 +88,14 @@ struct OneRegisterCommandCompiler {
     void operator()(CommandConfig const& config, CompileArgs& args) {
         SPDLOG_TRACE("Compiling {} command", config.command_string);
         uchar const register_idx = (*args.code_it) & 1;
-        args.ops.push_back(
-            {TickCount, Operation(args.cpu, args.cpu[register_idx])});
+        if(args.is_decoded()) {
+            args.instructions->push_back({.opcode = Operation::opcode,
+                                          .arg0 = register_idx,
+                                          .num_ticks = TickCount});
+        } else {
+            args.ops.push_back(
+                {TickCount, Operation(args.cpu, args.cpu[register_idx])});
+        }
 
         ++args.code_it;
         SPDLOG_TRACE("{} command compiled", config.command_string);
@@ -85,7 +113,12 @@ struct MoveAntCompiler {
         bool const dir_flag1 = (instruction & 0b010) != 0;
         bool const dir_flag2 = (instruction & 0b001) != 0;
 
-        if(has_direction) {
+        if(args.is_decoded()) {
+            args.instructions->push_back(
+                {.opcode = has_direction ? OpCode::MOVE_DIR : Operation::opcode,
+                 .arg0 = static_cast<uchar>(instruction & 0b011),
+                 .num_ticks = args.cpu.wait_move_tick_count});
+        } else if(has_direction) {
             DualRegisters& cpu = args.cpu;
             args.ops.push_back({
                 args.cpu.wait_move_tick_count,
@@ -112,7 +145,14 @@ struct DigAntCompiler {
     void operator()(CommandConfig const& config, CompileArgs& args) {
         SPDLOG_TRACE("Compiling {} command", config.command_string);
 
-        args.ops.push_back({args.cpu.wait_dig_tick_count, DigOp(args.cpu)});
+        if(args.is_decoded()) {
+            args.instructions->push_back(
+                {.opcode = Operation::opcode,
+                 .num_ticks = args.cpu.wait_dig_tick_count});
+        } else {
+            args.ops.push_back(
+                {args.cpu.wait_dig_tick_count, Operation(args.cpu)});
+        }
 
         ++args.code_it;
         SPDLOG_TRACE("{} command compiled - speed: {} tks / dig",
@@ -128,7 +168,15 @@ struct JumpCompiler {
         ushort lower_half = *(++args.code_it);
         ushort upper_half = *(++args.code_it);
         ushort const address = lower_half | (upper_half << 8);
-        args.ops.push_back({TickCount, Operation(args.cpu, address)});
+        if(args.is_decoded()) {
+            // same -1 offset as the closure ops (see JmpOp)
+            args.instructions->push_back(
+                {.opcode = Operation::opcode,
+                 .num_ticks = TickCount,
+                 .address = static_cast<ushort>(address - 1)});
+        } else {
+            args.ops.push_back({TickCount, Operation(args.cpu, address)});
+        }
 
         ++args.code_it;
         SPDLOG_TRACE("{} command compiled", config.command_string);
@@ -141,7 +189,13 @@ struct OneScentCommandCompiler {
     void operator()(CommandConfig const& config, CompileArgs& args) {
         SPDLOG_TRACE("Compiling {} command", config.command_string);
         uchar const scent_idx = (*args.code_it) & 0b111;
-        args.ops.push_back({TickCount, Operation(args.cpu, scent_idx)});
+        if(args.is_decoded()) {
+            args.instructions->push_back({.opcode = Operation::opcode,
+                                          .arg0 = scent_idx,
+                                          .num_ticks = TickCount});
+        } else {
+            args.ops.push_back({TickCount, Operation(args.cpu, scent_idx)});
+        }
 
         ++args.code_it;
         SPDLOG_TRACE("{} command compiled", config.command_string);
@@ -157,8 +211,15 @@ struct SetScentPriorityCompiler {
         ++args.code_it;
 
         uchar const priority = (*args.code_it);
-        args.ops.push_back(
-            {TickCount, Operation(args.cpu, scent_idx, priority)});
+        if(args.is_decoded()) {
+            args.instructions->push_back({.opcode = Operation::opcode,
+                                          .arg0 = scent_idx,
+                                          .arg1 = priority,
+                                          .num_ticks = TickCount});
+        } else {
+            args.ops.push_back(
+                {TickCount, Operation(args.cpu, scent_idx, priority)});
+        }
 
         ++args.code_it;
         SPDLOG_TRACE("{} command compiled", config.command_string);
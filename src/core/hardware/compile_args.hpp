@@ -2,6 +2,7 @@
 
 #include <vector>
 
+#include "hardware/instruction.hpp"
 #include "hardware/program_executor.hpp"
 #include "utils/status.hpp"
 
@@ -14,9 +15,22 @@ struct CompileArgs {
     std::vector<uchar>::const_iterator code_it;
     DualRegisters& cpu;
     std::vector<Op>& ops;
+    // When set, the compilers emit decoded instructions here instead of
+    // closures into ops.
+    std::vector<Instruction>* instructions = nullptr;
     Status status;
 
     CompileArgs(std::vector<uchar> const& code, DualRegisters& cpu,
                 std::vector<Op>& ops)
         : code(code), code_it(code.begin()), cpu(cpu), ops(ops) {}
+
+    CompileArgs(std::vector<uchar> const& code, DualRegisters& cpu,
+                std::vector<Op>& ops, std::vector<Instruction>& instructions)
+        : code(code),
+          code_it(code.begin()),
+          cpu(cpu),
+          ops(ops),
+          instructions(&instructions) {}
+
+    bool is_decoded() const { return instructions != nullptr; }
 };
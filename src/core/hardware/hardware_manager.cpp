@@ -1,24 +1,219 @@
 #include "hardware/hardware_manager.hpp"
 
+#include <algorithm>
+#include <cassert>
+
 #include "hardware.pb.h"
+#include "hardware/compile_args.hpp"
+#include "hardware/machine_code.hpp"
 #include "hardware/program_executor.hpp"
+#include "spdlog/spdlog.h"
 #include "utils/serializer.hpp"
+#include "utils/thread_pool.hpp"
 
-HardwareManager::HardwareManager(CommandMap const& command_map)
-    : compiler(command_map) {}
+HardwareManager::HardwareManager(CommandMap const& command_map,
+                                 ExecutionMode execution_mode,
+                                 OptimizerPasses optimizer_passes)
+    : compiler(command_map),
+      execution_mode(execution_mode),
+      optimizer_passes(optimizer_passes) {}
 HardwareManager::HardwareManager(const ant_proto::HardwareManager&,
-                                 CommandMap const& command_map)
-    : compiler(command_map) {
+                                 CommandMap const& command_map,
+                                 ExecutionMode execution_mode,
+                                 OptimizerPasses optimizer_passes)
+    : compiler(command_map),
+      execution_mode(execution_mode),
+      optimizer_passes(optimizer_passes) {
     // Does not take ownership of program executor objects.
     SPDLOG_TRACE("Not unpacking empty hardware manager");
 }
+
+HardwareManager::~HardwareManager() {
+    if(is_profiling_blocks) log_block_profile();
+    for(auto& [code, program] : program_cache) delete program;
+    program_cache.clear();
+}
+
 // Does not take ownership
 void HardwareManager::push_back(ProgramExecutor* exec) {
     exec_list.push_back(exec);
+    woken_list.resize(exec_list.size());
+    exec->hardware_manager = this;
+    if(exec->instr_trigger > 0) {
+        // begin_async would count the trigger down to 0 first
+        timer_wheel.schedule(*exec,
+                             timer_wheel.tick() + exec->instr_trigger + 1);
+        return;
+    }
+    exec->is_ready = true;
+    ready_list.push_back(exec);
+}
+
+void HardwareManager::begin_tick() {
+    ulong const num_ready = ready_list.size();
+    timer_wheel.advance(ready_list);
+    for(ulong idx = num_ready; idx < ready_list.size(); ++idx) {
+        ready_list[idx]->instr_trigger = 0;
+        ready_list[idx]->is_ready = true;
+    }
+    ulong const woken = num_woken.exchange(0);
+    for(ulong idx = 0; idx < woken; ++idx) {
+        ProgramExecutor* exec = woken_list[idx];
+        if(exec->is_ready || exec->is_parked) continue;
+        exec->is_ready = true;
+        ready_list.push_back(exec);
+    }
+}
+
+void HardwareManager::end_tick() {
+    ulong num_ready = 0;
+    for(ProgramExecutor* exec : ready_list) {
+        if(exec->is_parked || exec->instr_ptr_register >= exec->size()) {
+            exec->is_ready = false;
+            continue;
+        }
+        if(exec->instr_trigger > 0) {
+            // runs again once begin_async would have counted the trigger
+            // down to 0
+            exec->is_ready = false;
+            exec->has_executed_async = false;
+            timer_wheel.schedule(
+                *exec, timer_wheel.tick() + exec->instr_trigger + 1);
+            continue;
+        }
+        ready_list[num_ready++] = exec;
+    }
+    ready_list.resize(num_ready);
+    SPDLOG_TRACE("Ended tick {} - {} ready, {} waiting of {} executors",
+                 timer_wheel.tick(), ready_list.size(), timer_wheel.size(),
+                 exec_list.size());
+}
+
+// Called from ProgramExecutor::wake between ticks, possibly from several
+// threads at once
+void HardwareManager::wake(ProgramExecutor& exec) {
+    ulong const idx = num_woken.fetch_add(1, std::memory_order_relaxed);
+    assert(idx < woken_list.size());
+    woken_list[idx] = &exec;
+}
+
+void HardwareManager::store_wait_ticks() const {
+    ulong const tick = timer_wheel.tick();
+    timer_wheel.for_each([tick](TimerWheel::Timer const& timer) {
+        timer.exec->instr_trigger = timer.due - tick - 1;
+    });
 }
 
 void HardwareManager::compile(CompileArgs& args) { compiler.compile(args); }
 
+// Compiles the machine code once and shares the decoded program with every
+// later caller that passes the same code.
+DecodedProgram const* HardwareManager::get_program(
+    MachineCode const& machine_code, Status& status) {
+    std::string key(machine_code.code.begin(), machine_code.code.end());
+    auto it = program_cache.find(key);
+    if(it != program_cache.end()) {
+        SPDLOG_TRACE("Reusing decoded program - {} instructions",
+                     it->second->size());
+        return it->second;
+    }
+
+    DecodedProgram* program = new DecodedProgram();
+    std::vector<Op> unused_ops;
+    CompileArgs args(machine_code.code, decode_registers, unused_ops,
+                     program->instructions);
+    compiler.compile(args);
+    if(args.status.p_err) {
+        status.error(args.status.err_msg);
+        delete program;
+        return nullptr;
+    }
+    optimize(program->instructions, optimizer_passes);
+    program->build_blocks();
+    program->is_profiled = is_profiling_blocks;
+
+    SPDLOG_DEBUG("Decoded new program - {} bytes -> {} instructions",
+                 machine_code.size(), program->size());
+    program_cache.emplace(std::move(key), program);
+    return program;
+}
+
+void HardwareManager::set_block_profiling(bool is_profiling) {
+    is_profiling_blocks = is_profiling;
+    for(auto& [code, program] : program_cache) {
+        program->is_profiled = is_profiling;
+    }
+}
+
+// Logs how often every basic block was entered by the async runner. Blocks
+// entered mid way after a budget cut are counted again when resumed.
+void HardwareManager::log_block_profile() const {
+    for(auto const& [code, program] : program_cache) {
+        SPDLOG_INFO("Block profile - program of {} instructions, {} blocks",
+                    program->size(), program->blocks.size());
+        for(ulong idx = 0; idx < program->blocks.size(); ++idx) {
+            BasicBlock const& block = program->blocks[idx];
+            SPDLOG_INFO("  [{:>4}, {:>4}){} executed {}", block.start,
+                        block.start + block.length,
+                        block.ends_in_sync ? " sync" : "",
+                        program->block_executions[idx].load(
+                            std::memory_order_relaxed));
+        }
+    }
+}
+
+// ExecutionMode::BATCH replacement for calling execute_async on every
+// executor - submits one job per ProgramBatch instead of one per ant.
+void HardwareManager::execute_async_batched(
+    ThreadPool<AsyncProgramJob>& job_pool) {
+    batch_executor.clear();
+    for(ProgramExecutor* exec : ready_list) {
+        if(!exec->begin_async()) continue;
+        if(exec->is_watching_cycle) {
+            // the cycle check only runs in the single executor path
+            AsyncProgramJob job(*exec);
+            job_pool.submit_job(job);
+            continue;
+        }
+        batch_executor.add(*exec);
+    }
+    for(ProgramBatch& batch : batch_executor) {
+        AsyncProgramJob job(batch);
+        job_pool.submit_job(job);
+    }
+    SPDLOG_TRACE("Submitted {} program batches for {} executors",
+                 batch_executor.size(), ready_list.size());
+}
+
+// A few jobs per thread so a slow span does not leave the other threads
+// idle, but never so few executors per job that the pool's locking
+// outweighs running them.
+ulong HardwareManager::adaptive_job_span(ulong num_executors,
+                                         ulong num_threads) {
+    constexpr ulong jobs_per_thread = 4;
+    constexpr ulong min_job_span = 16;
+    ulong const num_jobs = std::max(num_threads, 1ul) * jobs_per_thread;
+    return std::max((num_executors + num_jobs - 1) / num_jobs, min_job_span);
+}
+
+void HardwareManager::execute_async_spans(
+    ThreadPool<AsyncProgramJob>& job_pool) {
+    started_list.clear();
+    for(ProgramExecutor* exec : ready_list) {
+        if(exec->begin_async()) started_list.push_back(exec);
+    }
+    ulong const span =
+        job_span != 0 ? job_span
+                      : adaptive_job_span(started_list.size(), job_pool.size());
+    for(ulong first = 0; first < started_list.size(); first += span) {
+        AsyncProgramJob job(started_list.data() + first,
+                            std::min(span, started_list.size() - first));
+        job_pool.submit_job(job);
+    }
+    SPDLOG_TRACE("Submitted {} executors in spans of {}", started_list.size(),
+                 span);
+}
+
 Packer& operator<<(Packer& p, HardwareManager const&) {
     // Does not take ownership of executor objects.
     SPDLOG_TRACE("Not packing empty hardware manager");
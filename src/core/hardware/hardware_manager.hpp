@@ -1,27 +1,96 @@
 #pragma once
 
+#include <atomic>
 #include <hardware/compiler.hpp>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "hardware.pb.h"
+#include "hardware/batch_executor.hpp"
+#include "hardware/brain.hpp"
+#include "hardware/instruction.hpp"
+#include "hardware/optimizer.hpp"
+#include "hardware/timer_wheel.hpp"
+#include "utils/status.hpp"
 
 struct ProgramExecutor;
+struct AsyncProgramJob;
 struct CompileArgs;
+struct MachineCode;
+template <class ThreadTask>
+class ThreadPool;
 
 struct HardwareManager {
    private:
     using ExecutorList = std::vector<ProgramExecutor*>;
+    // keyed by the machine code bytes - labels do not affect the compiled
+    // program since jump addresses are already resolved in the code
+    using ProgramCache = std::unordered_map<std::string, DecodedProgram*>;
     ExecutorList exec_list;
+    // Executors that run this tick. The ones waiting for the wait ticks of
+    // a sync instruction sit in the timer wheel instead, parked and finished
+    // ones in neither.
+    ExecutorList ready_list;
+    // Parked executors woken since the last tick. The levels of the frame
+    // graph wake their ants concurrently, so the list is sized for every
+    // executor up front - each one is woken at most once per tick.
+    ExecutorList woken_list;
+    std::atomic<ulong> num_woken = 0;
+    ExecutorList started_list;  // ready executors due for the async phase
+    TimerWheel timer_wheel;
+    ProgramCache program_cache;
     Compiler compiler;
+    // Only supplies the wait tick counts while decoding. Decoded
+    // instructions never bind a register file.
+    DualRegisters decode_registers;
+    BatchExecutor batch_executor;
+    bool is_profiling_blocks = false;
+    ulong job_span = 0;  // see set_job_span
 
    public:
-    HardwareManager(CommandMap const&);
-    HardwareManager(const ant_proto::HardwareManager& msg, CommandMap const&);
+    ExecutionMode const execution_mode;
+    OptimizerPasses const optimizer_passes;
+
+    HardwareManager(CommandMap const&,
+                    ExecutionMode execution_mode = ExecutionMode::DECODED,
+                    OptimizerPasses optimizer_passes = {});
+    HardwareManager(const ant_proto::HardwareManager& msg, CommandMap const&,
+                    ExecutionMode execution_mode = ExecutionMode::DECODED,
+                    OptimizerPasses optimizer_passes = {});
+    ~HardwareManager();
     void push_back(ProgramExecutor*);
+    // Fills the ready list for the next tick
+    void begin_tick();
+    // Files the ready executors that started waiting into the timer wheel
+    // and drops the parked and finished ones. Call after the sync phase.
+    void end_tick();
+    void wake(ProgramExecutor&);
+    // The executors in the timer wheel only learn their remaining wait
+    // ticks here - call before serializing them.
+    void store_wait_ticks() const;
+    ExecutorList const& ready() const { return ready_list; }
+    ulong num_waiting() const { return timer_wheel.size(); }
     void compile(CompileArgs&);
+    DecodedProgram const* get_program(MachineCode const&, Status&);
+    ulong num_programs() const { return program_cache.size(); }
+    void execute_async_batched(ThreadPool<AsyncProgramJob>&);
+    // Submits the async phase of the ready executors in spans of job_span
+    // executors per job instead of one job per executor
+    void execute_async_spans(ThreadPool<AsyncProgramJob>&);
+    // 0 picks the span from the number of executors and threads
+    void set_job_span(ulong span) { job_span = span; }
+    static ulong adaptive_job_span(ulong num_executors, ulong num_threads);
+    // Counts basic block executions of every program, logged on destruction
+    void set_block_profiling(bool is_profiling);
+    void log_block_profile() const;
 
     ExecutorList::iterator begin() { return exec_list.begin(); }
     ExecutorList::iterator end() { return exec_list.end(); }
 
+    // Delete the copy constructor and copy assignment operator
+    HardwareManager(const HardwareManager&) = delete;
+    HardwareManager& operator=(const HardwareManager&) = delete;
+
     friend Packer& operator<<(Packer&, HardwareManager const&);
 };
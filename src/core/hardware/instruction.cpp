@@ -0,0 +1,377 @@
+#include "hardware/instruction.hpp"
+
+#include <algorithm>
+
+#include "hardware/brain.hpp"
+#include "spdlog/spdlog.h"
+
+// The switch mirrors the op structs in hardware/op_def.cpp one to one. Keep
+// both in sync - the closure executor is still selectable through
+// ExecutionMode::CLOSURE and is used as the reference in the unit tests.
+static inline void interpret_inline(Instruction const& instr,
+                                    DualRegisters& cpu) {
+    // jumps below overwrite the instruction pointer again
+    cpu.instr_ptr_register =
+        static_cast<ushort>(cpu.instr_ptr_register + instr.skip);
+    switch(instr.opcode) {
+        case OpCode::NOP:
+            break;
+        case OpCode::LOAD: {
+            cpu.registers[instr.arg0] = instr.value;
+            cpu.zero_flag = instr.value == 0;
+            break;
+        }
+        case OpCode::MOVE_DIR:
+            cpu.dir_flag1 = (instr.arg0 & 0b10) != 0;
+            cpu.dir_flag2 = (instr.arg0 & 0b01) != 0;
+            [[fallthrough]];
+        case OpCode::MOVE:
+            cpu.is_move_flag = true;
+            break;
+        case OpCode::DIG:
+            cpu.is_dig_flag = true;
+            break;
+        case OpCode::COPY: {
+            cpu_word_size const src = cpu.registers[instr.arg0];
+            cpu.registers[instr.arg1] = src;
+            cpu.zero_flag = src == 0;
+            break;
+        }
+        case OpCode::ADD: {
+            cpu_word_size& dst = cpu.registers[instr.arg1];
+            dst += cpu.registers[instr.arg0];
+            cpu.zero_flag = dst == 0;
+            break;
+        }
+        case OpCode::SUB: {
+            cpu_word_size& dst = cpu.registers[instr.arg1];
+            dst -= cpu.registers[instr.arg0];
+            cpu.zero_flag = dst == 0;
+            break;
+        }
+        case OpCode::INC: {
+            cpu_word_size& reg = cpu.registers[instr.arg0];
+            ++reg;
+            cpu.zero_flag = reg == 0;
+            break;
+        }
+        case OpCode::DEC: {
+            cpu_word_size& reg = cpu.registers[instr.arg0];
+            --reg;
+            cpu.zero_flag = reg == 0;
+            break;
+        }
+        case OpCode::JMP:
+            cpu.instr_ptr_register = instr.address;
+            break;
+        case OpCode::JNZ:
+            if(!cpu.zero_flag) cpu.instr_ptr_register = instr.address;
+            break;
+        case OpCode::JNF:
+            if(!cpu.instr_failed_flag) cpu.instr_ptr_register = instr.address;
+            break;
+        case OpCode::CALL:
+            cpu.ram[cpu.stack_ptr_register++] = cpu.instr_ptr_register;
+            cpu.ram[cpu.stack_ptr_register++] = cpu.base_ptr_register;
+            cpu.instr_ptr_register = instr.address;
+            cpu.base_ptr_register = cpu.stack_ptr_register;
+            break;
+        case OpCode::RET:
+            cpu.stack_ptr_register = cpu.base_ptr_register;
+            cpu.base_ptr_register =
+                static_cast<ushort>(cpu.ram[--cpu.stack_ptr_register]);
+            cpu.instr_ptr_register =
+                static_cast<ushort>(cpu.ram[--cpu.stack_ptr_register]);
+            break;
+        case OpCode::LT:
+            // see TurnLeftOp for the truth table
+            cpu.dir_flag1 = cpu.dir_flag1 != cpu.dir_flag2;
+            cpu.dir_flag2 = !cpu.dir_flag2;
+            break;
+        case OpCode::RT:
+            // see TurnRightOp for the truth table
+            cpu.dir_flag1 = cpu.dir_flag1 == cpu.dir_flag2;
+            cpu.dir_flag2 = !cpu.dir_flag2;
+            break;
+        case OpCode::PUSH:
+            cpu.ram[cpu.stack_ptr_register++] = cpu.registers[instr.arg0];
+            break;
+        case OpCode::POP:
+            cpu.registers[instr.arg0] = cpu.ram[--cpu.stack_ptr_register];
+            break;
+        case OpCode::CHECK: {
+            uchar idx = static_cast<uchar>(
+                (static_cast<uchar>(cpu.dir_flag1) << 1) |
+                static_cast<uchar>(cpu.dir_flag2));
+            cpu.instr_failed_flag = !((cpu.is_space_empty_flags >> idx) & 1);
+            break;
+        }
+        case OpCode::SCENT_ON:
+            cpu.scent_behaviors.write_scent_behavior =
+                IncrementScentBehavior(cpu.delta_scents, instr.arg0);
+            break;
+        case OpCode::SCENT_OFF:
+            cpu.scent_behaviors.write_scent_behavior = ImmutableScentBehavior();
+            break;
+        case OpCode::SET_SCENT_PRIORITY: {
+            ulong const shift = static_cast<ulong>(instr.arg0) * 8;
+            ulong const clear_mask = ~(static_cast<ulong>(0xFF) << shift);
+            ulong const priority = static_cast<ulong>(instr.arg1) << shift;
+            ulong& priorities = cpu.scent_behaviors.priorities;
+            priorities = (priorities & clear_mask) | priority;
+            break;
+        }
+        case OpCode::TURN_SCENT:
+            cpu.dir_flag1 = cpu.scent_behaviors.scent_dir1;
+            cpu.dir_flag2 = cpu.scent_behaviors.scent_dir2;
+            break;
+        case OpCode::TURN_AROUND:
+            cpu.dir_flag1 = !cpu.dir_flag1;
+            break;
+        case OpCode::LT_MOVE:
+            cpu.dir_flag1 = cpu.dir_flag1 != cpu.dir_flag2;
+            cpu.dir_flag2 = !cpu.dir_flag2;
+            cpu.is_move_flag = true;
+            break;
+        case OpCode::RT_MOVE:
+            cpu.dir_flag1 = cpu.dir_flag1 == cpu.dir_flag2;
+            cpu.dir_flag2 = !cpu.dir_flag2;
+            cpu.is_move_flag = true;
+            break;
+        case OpCode::INC_JNZ: {
+            cpu_word_size& reg = cpu.registers[instr.arg0];
+            ++reg;
+            cpu.zero_flag = reg == 0;
+            if(!cpu.zero_flag) cpu.instr_ptr_register = instr.address;
+            break;
+        }
+        case OpCode::DEC_JNZ: {
+            cpu_word_size& reg = cpu.registers[instr.arg0];
+            --reg;
+            cpu.zero_flag = reg == 0;
+            if(!cpu.zero_flag) cpu.instr_ptr_register = instr.address;
+            break;
+        }
+        case OpCode::PUSH_POP: {
+            // the pushed value stays in ram above the stack pointer
+            cpu_word_size const value = cpu.registers[instr.arg0];
+            cpu.ram[cpu.stack_ptr_register] = value;
+            cpu.registers[instr.arg1] = value;
+            break;
+        }
+        case OpCode::LOAD_JMP:
+            cpu.registers[instr.arg0] = instr.value;
+            cpu.zero_flag = false;
+            cpu.instr_ptr_register = instr.address;
+            break;
+    }
+}
+
+void interpret(Instruction const& instr, DualRegisters& cpu) {
+    SPDLOG_TRACE("Interpreting opcode {} at instruction address: {}",
+                 static_cast<int>(instr.opcode), cpu.instr_ptr_register);
+    interpret_inline(instr, cpu);
+}
+
+// Runs up to budget instructions of the block at cpu.instr_ptr_register.
+// Returns the number executed - 0 when the instruction there is sync.
+static inline ulong run_block(DecodedProgram const& program,
+                              DualRegisters& cpu, ulong budget) {
+    ushort const start = cpu.instr_ptr_register;
+    ulong const run = std::min<ulong>(program.async_run[start], budget);
+    if(run == 0) return 0;
+    if(program.is_profiled) {
+        program.block_executions[program.block_index[start]].fetch_add(
+            1, std::memory_order_relaxed);
+    }
+
+    // Only the last instruction of a run can jump or push the instruction
+    // pointer, the others never read it.
+    Instruction const* instructions = program.instructions.data();
+    ulong const last = start + run - 1;
+    for(ulong idx = start; idx < last; ++idx) {
+        interpret_inline(instructions[idx], cpu);
+    }
+    cpu.instr_ptr_register = static_cast<ushort>(last);
+    interpret_inline(instructions[last], cpu);
+    ++cpu.instr_ptr_register;
+    return run;
+}
+
+ulong interpret_async(DecodedProgram const& program, DualRegisters& cpu,
+                      ulong budget) {
+    ulong const program_size = program.size();
+    ulong executed = 0;
+    while(executed < budget && cpu.instr_ptr_register < program_size) {
+        ulong const run = run_block(program, cpu, budget - executed);
+        if(run == 0) break;  // sync instructions run in sync phase
+        executed += run;
+    }
+    SPDLOG_TRACE("Interpreted {} async instructions - instruction address: {}",
+                 executed, cpu.instr_ptr_register);
+    return executed;
+}
+
+namespace {
+// Everything async instructions read or write apart from the inputs that
+// only change between ticks (is_space_empty_flags and the scent
+// directions).
+struct CpuSnapshot {
+    cpu_word_size registers[2] = {};
+    cpu_word_size ram[64] = {};
+    ulong priorities = 0;
+    ushort instr_ptr = 0, base_ptr = 0, stack_ptr = 0;
+    bool zero_flag = false, instr_failed_flag = false;
+    bool dir_flag1 = false, dir_flag2 = false;
+
+    void take(DualRegisters const& cpu) {
+        std::copy_n(cpu.registers, 2, registers);
+        std::copy_n(cpu.ram, 64, ram);
+        priorities = cpu.scent_behaviors.priorities;
+        instr_ptr = cpu.instr_ptr_register;
+        base_ptr = cpu.base_ptr_register;
+        stack_ptr = cpu.stack_ptr_register;
+        zero_flag = cpu.zero_flag;
+        instr_failed_flag = cpu.instr_failed_flag;
+        dir_flag1 = cpu.dir_flag1;
+        dir_flag2 = cpu.dir_flag2;
+    }
+
+    bool matches(DualRegisters const& cpu) const {
+        return instr_ptr == cpu.instr_ptr_register &&
+               registers[0] == cpu.registers[0] &&
+               registers[1] == cpu.registers[1] &&
+               zero_flag == cpu.zero_flag &&
+               instr_failed_flag == cpu.instr_failed_flag &&
+               dir_flag1 == cpu.dir_flag1 && dir_flag2 == cpu.dir_flag2 &&
+               base_ptr == cpu.base_ptr_register &&
+               stack_ptr == cpu.stack_ptr_register &&
+               priorities == cpu.scent_behaviors.priorities &&
+               std::equal(ram, ram + 64, cpu.ram);
+    }
+};
+}  // namespace
+
+// Brent's cycle detection over the states at block entries: the state is
+// saved at block entries 1, 2, 4, 8, ... and every later entry is compared
+// with the last saved one, so a cycle of n blocks is found within a few
+// times n entries. A block that writes the scent behaviour has an effect
+// outside the registers and restarts the search.
+ulong interpret_async_until_cycle(DecodedProgram const& program,
+                                  DualRegisters& cpu, ulong budget,
+                                  bool& is_cycle) {
+    ulong const program_size = program.size();
+    ulong executed = 0;
+    CpuSnapshot saved;
+    bool has_saved = false;
+    ulong power = 1, distance = 0;
+    is_cycle = false;
+    while(executed < budget && cpu.instr_ptr_register < program_size) {
+        BasicBlock const& block =
+            program.blocks[program.block_index[cpu.instr_ptr_register]];
+        if(block.has_scent_write) {
+            has_saved = false;
+        } else if(has_saved && saved.matches(cpu)) {
+            is_cycle = true;
+            break;
+        } else if(!has_saved || ++distance == power) {
+            saved.take(cpu);
+            has_saved = true;
+            power *= 2;
+            distance = 0;
+        }
+
+        ulong const run = run_block(program, cpu, budget - executed);
+        if(run == 0) break;
+        executed += run;
+    }
+    SPDLOG_TRACE("Interpreted {} async instructions - cycle: {}", executed,
+                 is_cycle);
+    return executed;
+}
+
+bool has_jump_address(OpCode opcode) {
+    switch(opcode) {
+        case OpCode::JMP:
+        case OpCode::JNZ:
+        case OpCode::JNF:
+        case OpCode::CALL:
+        case OpCode::INC_JNZ:
+        case OpCode::DEC_JNZ:
+        case OpCode::LOAD_JMP:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool ends_block(Instruction const& instr) {
+    return instr.num_ticks != 0 || instr.skip != 0 ||
+           instr.opcode == OpCode::RET || has_jump_address(instr.opcode);
+}
+
+static bool falls_through(OpCode opcode) {
+    return opcode != OpCode::JMP && opcode != OpCode::LOAD_JMP &&
+           opcode != OpCode::CALL && opcode != OpCode::RET;
+}
+
+void DecodedProgram::build_blocks() {
+    ulong const program_size = size();
+    std::vector<bool> is_leader(program_size, false);
+    if(program_size > 0) is_leader[0] = true;
+    for(ulong idx = 0; idx < program_size; ++idx) {
+        Instruction const& instr = instructions[idx];
+        if(has_jump_address(instr.opcode)) {
+            ulong const target = static_cast<ushort>(instr.address + 1);
+            if(target < program_size) is_leader[target] = true;
+        }
+        if(ends_block(instr) && idx + 1 < program_size) {
+            is_leader[idx + 1] = true;
+        }
+        // CALL returns to the instruction after it, a skip lands further on
+        ulong const next = idx + 1 + instr.skip;
+        if(instr.skip != 0 && next < program_size) is_leader[next] = true;
+    }
+
+    blocks.clear();
+    async_run.assign(program_size, 0);
+    block_index.assign(program_size, 0);
+    for(ulong start = 0; start < program_size;) {
+        ulong end = start + 1;
+        while(end < program_size && !is_leader[end]) ++end;
+
+        Instruction const& last = instructions[end - 1];
+        BasicBlock block;
+        block.start = static_cast<ushort>(start);
+        block.length = static_cast<ushort>(end - start);
+        block.ends_in_sync = last.num_ticks != 0;
+        block.has_scent_write = std::any_of(
+            instructions.begin() + static_cast<long>(start),
+            instructions.begin() + static_cast<long>(end),
+            [](Instruction const& instr) {
+                return instr.opcode == OpCode::SCENT_ON ||
+                       instr.opcode == OpCode::SCENT_OFF;
+            });
+        if(has_jump_address(last.opcode)) {
+            block.successors[0] = static_cast<ushort>(last.address + 1);
+        }
+        if(falls_through(last.opcode) && end + last.skip < program_size) {
+            block.successors[1] = static_cast<ushort>(end + last.skip);
+        }
+
+        ulong const num_async = block.length - block.ends_in_sync;
+        for(ulong idx = start; idx < end; ++idx) {
+            async_run[idx] =
+                static_cast<ushort>(idx < start + num_async
+                                        ? start + num_async - idx
+                                        : 0);
+            block_index[idx] = static_cast<ushort>(blocks.size());
+        }
+        blocks.push_back(block);
+        start = end;
+    }
+
+    block_executions = std::make_unique<std::atomic<ulong>[]>(blocks.size());
+    SPDLOG_DEBUG("Split program of {} instructions into {} basic blocks",
+                 program_size, blocks.size());
+}
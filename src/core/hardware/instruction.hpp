@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "app/globals.hpp"
+#include "utils/types.hpp"
+
+struct DualRegisters;
+
+// Selects how a ProgramExecutor runs its program.
+//   CLOSURE - one std::function per instruction bound to the ant's registers
+//   DECODED - flat array of POD instructions run by a switch interpreter
+//   BATCH   - decoded programs with the async phase run lockstep over all
+//             the ants sharing a program (see ProgramBatch)
+enum class ExecutionMode : uchar { CLOSURE, DECODED, BATCH };
+
+enum class OpCode : uchar {
+    NOP,
+    LOAD,
+    MOVE,
+    MOVE_DIR,
+    DIG,
+    COPY,
+    ADD,
+    SUB,
+    INC,
+    DEC,
+    JMP,
+    JNZ,
+    JNF,
+    CALL,
+    RET,
+    LT,
+    RT,
+    PUSH,
+    POP,
+    CHECK,
+    SCENT_ON,
+    SCENT_OFF,
+    SET_SCENT_PRIORITY,
+    TURN_SCENT,
+    // superinstructions - only produced by optimize() in hardware/optimizer
+    TURN_AROUND,  // LT;LT or RT;RT
+    LT_MOVE,
+    RT_MOVE,
+    INC_JNZ,
+    DEC_JNZ,
+    PUSH_POP,
+    LOAD_JMP  // LOAD of a non zero constant followed by JNZ
+};
+
+// Decoded instruction. Operands are interpreted per opcode:
+//   arg0     - register index (one register ops), source register (two
+//              register ops), scent index or heading flags (MOVE_DIR)
+//   arg1     - destination register (two register ops) or scent priority
+//   address  - jump target already offset by -1 like the closure ops, since
+//              the executor increments the instruction pointer afterwards
+//   value    - constant for LOAD
+//   skip     - number of following instructions a superinstruction covers.
+//              They stay in place so jumps into the middle of a fused
+//              sequence and saved instruction pointers remain valid.
+struct Instruction {
+    OpCode opcode = OpCode::NOP;
+    uchar arg0 = 0;
+    uchar arg1 = 0;
+    uchar skip = 0;
+    ushort num_ticks = 0;
+    ushort address = 0;
+    cpu_word_size value = 0;
+};
+
+static_assert(std::is_trivially_copyable_v<Instruction>);
+static_assert(sizeof(Instruction) <= 12);
+
+// True for instructions whose address field holds a jump target.
+bool has_jump_address(OpCode opcode);
+
+// Straight line run of instructions. Only the last instruction of a block
+// can be sync, jump or skip ahead, and only the first can be jumped to.
+struct BasicBlock {
+    static constexpr ushort no_successor = 0xFFFF;
+
+    ushort start = 0;
+    ushort length = 0;
+    bool ends_in_sync = false;
+    bool has_scent_write = false;  // SCENT_ON or SCENT_OFF
+    // jump target and fall through address - no_successor when unknown (RET)
+    // or not reachable
+    ushort successors[2] = {no_successor, no_successor};
+};
+
+// A decoded program does not reference any register file, so one instance is
+// shared by every ant running the same machine code (see
+// HardwareManager::get_program).
+struct DecodedProgram {
+    std::vector<Instruction> instructions;
+    std::vector<BasicBlock> blocks;
+    // per instruction - async instructions from here to the end of its block
+    std::vector<ushort> async_run;
+    std::vector<ushort> block_index;  // per instruction
+    // Counted while is_profiled is set. Relaxed atomics since async jobs
+    // share the program.
+    bool is_profiled = false;
+    std::unique_ptr<std::atomic<ulong>[]> block_executions;
+
+    ulong size() const { return instructions.size(); }
+    // Splits the instructions into basic blocks. Must run after the program
+    // is final (compiled and optimized) and before it is executed.
+    void build_blocks();
+};
+
+// Executes one decoded instruction against the register file. Does not
+// advance the instruction pointer.
+void interpret(Instruction const& instr, DualRegisters& cpu);
+
+// Executes async instructions starting at cpu.instr_ptr_register until a
+// sync instruction (num_ticks != 0), the end of the program or the budget is
+// reached. Runs whole basic blocks without per instruction checks. Returns
+// the number of instructions executed.
+ulong interpret_async(DecodedProgram const& program, DualRegisters& cpu,
+                      ulong budget);
+
+// interpret_async that also stops when the ant repeats a state it was in
+// earlier in this call. is_cycle is then set and the ant would spin in the
+// same loop until is_space_empty_flags or the scent directions change.
+ulong interpret_async_until_cycle(DecodedProgram const& program,
+                                  DualRegisters& cpu, ulong budget,
+                                  bool& is_cycle);
@@ -4,6 +4,7 @@
 
 #include "app/globals.hpp"
 #include "entity/scents.hpp"
+#include "hardware/instruction.hpp"
 #include "utils/types.hpp"
 
 using uchar = unsigned char;
@@ -12,12 +13,14 @@ using schar = signed char;
 struct DualRegisters;
 
 struct NoOP {
+    static constexpr OpCode opcode = OpCode::NOP;
     NoOP(DualRegisters&);
     void operator()();
 };
 
 // load a constant to the register
 struct LoadConstantOp {
+    static constexpr OpCode opcode = OpCode::LOAD;
     LoadConstantOp(DualRegisters&, cpu_word_size& reg,
                    cpu_word_size const value);
     void operator()();
@@ -29,17 +32,20 @@ struct LoadConstantOp {
 };
 
 struct MoveOp {
+    static constexpr OpCode opcode = OpCode::MOVE;
     MoveOp(DualRegisters&);
     void operator()();
     bool& is_move_flag;
 };
 
 struct DigOp {
+    static constexpr OpCode opcode = OpCode::DIG;
     DigOp(DualRegisters&);
     void operator()();
     bool& is_dig_flag;
 };
 struct CopyOp {
+    static constexpr OpCode opcode = OpCode::COPY;
     CopyOp(DualRegisters&, cpu_word_size& reg_src, cpu_word_size& reg_dst);
     void operator()();
     cpu_word_size &reg_src, &reg_dst;
@@ -47,6 +53,7 @@ struct CopyOp {
 };
 
 struct AddOp {
+    static constexpr OpCode opcode = OpCode::ADD;
     AddOp(DualRegisters&, cpu_word_size& reg_src, cpu_word_size& reg_dst);
     void operator()();
     cpu_word_size &reg_src, &reg_dst;
@@ -54,6 +61,7 @@ struct AddOp {
 };
 
 struct SubOp {
+    static constexpr OpCode opcode = OpCode::SUB;
     SubOp(DualRegisters&, cpu_word_size& reg_src, cpu_word_size& reg_dst);
     void operator()();
     cpu_word_size &reg_src, &reg_dst;
@@ -61,6 +69,7 @@ struct SubOp {
 };
 
 struct IncOp {
+    static constexpr OpCode opcode = OpCode::INC;
     IncOp(DualRegisters&, cpu_word_size& reg);
     void operator()();
     cpu_word_size& reg;
@@ -68,6 +77,7 @@ struct IncOp {
 };
 
 struct DecOp {
+    static constexpr OpCode opcode = OpCode::DEC;
     DecOp(DualRegisters&, cpu_word_size& reg);
     void operator()();
     cpu_word_size& reg;
@@ -75,6 +85,7 @@ struct DecOp {
 };
 
 struct JmpOp {
+    static constexpr OpCode opcode = OpCode::JMP;
     JmpOp(DualRegisters&, ushort address);
     void operator()();
     ushort& instr_ptr_register;
@@ -82,6 +93,7 @@ struct JmpOp {
 };
 
 struct JnzOp {
+    static constexpr OpCode opcode = OpCode::JNZ;
     JnzOp(DualRegisters&, ushort address);
     void operator()();
     ushort& instr_ptr_register;
@@ -90,6 +102,7 @@ struct JnzOp {
 };
 
 struct JnfOp {
+    static constexpr OpCode opcode = OpCode::JNF;
     JnfOp(DualRegisters&, ushort address);
     void operator()();
     ushort& instr_ptr_register;
@@ -98,6 +111,7 @@ struct JnfOp {
 };
 
 struct CallOp {
+    static constexpr OpCode opcode = OpCode::CALL;
     CallOp(DualRegisters&, ushort address);
     void operator()();
 
@@ -110,6 +124,7 @@ struct CallOp {
 };
 
 struct TurnLeftOp {
+    static constexpr OpCode opcode = OpCode::LT;
     TurnLeftOp(DualRegisters&);
     void operator()();
     bool& dir_flag1;
@@ -117,6 +132,7 @@ struct TurnLeftOp {
 };
 
 struct TurnRightOp {
+    static constexpr OpCode opcode = OpCode::RT;
     TurnRightOp(DualRegisters&);
     void operator()();
     bool& dir_flag1;
@@ -124,6 +140,7 @@ struct TurnRightOp {
 };
 
 struct PopOp {
+    static constexpr OpCode opcode = OpCode::POP;
     PopOp(DualRegisters&, cpu_word_size& reg);
     void operator()();
 
@@ -133,6 +150,7 @@ struct PopOp {
 };
 
 struct PushOp {
+    static constexpr OpCode opcode = OpCode::PUSH;
     PushOp(DualRegisters&, cpu_word_size& reg);
     void operator()();
 
@@ -142,6 +160,7 @@ struct PushOp {
 };
 
 struct ReturnOp {
+    static constexpr OpCode opcode = OpCode::RET;
     ReturnOp(DualRegisters&);
     void operator()();
 
@@ -152,6 +171,7 @@ struct ReturnOp {
 };
 
 struct CheckOp {
+    static constexpr OpCode opcode = OpCode::CHECK;
     CheckOp(DualRegisters&);
     void operator()();
 
@@ -162,6 +182,7 @@ struct CheckOp {
 };
 
 struct ScentOnOp {
+    static constexpr OpCode opcode = OpCode::SCENT_ON;
     ScentBehaviors& scent_behaviors;
     ulong& delta_scents;
     uchar scent_idx;
@@ -170,12 +191,14 @@ struct ScentOnOp {
 };
 
 struct ScentOffOp {
+    static constexpr OpCode opcode = OpCode::SCENT_OFF;
     ScentBehaviors& scent_behaviors;
     ScentOffOp(DualRegisters&);
     void operator()();
 };
 
 struct SetScentPriorityOp {
+    static constexpr OpCode opcode = OpCode::SET_SCENT_PRIORITY;
     ulong& priorities;
     ulong clear_mask, priority;
     SetScentPriorityOp(DualRegisters&, uchar scent_idx, uchar priority);
@@ -183,6 +206,7 @@ struct SetScentPriorityOp {
 };
 
 struct TurnByScentOp {
+    static constexpr OpCode opcode = OpCode::TURN_SCENT;
     bool &dir_flag1, &dir_flag2;
     bool &scent_dir1, &scent_dir2;
     TurnByScentOp(DualRegisters&);
@@ -0,0 +1,129 @@
+#include "hardware/optimizer.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#include "spdlog/spdlog.h"
+
+OptimizerPasses OptimizerPasses::none() {
+    return {false, false, false, false, false, false, false};
+}
+
+static bool is_turn(OpCode opcode) {
+    return opcode == OpCode::LT || opcode == OpCode::RT;
+}
+
+// Fuses two consecutive instructions into a superinstruction. Returns false
+// when no pass applies.
+static bool fuse_pair(Instruction const& first, Instruction const& second,
+                      OptimizerPasses const& passes, Instruction& fused) {
+    if(passes.fuse_turns && is_turn(first.opcode) &&
+       first.opcode == second.opcode) {
+        fused = {.opcode = OpCode::TURN_AROUND, .skip = 1};
+        return true;
+    }
+    if(passes.fuse_turn_move && is_turn(first.opcode) &&
+       second.opcode == OpCode::MOVE) {
+        OpCode const opcode =
+            first.opcode == OpCode::LT ? OpCode::LT_MOVE : OpCode::RT_MOVE;
+        fused = {.opcode = opcode, .skip = 1, .num_ticks = second.num_ticks};
+        return true;
+    }
+    if(passes.fuse_counter_jumps &&
+       (first.opcode == OpCode::INC || first.opcode == OpCode::DEC) &&
+       second.opcode == OpCode::JNZ) {
+        OpCode const opcode =
+            first.opcode == OpCode::INC ? OpCode::INC_JNZ : OpCode::DEC_JNZ;
+        fused = {.opcode = opcode,
+                 .arg0 = first.arg0,
+                 .skip = 1,
+                 .address = second.address};
+        return true;
+    }
+    if(passes.fuse_push_pop && first.opcode == OpCode::PUSH &&
+       second.opcode == OpCode::POP) {
+        fused = {.opcode = OpCode::PUSH_POP,
+                 .arg0 = first.arg0,
+                 .arg1 = second.arg0,
+                 .skip = 1};
+        return true;
+    }
+    if(passes.fold_zero_flag && first.opcode == OpCode::LOAD &&
+       second.opcode == OpCode::JNZ) {
+        // the zero flag after a LOAD is known, so is the branch
+        fused = first;
+        fused.skip = 1;
+        if(first.value != 0) {
+            fused.opcode = OpCode::LOAD_JMP;
+            fused.address = second.address;
+        }
+        return true;
+    }
+    return false;
+}
+
+// A sync instruction stops the async phase and the following tick only
+// counts down its wait ticks, so every NOP of a chain costs its ticks plus
+// one. A single NOP waiting for the whole chain behaves the same.
+static bool merge_nops(std::vector<Instruction> const& source, ulong idx,
+                       Instruction& merged) {
+    ulong end = idx;
+    ulong total_ticks = 0;
+    while(end < source.size() && source[end].opcode == OpCode::NOP &&
+          end - idx <= std::numeric_limits<uchar>::max()) {
+        total_ticks += source[end].num_ticks + 1ul;
+        ++end;
+    }
+    if(end - idx < 2) return false;
+    merged = {.opcode = OpCode::NOP,
+              .skip = static_cast<uchar>(end - idx - 1),
+              .num_ticks = static_cast<ushort>(std::min<ulong>(
+                  total_ticks - 1, std::numeric_limits<ushort>::max()))};
+    return true;
+}
+
+// Follows chains of unconditional jumps. Bounded by the program size so a
+// JMP to itself terminates.
+static void thread_jump(std::vector<Instruction> const& instructions,
+                        Instruction& instr) {
+    ushort target = static_cast<ushort>(instr.address + 1);
+    for(ulong hops = 0; hops < instructions.size(); ++hops) {
+        if(target >= instructions.size()) break;
+        Instruction const& next = instructions[target];
+        if(next.opcode != OpCode::JMP) break;
+        target = static_cast<ushort>(next.address + 1);
+    }
+    instr.address = static_cast<ushort>(target - 1);
+}
+
+void optimize(std::vector<Instruction>& instructions,
+              OptimizerPasses const& passes) {
+    // every fusion reads the unoptimized program since the covered
+    // instructions stay in place and can head a fusion of their own
+    std::vector<Instruction> const source = instructions;
+    ulong num_fused = 0;
+    for(ulong idx = 0; idx < source.size(); ++idx) {
+        Instruction fused;
+        if(passes.merge_nops && merge_nops(source, idx, fused)) {
+            instructions[idx] = fused;
+            ++num_fused;
+        } else if(idx + 1 < source.size() &&
+                  fuse_pair(source[idx], source[idx + 1], passes, fused)) {
+            instructions[idx] = fused;
+            ++num_fused;
+        }
+    }
+
+    ulong num_threaded = 0;
+    if(passes.thread_jumps) {
+        for(Instruction& instr : instructions) {
+            if(!has_jump_address(instr.opcode)) continue;
+            ushort const address = instr.address;
+            thread_jump(instructions, instr);
+            num_threaded += instr.address != address;
+        }
+    }
+    SPDLOG_DEBUG("Optimized program - {} instructions, {} fused, {} jumps "
+                 "threaded",
+                 instructions.size(), num_fused, num_threaded);
+}
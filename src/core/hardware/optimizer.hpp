@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+
+#include "hardware/instruction.hpp"
+
+// Peephole passes run over a decoded program. Each pass can be switched off
+// on its own (see --optimize) so its effect can be measured in the
+// benchmark.
+struct OptimizerPasses {
+    bool fuse_turns = true;          // LT;LT and RT;RT -> TURN_AROUND
+    bool fuse_turn_move = true;      // LT;MOVE and RT;MOVE -> LT_MOVE, RT_MOVE
+    bool fuse_counter_jumps = true;  // INC;JNZ and DEC;JNZ -> INC_JNZ, DEC_JNZ
+    bool fuse_push_pop = true;       // PUSH;POP -> PUSH_POP
+    bool merge_nops = true;          // NOP chain -> one NOP waiting as long
+    bool fold_zero_flag = true;      // LOAD;JNZ -> LOAD_JMP or a LOAD skip
+    bool thread_jumps = true;        // a jump to a JMP takes the JMP's target
+
+    static OptimizerPasses none();
+};
+
+// Rewrites the program in place. Superinstructions replace the first
+// instruction of a sequence and skip the rest, which stay untouched, so the
+// program keeps its length and every instruction address keeps its meaning:
+// labels, CALL return addresses on the stack and saved instruction pointers
+// all stay valid, and the deparser still shows the source program.
+void optimize(std::vector<Instruction>& instructions,
+              OptimizerPasses const& passes);
@@ -1,6 +1,11 @@
 #include "hardware/program_executor.hpp"
 
+#include <cassert>
+
 #include "entity/entity_data.hpp"
+#include "hardware/batch_executor.hpp"
+#include "hardware/brain.hpp"
+#include "hardware/hardware_manager.hpp"
 #include "proto/hardware.pb.h"
 #include "spdlog/spdlog.h"
 #include "utils/serializer.hpp"
@@ -33,16 +38,44 @@ ProgramExecutor::ProgramExecutor(const ant_proto::ProgramExecutor& msg,
 
 void ProgramExecutor::reset() { has_executed_sync = false; }
 
-void ProgramExecutor::execute_async() {
+void ProgramExecutor::use_decoded(DualRegisters& cpu,
+                                  DecodedProgram const& program) {
+    // the interpreter advances cpu.instr_ptr_register directly
+    assert(&cpu.instr_ptr_register == &instr_ptr_register);
+    assert(program.async_run.size() == program.size());  // see build_blocks
+    this->cpu = &cpu;
+    this->program = &program;
+    mode = ExecutionMode::DECODED;
+}
+
+void ProgramExecutor::wake() {
+    if(!is_parked) return;
+    is_parked = false;
+    if(hardware_manager != nullptr) hardware_manager->wake(*this);
+}
+
+ulong ProgramExecutor::size() const {
+    return mode == ExecutionMode::DECODED ? program->size() : _ops.size();
+}
+
+// Counts down the wait ticks of the last sync instruction. Returns true when
+// the async instructions are due this tick.
+bool ProgramExecutor::begin_async() {
     // SPDLOG_INFO("Handling clock pulse for program_executor - clock: {}
     // trigger: {}", instr_clock, instr_trigger);
     has_executed_async = false;
-    if(instr_ptr_register >= _ops.size()) return;
+    if(is_parked) return false;
+    if(instr_ptr_register >= size()) return false;
     if(instr_trigger > 0) {
         --instr_trigger;
-        return;
+        return false;
     }
     has_executed_async = true;
+    return true;
+}
+
+void ProgramExecutor::execute_async() {
+    if(!begin_async()) return;
     AsyncProgramJob job(*this);
     job_pool.submit_job(job);
 
@@ -51,6 +84,13 @@ void ProgramExecutor::execute_async() {
 }
 
 void ProgramExecutor::execute() {
+    if(mode == ExecutionMode::DECODED) {
+        Instruction const& instr = program->instructions[instr_ptr_register];
+        instr_trigger = instr.num_ticks;
+        interpret(instr, *cpu);
+        ++instr_ptr_register;
+        return;
+    }
     instr_trigger = _ops[instr_ptr_register].num_ticks;
     _ops[instr_ptr_register]();
     ++instr_ptr_register;
@@ -58,7 +98,7 @@ void ProgramExecutor::execute() {
 
 void ProgramExecutor::execute_sync() {
     if(has_executed_sync) return;
-    if(instr_ptr_register >= _ops.size()) return;
+    if(instr_ptr_register >= size()) return;
     if(!has_executed_async) return;
     has_executed_sync = true;
     SPDLOG_TRACE("Executing sync operation at instruction address: {}",
@@ -67,22 +107,73 @@ void ProgramExecutor::execute_sync() {
 }
 
 bool ProgramExecutor::is_sync() {
+    if(mode == ExecutionMode::DECODED) {
+        return program->instructions[instr_ptr_register].num_ticks != 0;
+    }
     return _ops[instr_ptr_register].num_ticks != 0;
 }
 
-void AsyncProgramJob::run() {
-    for(ulong i = 0; i < pe.max_instruction_per_tick &&
-                     pe.instr_ptr_register < pe._ops.size();
+// Returns the number of instructions executed
+ulong ProgramExecutor::run_async() {
+    if(mode == ExecutionMode::DECODED) {
+        // async instructions all have zero ticks so instr_trigger is unchanged
+        if(!is_watching_cycle) {
+            ulong const executed =
+                interpret_async(*program, *cpu, max_instruction_per_tick);
+            if(executed == max_instruction_per_tick) watch_for_cycle();
+            return executed;
+        }
+
+        // The ant spent a whole budget without reaching a sync instruction.
+        // If its state repeats it loops forever on its registers alone, so
+        // it is parked until one of the inputs of the loop changes.
+        bool is_cycle = false;
+        ulong const executed = interpret_async_until_cycle(
+            *program, *cpu, max_instruction_per_tick, is_cycle);
+        is_parked = is_cycle;
+        is_watching_cycle = is_cycle || executed == max_instruction_per_tick;
+        if(is_parked) {
+            SPDLOG_DEBUG("Parked ant in a cycle - instruction address: {}",
+                         instr_ptr_register);
+        }
+        return executed;
+    }
+
+    ulong i = 0;
+    for(; i < max_instruction_per_tick && instr_ptr_register < _ops.size();
         ++i) {
-        if(pe.is_sync()) {  // break if a syncronous instruction
+        if(is_sync()) {  // break if a syncronous instruction
             break;
         }
         SPDLOG_TRACE("Executing async operation at instruction address: {}",
-                     pe.instr_ptr_register);
-        pe.execute();
+                     instr_ptr_register);
+        execute();
         SPDLOG_TRACE("Incrementing instruction pointer register to {}",
-                     pe.instr_ptr_register);
+                     instr_ptr_register);
+    }
+    return i;
+}
+
+void AsyncProgramJob::run() {
+    if(range != nullptr) {
+        range->run_job(range_job);
+        return;
+    }
+    if(graph != nullptr) {
+        graph->run_task(task);
+        return;
+    }
+    if(batch != nullptr) {
+        batch->run();
+        return;
+    }
+    if(executors != nullptr) {
+        for(ulong idx = 0; idx < num_executors; ++idx) {
+            executors[idx]->run_async();
+        }
+        return;
     }
+    pe->run_async();
 }
 
 ant_proto::ProgramExecutor ProgramExecutor::get_proto() {
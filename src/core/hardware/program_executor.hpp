@@ -5,12 +5,18 @@
 
 #include "app/globals.hpp"
 #include "hardware.pb.h"
+#include "hardware/instruction.hpp"
 #include "hardware/op_def.hpp"
+#include "utils/parallel.hpp"
+#include "utils/task_graph.hpp"
 #include "utils/thread_pool.hpp"
 #include "utils/types.hpp"
 
 class Packer;
 class Unpacker;
+struct DualRegisters;
+struct HardwareManager;
+struct ProgramBatch;
 struct ProgramExecutor;
 
 struct Op {
@@ -19,19 +25,47 @@ struct Op {
     void operator()() { fn(); };
 };
 
+// Runs the async phase of a single executor, of a span of executors or of a
+// whole ProgramBatch, a task of the frame graph or a share of a
+// parallel_for.
 struct AsyncProgramJob {
-    ProgramExecutor& pe;
-    AsyncProgramJob(ProgramExecutor& pe) : pe(pe) {}
+    ProgramExecutor* pe = nullptr;
+    ProgramBatch* batch = nullptr;
+    ProgramExecutor* const* executors = nullptr;  // span - not owned
+    ulong num_executors = 0;
+    TaskGraph const* graph = nullptr;
+    TaskGraph::TaskId task = 0;
+    ParallelRange const* range = nullptr;
+    ulong range_job = 0;
+    AsyncProgramJob(ProgramExecutor& pe) : pe(&pe) {}
+    AsyncProgramJob(ProgramBatch& batch) : batch(&batch) {}
+    AsyncProgramJob(ProgramExecutor* const* executors, ulong num_executors)
+        : executors(executors), num_executors(num_executors) {}
+    AsyncProgramJob(TaskGraph const& graph, TaskGraph::TaskId task)
+        : graph(&graph), task(task) {}
+    AsyncProgramJob(ParallelRange const& range, ulong range_job)
+        : range(&range), range_job(range_job) {}
     void run();
 };
 
 struct ProgramExecutor {
    public:
     std::vector<Op> _ops = {};
+    DecodedProgram const* program = nullptr;  // shared - not owned
+    DualRegisters* cpu = nullptr;  // required by ExecutionMode::DECODED
+    ExecutionMode mode = ExecutionMode::CLOSURE;
     ushort& instr_ptr_register;
     ulong instr_trigger = 0;
     bool has_executed_async = false;
     bool has_executed_sync = false;
+    // A parked ant is stuck in a loop that only touches its registers and
+    // skips the async phase until wake() - see run_async.
+    bool is_parked = false;
+    bool is_watching_cycle = false;  // last async phase spent its budget
+    bool is_parking_enabled = true;
+    // set while the executor is in its HardwareManager's ready list
+    bool is_ready = false;
+    HardwareManager* hardware_manager = nullptr;  // schedules the executor
     ulong const& instr_clock;
     ulong max_instruction_per_tick = 0;
     ThreadPool<AsyncProgramJob>& job_pool;
@@ -42,10 +76,16 @@ struct ProgramExecutor {
                     ulong const& instr_clock, ulong max_instruction_per_tick,
                     ushort& instr_ptr_register, ThreadPool<AsyncProgramJob>&);
     void reset();
+    void use_decoded(DualRegisters& cpu, DecodedProgram const& program);
+    bool begin_async();
+    void watch_for_cycle() { is_watching_cycle = is_parking_enabled; }
+    void wake();
     void execute_async();
     void execute();
     void execute_sync();
+    ulong run_async();
     bool is_sync();
+    ulong size() const;
 
     ant_proto::ProgramExecutor get_proto();
 };
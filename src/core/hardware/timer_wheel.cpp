@@ -0,0 +1,51 @@
+#include "hardware/timer_wheel.hpp"
+
+#include <cassert>
+
+#include "spdlog/spdlog.h"
+
+void TimerWheel::insert(Timer const& timer) {
+    ulong const delta = timer.due - now;
+    ulong level = 0;
+    while(level + 1 < num_levels &&
+          delta >= (1ul << (slot_bits * (level + 1)))) {
+        ++level;
+    }
+    ulong const slot = (timer.due >> (slot_bits * level)) & (slot_count - 1);
+    slots[level][slot].push_back(timer);
+}
+
+// Refiles the timers of the level's slot that starts at the current tick.
+// They are all due within the slot's span so they land on a lower level.
+void TimerWheel::cascade(ulong level) {
+    ulong const slot = (now >> (slot_bits * level)) & (slot_count - 1);
+    std::vector<Timer> timers;
+    timers.swap(slots[level][slot]);
+    for(Timer const& timer : timers) insert(timer);
+    // keep the capacity of the slot
+    timers.clear();
+    slots[level][slot].swap(timers);
+}
+
+void TimerWheel::schedule(ProgramExecutor& exec, ulong due) {
+    assert(due > now);
+    assert(due - now < (1ul << (slot_bits * num_levels)));
+    insert({&exec, due});
+    ++num_timers;
+}
+
+void TimerWheel::advance(std::vector<ProgramExecutor*>& expired) {
+    ++now;
+    for(ulong level = num_levels - 1; level > 0; --level) {
+        if((now & ((1ul << (slot_bits * level)) - 1)) == 0) cascade(level);
+    }
+
+    std::vector<Timer>& slot = slots[0][now & (slot_count - 1)];
+    for(Timer const& timer : slot) {
+        assert(timer.due == now);
+        expired.push_back(timer.exec);
+    }
+    num_timers -= slot.size();
+    slot.clear();
+    SPDLOG_TRACE("Timer wheel at tick {} - {} waiting", now, num_timers);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+#include "app/globals.hpp"
+#include "utils/types.hpp"
+
+struct ProgramExecutor;
+
+// Hierarchical timer wheel keyed by tick. Level 0 has one slot per tick for
+// the next slot_count ticks, every level above covers slot_count times the
+// ticks of the level below. A timer is filed by how far away it is and
+// moves down a level each time the wheel reaches the start of its slot, so
+// scheduling and expiring are O(1) per timer no matter how many executors
+// are waiting.
+class TimerWheel {
+   public:
+    static constexpr ulong slot_bits = 6;
+    static constexpr ulong slot_count = 1ul << slot_bits;
+    // 2^18 ticks - longer than any wait tick count (ushort)
+    static constexpr ulong num_levels = 3;
+
+    struct Timer {
+        ProgramExecutor* exec;
+        ulong due;  // tick the executor becomes runnable
+    };
+
+   private:
+    std::vector<Timer> slots[num_levels][slot_count];
+    ulong now = 0;
+    ulong num_timers = 0;
+
+    void insert(Timer const&);
+    void cascade(ulong level);
+
+   public:
+    // due must be later than the current tick
+    void schedule(ProgramExecutor& exec, ulong due);
+    // Moves to the next tick and appends the executors due on it
+    void advance(std::vector<ProgramExecutor*>& expired);
+
+    ulong tick() const { return now; }
+    ulong size() const { return num_timers; }
+
+    template <class Visitor>
+    void for_each(Visitor visit) const {
+        for(auto const& level : slots) {
+            for(auto const& slot : level) {
+                for(Timer const& timer : slot) visit(timer);
+            }
+        }
+    }
+};
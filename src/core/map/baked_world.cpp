@@ -0,0 +1,185 @@
+#include "map/baked_world.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+
+#include "app/globals.hpp"
+#include "map/map.hpp"
+#include "map/world.hpp"
+#include "spdlog/spdlog.h"
+#include "utils/math.hpp"
+
+namespace {
+// Words of the header
+enum HeaderWord : ulong {
+    MAGIC,
+    VERSION,
+    SEED_X,
+    SEED_Y,
+    RADIUS,
+    DEPTH_BEGIN,
+    DEPTH_END,
+    HEADER_WORDS,
+};
+ulong const MAGIC_WORD = 0x454B414253544E41ul;  // "ANTSBAKE"
+ulong const FORMAT_VERSION = 1;
+
+long const REGION_CHUNKS = globals::WORLD_LENGTH / globals::CHUNK_LENGTH;
+ulong const CHUNKS_PER_REGION = REGION_CHUNKS * REGION_CHUNKS;
+ulong const PRESENCE_WORDS = CHUNKS_PER_REGION / 64;
+ulong const LEVEL_WORDS = PRESENCE_WORDS + CHUNKS_PER_REGION;
+
+// Index of the chunk of (x, y) in the region with top left corner
+// (region_x1, region_y1)
+ulong chunk_index(long region_x1, long region_y1, long x, long y) {
+    long const chunk_x = (x - region_x1) / globals::CHUNK_LENGTH;
+    long const chunk_y = (y - region_y1) / globals::CHUNK_LENGTH;
+    return static_cast<ulong>(chunk_x * REGION_CHUNKS + chunk_y);
+}
+
+ulong level_offset(BakeSpec const& spec, ulong region, ulong level) {
+    return HEADER_WORDS + (region * spec.num_levels() + level) * LEVEL_WORDS;
+}
+}  // namespace
+
+BakedWorld::~BakedWorld() {
+    if(words != nullptr) munmap(const_cast<ulong*>(words), num_bytes);
+    if(fd >= 0) close(fd);
+}
+
+std::unique_ptr<BakedWorld> BakedWorld::open(std::string const& path) {
+    if(path.empty()) return nullptr;
+    std::unique_ptr<BakedWorld> world(new BakedWorld());
+    world->fd = ::open(path.c_str(), O_RDONLY);
+    if(world->fd < 0) {
+        SPDLOG_ERROR("Failed to open the baked world {}", path);
+        return nullptr;
+    }
+    struct stat file_stat;
+    if(fstat(world->fd, &file_stat) != 0 ||
+       static_cast<ulong>(file_stat.st_size) < HEADER_WORDS * sizeof(ulong)) {
+        SPDLOG_ERROR("{} is too small for a baked world", path);
+        return nullptr;
+    }
+    world->num_bytes = static_cast<ulong>(file_stat.st_size);
+    void* mapped = mmap(nullptr, world->num_bytes, PROT_READ, MAP_PRIVATE,
+                        world->fd, 0);
+    if(mapped == MAP_FAILED) {
+        SPDLOG_ERROR("Failed to map the baked world {}", path);
+        return nullptr;
+    }
+    world->words = static_cast<ulong const*>(mapped);
+
+    ulong const* header = world->words;
+    if(header[MAGIC] != MAGIC_WORD || header[VERSION] != FORMAT_VERSION) {
+        SPDLOG_ERROR("{} is not a baked world of version {}", path,
+                     FORMAT_VERSION);
+        return nullptr;
+    }
+    BakeSpec& spec = world->spec;
+    spec.seed_x = static_cast<uint32_t>(header[SEED_X]);
+    spec.seed_y = static_cast<uint32_t>(header[SEED_Y]);
+    spec.radius = static_cast<long>(header[RADIUS]);
+    spec.depth_begin = header[DEPTH_BEGIN];
+    spec.depth_end = header[DEPTH_END];
+    if(spec.radius < 0 || spec.depth_end < spec.depth_begin ||
+       file_words(spec) * sizeof(ulong) != world->num_bytes) {
+        SPDLOG_ERROR("The baked world {} is truncated", path);
+        return nullptr;
+    }
+    SPDLOG_INFO("Mapped the baked world {} - {} regions, levels {} to {}",
+                path, spec.side() * spec.side(), spec.depth_begin,
+                spec.depth_end - 1);
+    return world;
+}
+
+ulong BakedWorld::file_words(BakeSpec const& spec) {
+    ulong const num_regions = static_cast<ulong>(spec.side() * spec.side());
+    return HEADER_WORDS + num_regions * spec.num_levels() * LEVEL_WORDS;
+}
+
+void BakedWorld::write_header(BakeSpec const& spec, ulong* file) {
+    file[MAGIC] = MAGIC_WORD;
+    file[VERSION] = FORMAT_VERSION;
+    file[SEED_X] = spec.seed_x;
+    file[SEED_Y] = spec.seed_y;
+    file[RADIUS] = static_cast<ulong>(spec.radius);
+    file[DEPTH_BEGIN] = spec.depth_begin;
+    file[DEPTH_END] = spec.depth_end;
+}
+
+void BakedWorld::bake_region(BakeSpec const& spec, ulong region,
+                             ulong* file) {
+    Region_Key const key = {
+        static_cast<long>(region) / spec.side() - spec.radius,
+        static_cast<long>(region) % spec.side() - spec.radius};
+    Region planned = Regions::plan(key, spec.seed_x, spec.seed_y);
+    Rect const& perimeter = planned.perimeter;
+    for(ulong level = 0; level < spec.num_levels(); ++level) {
+        ulong const depth = spec.depth_begin + level;
+        Level built(Map(true, [](long, long) {}), depth);
+        if(depth < planned.section_plans.size()) {
+            for(Section_Plan& plan : planned.section_plans[depth]) {
+                plan.build_section(built);
+            }
+        }
+        ulong* presence = file + level_offset(spec, region, level);
+        ulong* walls = presence + PRESENCE_WORDS;
+        built.map.read_chunks(
+            perimeter.x1, perimeter.y1, perimeter.x1 + globals::WORLD_LENGTH,
+            perimeter.y1 + globals::WORLD_LENGTH,
+            [&](Chunk const& chunk, ulong) {
+                if(!chunk.section_loaded) return;
+                ulong const idx =
+                    chunk_index(perimeter.x1, perimeter.y1, chunk.x, chunk.y);
+                presence[idx / 64] |= 1ul << idx % 64;
+                walls[idx] = chunk.is_wall_bits;
+            });
+    }
+}
+
+bool BakedWorld::write(std::string const& path,
+                       std::vector<ulong> const& file) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<char const*>(file.data()),
+              static_cast<std::streamsize>(file.size() * sizeof(ulong)));
+    if(!out) {
+        SPDLOG_ERROR("Failed to write the baked world {}", path);
+        return false;
+    }
+    return true;
+}
+
+ulong const* BakedWorld::level_record(long region_x, long region_y,
+                                      ulong depth) const {
+    if(depth < spec.depth_begin || depth >= spec.depth_end) return nullptr;
+    long const column = region_x + spec.radius;
+    long const row = region_y + spec.radius;
+    if(column < 0 || column >= spec.side() || row < 0 || row >= spec.side()) {
+        return nullptr;
+    }
+    ulong const region = static_cast<ulong>(column * spec.side() + row);
+    return words + level_offset(spec, region, depth - spec.depth_begin);
+}
+
+bool BakedWorld::find(ulong depth, long x, long y, ulong& is_wall_bits) const {
+    long const region_x = div_floor(x, globals::WORLD_LENGTH);
+    long const region_y = div_floor(y, globals::WORLD_LENGTH);
+    ulong const* presence = level_record(region_x, region_y, depth);
+    if(presence == nullptr) return false;
+    ulong const idx =
+        chunk_index(region_x * globals::WORLD_LENGTH,
+                    region_y * globals::WORLD_LENGTH, x, y);
+    if((presence[idx / 64] >> idx % 64 & 1) == 0) return false;
+    is_wall_bits = presence[PRESENCE_WORDS + idx];
+    return true;
+}
+
+bool BakedWorld::contains(ulong depth, long x, long y) const {
+    ulong is_wall_bits = 0;
+    return find(depth, x, y, is_wall_bits);
+}
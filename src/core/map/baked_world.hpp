@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "utils/parallel.hpp"
+#include "utils/thread_pool.hpp"
+#include "utils/types.hpp"
+
+// The part of a seeded world ants_pregen bakes - the regions within radius
+// regions of the origin region, on the levels [depth_begin, depth_end)
+struct BakeSpec {
+    uint32_t seed_x = 0;
+    uint32_t seed_y = 0;
+    long radius = 0;
+    ulong depth_begin = 0;
+    ulong depth_end = 1;
+
+    long side() const { return 2 * radius + 1; }  // regions per side
+    ulong num_levels() const { return depth_end - depth_begin; }
+};
+
+// A world generated ahead of time, mapped read-only from its file. The
+// file is a header of words followed by a block per region - region by
+// region, column by column - of a record per level. A level record is a
+// bit per chunk of the region telling which chunks are baked, then the wall
+// bits of every chunk, chunk column by chunk column like
+// Region::plan_grid. That is 8 bytes and a bit per chunk; nothing else of
+// a freshly generated chunk differs from a new one.
+//
+// MapWorld loads a missing chunk of a baked region from here instead of
+// planning the region and building the chunk's section. Sections are
+// generated from seeds derived from the region seeds (see
+// Region::section_seed), so the baked chunks are the chunks the world
+// would have built.
+class BakedWorld {
+    int fd = -1;
+    ulong const* words = nullptr;
+    ulong num_bytes = 0;
+    BakeSpec spec;
+
+    BakedWorld() = default;
+    // The level record of the region (x, y) of depth, nullptr if it is not
+    // baked
+    ulong const* level_record(long region_x, long region_y, ulong depth) const;
+
+   public:
+    ~BakedWorld();
+    BakedWorld(BakedWorld const&) = delete;
+    BakedWorld& operator=(BakedWorld const&) = delete;
+
+    // Maps the baked world at path - nullptr if path is empty or it is not
+    // a baked world of this version
+    static std::unique_ptr<BakedWorld> open(std::string const& path);
+
+    // Generates the world of spec a region per job on pool and writes it to
+    // path. False if the file could not be written.
+    template <class Job>
+    static bool bake(std::string const& path, BakeSpec const& spec,
+                     ThreadPool<Job>& pool) {
+        std::vector<ulong> file(file_words(spec));
+        write_header(spec, file.data());
+        parallel_for(pool, 0, static_cast<ulong>(spec.side() * spec.side()),
+                     1, [&](ulong region) {
+                         bake_region(spec, region, file.data());
+                     });
+        return write(path, file);
+    }
+    static ulong file_words(BakeSpec const& spec);
+    static void write_header(BakeSpec const& spec, ulong* file);
+    // Plans the region-th region of spec and fills its block of file
+    static void bake_region(BakeSpec const& spec, ulong region, ulong* file);
+    static bool write(std::string const& path, std::vector<ulong> const& file);
+
+    // The wall bits of the chunk of (x, y) on level depth - false if the
+    // chunk is not baked
+    bool find(ulong depth, long x, long y, ulong& is_wall_bits) const;
+    bool contains(ulong depth, long x, long y) const;
+
+    BakeSpec const& get_spec() const { return spec; }
+    ulong size_bytes() const { return num_bytes; }
+};
@@ -1,24 +1,29 @@
 #pragma once
 
 #include <libtcod/bsp.hpp>
+#include <libtcod/mersenne.hpp>
 
 #include "map/section_data.hpp"
 
 class BspListener : public ITCODBspCallback {
    private:
     MapSectionData &section_data;  // a section_data to dig
+    TCODRandom &rng;
     int room_num = 0;              // room number
     int lastx = 0, lasty = 0;      // center of the last room
 
    public:
-    BspListener(MapSectionData &section_data);
+    BspListener(MapSectionData &section_data, TCODRandom &rng);
 
     bool visitNode(TCODBsp *node, void *user_data);
 };
 
+// Draws from rng, the global TCODRandom when it is nullptr. A builder with
+// its own rng touches nothing else and can run on any thread.
 struct RandomMapBuilder {
     Rect border;
-    RandomMapBuilder(Rect const &border);
+    TCODRandom *rng;
+    RandomMapBuilder(Rect const &border, TCODRandom *rng = nullptr);
     void operator()(MapSectionData &section_data) const;
 };
 
@@ -0,0 +1,158 @@
+#include "map/generator.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <libtcod/mersenne.hpp>
+
+#include "entity/ant.hpp"
+#include "utils/math.hpp"
+#include "utils/task_graph.hpp"
+
+double SectionGeneratorStats::mean_latency_ms() const {
+    if(loaded == 0) return 0;
+    return static_cast<double>(total_latency_ns) /
+           static_cast<double>(loaded) / 1e6;
+}
+
+std::vector<std::string> SectionGeneratorStats::summary() const {
+    auto line = [](char const* label, double value, char const* unit) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%-6s%5.0f%s", label, value, unit);
+        return std::string(text);
+    };
+    return {
+        "WORLDGEN",
+        line("QUEUE", static_cast<double>(queue_depth), ""),
+        line("QMAX", static_cast<double>(max_queue_depth), ""),
+        line("LAT", mean_latency_ms(), "ms"),
+        line("LMAX", static_cast<double>(max_latency_ns) / 1e6, "ms"),
+    };
+}
+
+void SectionGenerator::queue_region(MapWorld& world, Region_Key key) {
+    for(RegionRequest const& request : region_queue) {
+        if(request.key == key) return;
+    }
+    uint32_t origin_seed_x = 0, origin_seed_y = 0;
+    if(!world.get_origin_region_seeds(origin_seed_x, origin_seed_y)) return;
+    region_queue.push_back({key, origin_seed_x, origin_seed_y});
+}
+
+void SectionGenerator::queue_area(MapWorld& world, Area const& area) {
+    Level& level = world.levels[area.depth];
+    for(long chunk_x = area.x1; chunk_x <= area.x2; ++chunk_x) {
+        for(long chunk_y = area.y1; chunk_y <= area.y2; ++chunk_y) {
+            long const x = chunk_x * globals::CHUNK_LENGTH;
+            long const y = chunk_y * globals::CHUNK_LENGTH;
+            if(world.is_baked(area.depth, x, y)) continue;
+            Region* region = world.regions.find(x, y);
+            if(region == nullptr) {
+                queue_region(world, Region_Key::of_tile(x, y));
+                continue;
+            }
+            if(level.map.chunk_built(x, y)) continue;
+            Section_Plan* plan =
+                region->section_plan(x, y, static_cast<long>(area.depth));
+            if(plan == nullptr || plan->in_construction || plan->is_queued) {
+                continue;
+            }
+            plan->is_queued = true;
+            queue.push_back({area.depth, plan, plan->_generate_section,
+                             plan->seed, MapSectionData(plan->border),
+                             Clock::now()});
+            ++stats.queued;
+        }
+    }
+}
+
+void SectionGenerator::queue_ahead(MapWorld& world) {
+    auto area = [](ulong depth, long x1, long y1, long x2, long y2) {
+        return Area{depth, div_floor(x1, globals::CHUNK_LENGTH),
+                    div_floor(y1, globals::CHUNK_LENGTH),
+                    div_floor(x2, globals::CHUNK_LENGTH),
+                    div_floor(y2, globals::CHUNK_LENGTH)};
+    };
+    std::vector<Area> current;
+    for(Level const& level : world.levels) {
+        for(Worker* worker : level.workers) {
+            EntityData const& data = worker->get_data();
+            current.push_back(area(level.depth, data.x - ant_margin,
+                                   data.y - ant_margin, data.x + ant_margin,
+                                   data.y + ant_margin));
+        }
+    }
+    // ants of a chunk share their area
+    std::sort(current.begin(), current.end());
+    current.erase(std::unique(current.begin(), current.end()), current.end());
+    Rect const& border = world.map_window.border;
+    current.insert(current.begin(),
+                   area(world.current_depth, border.x1 - window_margin,
+                        border.y1 - window_margin, border.x2 + window_margin,
+                        border.y2 + window_margin));
+    if(!is_stale && current == areas) return;
+
+    areas = std::move(current);
+    is_stale = false;
+    for(Area const& area : areas) queue_area(world, area);
+    stats.max_queue_depth = std::max(stats.max_queue_depth,
+                                     queue.size() + region_queue.size());
+}
+
+void SectionGenerator::add_tasks(TaskGraph& graph) {
+    ulong num_tasks = 0;
+    for(RegionRequest& request : region_queue) {
+        if(num_tasks == max_regions_per_frame) break;
+        graph.add("plan region", [&request]() {
+            request.region.emplace(Regions::plan(
+                request.key, request.origin_seed_x, request.origin_seed_y));
+        });
+        ++num_tasks;
+    }
+    num_tasks = 0;
+    for(Request& request : queue) {
+        if(num_tasks == max_per_frame) break;
+        if(request.is_generated || request.plan->in_construction) continue;
+        graph.add("generate section", [&request]() {
+            TCODRandom rng(request.seed);
+            request.generate(request.section, rng);
+            request.is_generated = true;
+        });
+        ++num_tasks;
+    }
+}
+
+void SectionGenerator::load(MapWorld& world) {
+    while(!region_queue.empty() && region_queue.front().region.has_value()) {
+        RegionRequest& request = region_queue.front();
+        world.regions.add(request.key, std::move(*request.region));
+        ++stats.regions_planned;
+        is_stale = true;
+        region_queue.pop_front();
+    }
+    while(!queue.empty() && (queue.front().is_generated ||
+                             queue.front().plan->in_construction)) {
+        Request& request = queue.front();
+        Section_Plan& plan = *request.plan;
+        if(plan.in_construction) {
+            ++stats.built_on_demand;
+        } else {
+            plan.in_construction = true;
+            plan._load_section(world.levels[request.depth], plan,
+                               request.section);
+            ulong const latency_ns = static_cast<ulong>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - request.queued_at)
+                    .count());
+            ++stats.loaded;
+            stats.total_latency_ns += latency_ns;
+            stats.max_latency_ns = std::max(stats.max_latency_ns, latency_ns);
+        }
+        queue.pop_front();
+    }
+}
+
+SectionGeneratorStats SectionGenerator::get_stats() const {
+    SectionGeneratorStats current = stats;
+    current.queue_depth = queue.size() + region_queue.size();
+    return current;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "app/globals.hpp"
+#include "map/section_data.hpp"
+#include "map/world.hpp"
+#include "utils/types.hpp"
+
+struct SectionGeneratorStats {
+    ulong queued = 0;
+    ulong loaded = 0;
+    // queued sections a chunk needed before they were loaded - built on the
+    // spot instead
+    ulong built_on_demand = 0;
+    ulong regions_planned = 0;
+    ulong queue_depth = 0;  // sections and regions queued and not loaded now
+    ulong max_queue_depth = 0;
+    ulong total_latency_ns = 0;  // from queued to loaded
+    ulong max_latency_ns = 0;
+
+    double mean_latency_ms() const;
+    std::vector<std::string> summary() const;
+};
+
+// Generates the sections the player and the ants are about to reach before
+// a chunk of them is touched, which would otherwise build them on the spot
+// in the middle of a frame.
+//
+// queue_ahead looks for unbuilt sections within a margin of the map window
+// and of every ant, and the regions there that are not planned yet. The
+// frame plans up to max_regions_per_frame regions and generates up to
+// max_per_frame sections as pool tasks, each section with the rng of its
+// plan's seed, and load puts them into the world in queue order between
+// frames. A chunk that is touched before its section is loaded builds it
+// from the same seed and a region that is needed early is planned from the
+// same seeds, so either way the world comes out the same.
+class SectionGenerator {
+    using Clock = std::chrono::steady_clock;
+    struct Request {
+        ulong depth;
+        Section_Plan* plan;
+        Section_Plan::generatef_t generate;
+        uint32_t seed;
+        MapSectionData section;
+        Clock::time_point queued_at;
+        bool is_generated = false;
+    };
+    struct RegionRequest {
+        Region_Key key;
+        uint32_t origin_seed_x;
+        uint32_t origin_seed_y;
+        std::optional<Region> region = {};
+    };
+    // The chunks around the window or an ant, in chunk coordinates
+    struct Area {
+        ulong depth;
+        long x1, y1, x2, y2;
+        auto operator<=>(Area const&) const = default;
+    };
+    // in the order queued - loaded from the front
+    std::deque<Request> queue;
+    std::deque<RegionRequest> region_queue;
+    // what queue_ahead looked at last - it only looks again once that
+    // changes or a region was added
+    std::vector<Area> areas;
+    bool is_stale = true;
+    SectionGeneratorStats stats;
+
+    void queue_area(MapWorld& world, Area const& area);
+    void queue_region(MapWorld& world, Region_Key key);
+
+   public:
+    // tiles around the map window and the ants that are generated ahead
+    long window_margin = globals::MIN_SECTION_LENGTH;
+    long ant_margin = 2 * globals::CHUNK_LENGTH;
+    // work per frame - bounds what a frame spends on generation
+    ulong max_per_frame = 1;
+    ulong max_regions_per_frame = 1;
+
+    // Queues the unbuilt sections and unplanned regions around the map
+    // window and the ants. Runs on the thread that owns the world, outside
+    // the frame.
+    void queue_ahead(MapWorld& world);
+    // One pool task per region planned and section generated this frame
+    void add_tasks(TaskGraph& graph);
+    // Adds the planned regions to the world and loads the generated
+    // sections into their levels
+    void load(MapWorld& world);
+
+    SectionGeneratorStats get_stats() const;
+};
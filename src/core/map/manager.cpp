@@ -1,5 +1,6 @@
 #include "map/manager.hpp"
 
+#include <bit>
 #include <ranges>
 
 #include "map/map.hpp"
@@ -35,43 +36,48 @@ bool MapManager::update_current_level(const EntityData& d) {
 }
 
 void MapManager::update_fov(const EntityData& d) {
-    map_world.map_window.compute_fov(d.x, d.y, d.fov_radius);
-    for(long x = map_world.map_window.border.x1;
-        x < map_world.map_window.border.x2; x++) {
-        for(long y = map_world.map_window.border.y1;
-            y < map_world.map_window.border.y2; y++) {
-            if(!map_world.map_window.in_fov(x, y)) continue;
-            map_world.current_level().map.explore(x, y);
-        }
-    }
+    MapWindow& map_window = map_world.map_window;
+    map_window.compute_fov(d.x, d.y, d.fov_radius);
+    auto explore = [&map_window](Chunk& chunk, ulong tiles) {
+        ulong seen = 0;
+        TileSpan::for_each_row(chunk, tiles, [&](TileSpan const& span) {
+            for(ulong offset = 0; offset < span.length; ++offset) {
+                long const x = span.x + static_cast<long>(offset);
+                if(map_window.in_fov(x, span.y)) {
+                    seen |= 1ul << (span.idx + offset);
+                }
+            }
+        });
+        chunk.is_explored_bits |= seen;
+        chunk.in_fov_bits |= seen;
+    };
+    for_each_window_chunk(explore);
 }
 
 void MapManager::update_map_window_tiles() {
-    for(long x = map_world.map_window.border.x1;
-        x < map_world.map_window.border.x2; x++) {
-        for(long y = map_world.map_window.border.y1;
-            y < map_world.map_window.border.y2; y++) {
-            map_world.current_level().map.reset_tile(x, y);
-        }
-    }
+    for_each_window_chunk(
+        [](Chunk& chunk, ulong tiles) { chunk.in_fov_bits &= ~tiles; });
 }
 
 void MapManager::set_window_tiles() {
     SPDLOG_TRACE("Setting window tiles");
     Map& cur_map = map_world.current_level().map;
     MapWindow& map_window = map_world.map_window;
+    Rect const& border = map_window.border;
 
-    for(long local_x = 0; local_x < map_window.border.w; local_x++) {
-        for(long local_y = 0; local_y < map_window.border.h; local_y++) {
-            long x = local_x + map_window.border.x1,
-                 y = local_y + map_window.border.y1;
-            if(cur_map.is_wall(x, y)) {
-                map_window.set_wall(x, y);
+
+    // the window is where the world gets generated, the copy only reads it
+    cur_map.load_chunks(border.x1, border.y1, border.x2 + 1, border.y2 + 1);
+    cur_map.read_spans(border, [&map_window](ConstTileSpan const& span) {
+        for(ulong offset = 0; offset < span.length; ++offset) {
+            long const x = span.x + static_cast<long>(offset);
+            if(span.chunk.is_wall(span.idx + offset)) {
+                map_window.set_wall(x, span.y);
             } else {
-                map_window.set_floor(x, y);
+                map_window.set_floor(x, span.y);
             }
         }
-    }
+    });
 }
 
 void MapManager::generate_sections(ulong depth,
@@ -17,6 +17,20 @@ class MapManager {
     ulong map_section_width;
     ulong map_section_height;
 
+    // Calls fn(chunk, tiles) for the chunks of the current level under the
+    // map window - on the job pool with --parallel_loops
+    template <class ChunkFn>
+    void for_each_window_chunk(ChunkFn const& fn) {
+        Map& map = map_world.current_level().map;
+        Rect const& border = map_world.map_window.border;
+        if(map_world.loop_pool != nullptr) {
+            map.for_each_chunk(*map_world.loop_pool, border.x1, border.y1,
+                               border.x2, border.y2, fn);
+            return;
+        }
+        map.for_each_chunk(border.x1, border.y1, border.x2, border.y2, fn);
+    }
+
    public:
     MapWorld& map_world;
 
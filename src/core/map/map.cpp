@@ -1,96 +1,214 @@
 #include "map/map.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <cstdint>
+#include <stdexcept>
 #include <vector>
 
 #include "app/globals.hpp"
+#include "map/pager.hpp"
 #include "spdlog/spdlog.h"
 #include "utils/math.hpp"
 
 
 Chunk::Chunk(long x, long y, bool update_parity)
-    : x(x),
-      y(y),
-      update_parity(update_parity),
-      tiles(globals::CHUNK_AREA, Tile()) {}
+    : x(x), y(y), update_parity(update_parity) {}
 
 Chunk::Chunk(const ant_proto::Chunk& msg)
-        : x(static_cast<long>(msg.x())),
-            y(static_cast<long>(msg.y())),
-            update_parity(msg.update_parity()),
-            tiles() {
-    tiles.reserve(globals::CHUNK_AREA);
-    ulong is_explored = static_cast<ulong>(msg.is_explored());
-    ulong in_fov = static_cast<ulong>(msg.in_fov());
-    ulong is_wall = static_cast<ulong>(msg.is_wall());
-    for(ulong i = 0; i < globals::CHUNK_AREA; ++i) {
-        tiles.emplace_back((is_explored >> i) & 1ULL, (in_fov >> i) & 1ULL,
-                           (is_wall >> i) & 1ULL);
+    : x(static_cast<long>(msg.x())),
+      y(static_cast<long>(msg.y())),
+      update_parity(msg.update_parity()),
+      is_wall_bits(static_cast<ulong>(msg.is_wall())),
+      is_explored_bits(static_cast<ulong>(msg.is_explored())),
+      in_fov_bits(static_cast<ulong>(msg.in_fov())) {}
+
+ulong Chunk::rect_mask(long x_begin, long y_begin, long x_end,
+                       long y_end) const {
+    long const col_begin = std::max(x_begin - x, 0l);
+    long const col_end = std::min(x_end - x, globals::CHUNK_LENGTH);
+    long const row_begin = std::max(y_begin - y, 0l);
+    long const row_end = std::min(y_end - y, globals::CHUNK_LENGTH);
+    if(col_begin >= col_end || row_begin >= row_end) return 0;
+
+    ulong const row = ((1ul << (col_end - col_begin)) - 1) << col_begin;
+    ulong mask = 0;
+    for(long row_idx = row_begin; row_idx < row_end; ++row_idx) {
+        mask |= row << (row_idx * globals::CHUNK_LENGTH);
     }
+    return mask;
 }
 
-Tile& Chunk::operator[](long idx) {
-    if(idx < 0 || idx >= globals::CHUNK_AREA)
-        SPDLOG_ERROR("Invalid tile idx: {}", idx);
-
-    return tiles[idx];
+void Chunk::reset(long new_x, long new_y, bool new_update_parity) {
+    x = new_x;
+    y = new_y;
+    update_parity = new_update_parity;
+    section_loaded = false;
+    last_access = 0;
+    is_wall_bits = ~0ul;
+    is_explored_bits = 0;
+    in_fov_bits = 0;
+    std::fill(std::begin(scents), std::end(scents), 0ul);
+    entities.clear();
+    buildings.clear();
 }
 
-Tile const& Chunk::operator[](long idx) const { return tiles[idx]; }
-
 ant_proto::Chunk Chunk::get_proto() {
     ant_proto::Chunk msg;
     msg.set_x(x);
     msg.set_y(y);
     msg.set_update_parity(update_parity);
+    msg.set_is_explored(static_cast<int64_t>(is_explored_bits));
+    msg.set_in_fov(static_cast<int64_t>(in_fov_bits));
+    msg.set_is_wall(static_cast<int64_t>(is_wall_bits));
+    return msg;
+}
+
+Chunks::Chunks() : epoch(next_epoch()) {}
 
-    ulong is_explored = 0, in_fov = 0, is_wall = 0;
-    for(ulong i = 0; i < globals::CHUNK_AREA; ++i) {
-        Tile const& tile = (*this)[static_cast<long>(i)];
-        is_explored |= ((static_cast<ulong>(tile.is_explored) & 1ULL) << i);
-        in_fov |= ((static_cast<ulong>(tile.in_fov) & 1ULL) << i);
-        is_wall |= ((static_cast<ulong>(tile.is_wall) & 1ULL) << i);
+Chunks::Chunks(const ant_proto::Chunks& msg) : epoch(next_epoch()) {
+    for(const auto& chunk_key_val : msg.chunk_key_vals()) {
+        SPDLOG_TRACE("unpacking chunk {}", chunk_key_val.key());
+        create(chunk_key_val.val());
     }
-    // SPDLOG_TRACE("Packing chunk - x: {} y: {} update: {} explored: {:x} fov:
-    // {:x} walls: {:x}", obj.x, obj.y, obj.update_parity, is_explored, in_fov,
-    // is_wall);
+}
 
-    msg.set_is_explored(static_cast<int64_t>(is_explored));
-    msg.set_in_fov(static_cast<int64_t>(in_fov));
-    msg.set_is_wall(static_cast<int64_t>(is_wall));
+// Copies the chunks into the set's own arena
+Chunks::Chunks(Chunks const& other) : epoch(next_epoch()) {
+    other.for_each([this](Chunk const& chunk) {
+        Chunk& copy = arena.acquire();
+        copy = chunk;
+        insert(&copy);
+    });
+}
 
-    return msg;
+Chunks::Chunks(Chunks&& other) noexcept
+    : arena(std::move(other.arena)),
+      slots(std::move(other.slots)),
+      num_chunks(other.num_chunks),
+      epoch(next_epoch()) {
+    other.num_chunks = 0;
+    other.epoch = next_epoch();
 }
 
-Chunks::tile_iterator& Chunks::tile_iterator::operator++() {
-    ++tile_idx;
-    // SPDLOG_TRACE("Incrementing tile iterator: {}", tile_idx);
-    if(tile_idx >= get_tiles().size()) {
-        ++map_it;
-        tile_idx = 0;
-    }
+Chunks& Chunks::operator=(Chunks const& other) {
+    if(this != &other) *this = Chunks(other);
     return *this;
 }
 
-Tile& Chunks::tile_iterator::operator*() { return get_tiles()[tile_idx]; }
+Chunks& Chunks::operator=(Chunks&& other) noexcept {
+    arena = std::move(other.arena);
+    slots = std::move(other.slots);
+    num_chunks = other.num_chunks;
+    epoch = next_epoch();
+    other.num_chunks = 0;
+    other.epoch = next_epoch();
+    return *this;
+}
 
-bool Chunks::tile_iterator::operator!=(Chunks::tile_iterator const& other) {
-    return map_it != other.map_it || (tile_idx != other.tile_idx);
+ulong Chunks::next_epoch() {
+    static std::atomic<ulong> epochs = 1;
+    return epochs.fetch_add(1, std::memory_order_relaxed);
 }
 
-Chunks::tile_iterator::TileVector& Chunks::tile_iterator::get_tiles() {
-    return map_it->second->tiles;
+namespace {
+struct LastChunkHit {
+    ulong epoch = 0;
+    long x = 0, y = 0;
+    Chunk* chunk = nullptr;
+};
+thread_local LastChunkHit last_chunk_hit;
+
+ulong hash_chunk_coords(long chunk_x, long chunk_y) {
+    ulong hash = static_cast<ulong>(chunk_x) * 0x9E3779B97F4A7C15ul ^
+                 static_cast<ulong>(chunk_y) * 0xC2B2AE3D27D4EB4Ful;
+    return hash ^ (hash >> 29);
 }
+}  // namespace
 
-Chunks::Chunks(const ant_proto::Chunks& msg) {
-    for(const auto& chunk_key_val : msg.chunk_key_vals()) {
-        SPDLOG_TRACE("unpacking chunk {}", chunk_key_val.key());
-        Chunk* chunk = new Chunk(chunk_key_val.val());
-        emplace(chunk_key_val.key(), chunk);
+// Index of the chunk's slot or of the empty slot that ends its probe
+ulong Chunks::find_slot(long chunk_x, long chunk_y) const {
+    ulong const mask = slots.size() - 1;
+    ulong idx = hash_chunk_coords(chunk_x, chunk_y) & mask;
+    while(slots[idx].chunk != nullptr &&
+          (slots[idx].x != chunk_x || slots[idx].y != chunk_y)) {
+        idx = (idx + 1) & mask;
+    }
+    return idx;
+}
+
+Chunk* Chunks::find_chunk(long chunk_x, long chunk_y) const {
+    LastChunkHit& last = last_chunk_hit;
+    if(last.epoch == epoch && last.x == chunk_x && last.y == chunk_y) {
+        return last.chunk;
+    }
+    if(num_chunks == 0) return nullptr;
+    Chunk* chunk = slots[find_slot(chunk_x, chunk_y)].chunk;
+    if(chunk != nullptr) last = {epoch, chunk_x, chunk_y, chunk};
+    return chunk;
+}
+
+void Chunks::insert_slot(Chunk* chunk) {
+    long const chunk_x = chunk_coord(chunk->x), chunk_y = chunk_coord(chunk->y);
+    Slot& slot = slots[find_slot(chunk_x, chunk_y)];
+    assert(slot.chunk == nullptr);
+    slot = {chunk_x, chunk_y, chunk};
+    ++num_chunks;
+}
+
+Chunk& Chunks::create(long x, long y, bool update_parity) {
+    Chunk& chunk = arena.acquire();
+    chunk.reset(align(x), align(y), update_parity);
+    insert(&chunk);
+    return chunk;
+}
+
+Chunk& Chunks::create(const ant_proto::Chunk& msg) {
+    Chunk& chunk = create(static_cast<long>(msg.x()),
+                          static_cast<long>(msg.y()), msg.update_parity());
+    chunk.is_wall_bits = static_cast<ulong>(msg.is_wall());
+    chunk.is_explored_bits = static_cast<ulong>(msg.is_explored());
+    chunk.in_fov_bits = static_cast<ulong>(msg.in_fov());
+    return chunk;
+}
+
+// Links the chunk and the chunks around it both ways
+void Chunks::link(Chunk& chunk) {
+    long const chunk_x = chunk_coord(chunk.x), chunk_y = chunk_coord(chunk.y);
+    for(long dy = -1; dy <= 1; ++dy) {
+        for(long dx = -1; dx <= 1; ++dx) {
+            if(dx == 0 && dy == 0) continue;
+            ulong const idx = Chunk::neighbour_idx(dx, dy);
+            Chunk* neighbour = find_chunk(chunk_x + dx, chunk_y + dy);
+            chunk.neighbours[idx] = neighbour;
+            if(neighbour != nullptr) neighbour->neighbours[7 - idx] = &chunk;
+        }
     }
 }
 
+void Chunks::unlink(Chunk& chunk) {
+    for(ulong idx = 0; idx < 8; ++idx) {
+        if(chunk.neighbours[idx] == nullptr) continue;
+        chunk.neighbours[idx]->neighbours[7 - idx] = nullptr;
+        chunk.neighbours[idx] = nullptr;
+    }
+}
+
+void Chunks::insert(Chunk* chunk) {
+    // keep the load at most 1/2 so the probes stay short
+    if((num_chunks + 1) * 2 > slots.size()) {
+        std::vector<Slot> old_slots(std::max(slots.size() * 2, 64ul));
+        old_slots.swap(slots);
+        num_chunks = 0;
+        for(Slot const& slot : old_slots) {
+            if(slot.chunk != nullptr) insert_slot(slot.chunk);
+        }
+    }
+    insert_slot(chunk);
+    link(*chunk);
+}
+
 long Chunks::align(long pos) const {
     return div_floor(pos, globals::CHUNK_LENGTH) * globals::CHUNK_LENGTH;
 }
@@ -124,20 +242,22 @@ std::vector<ChunkMarker> Chunks::get_chunk_markers(const Rect& rect) const {
     return c_markers;
 }
 
+std::vector<std::pair<ulong, Chunk*>> Chunks::sorted_by_id() const {
+    std::vector<std::pair<ulong, Chunk*>> sorted;
+    sorted.reserve(num_chunks);
+    for_each([&](Chunk& chunk) {
+        sorted.push_back({get_chunk_id(chunk.x, chunk.y), &chunk});
+    });
+    std::sort(sorted.begin(), sorted.end());
+    return sorted;
+}
+
 ant_proto::Chunks Chunks::get_proto() const {
     ant_proto::Chunks msg;
-    std::vector<ulong> keys;
-    keys.reserve(chunks.size());
-    for(const auto& chunk : chunks) {
-        keys.push_back(chunk.first);
-    }
-    std::sort(keys.begin(), keys.end());
-    for(const auto key : keys) {
-        auto it = chunks.find(key);
-        if(it == chunks.end()) continue;
+    for(const auto& [key, chunk] : sorted_by_id()) {
         ant_proto::ChunkKeyVal kv_msg;
         kv_msg.set_key(key);
-        *kv_msg.mutable_val() = it->second->get_proto();
+        *kv_msg.mutable_val() = chunk->get_proto();
         *msg.add_chunk_key_vals() = kv_msg;
     }
     return msg;
@@ -156,6 +276,10 @@ Map::Map(Rect const& border, bool is_walls_enabled,
         (void)border;
 }
 
+Map::Map(Map&& other) noexcept = default;
+Map& Map::operator=(Map&& other) noexcept = default;
+Map::~Map() = default;
+
 Map::Map(const ant_proto::Map& msg, bool is_walls_enabled,
          f_xy_t pre_chunk_generation_callback)
     : generate_chunk_callback(pre_chunk_generation_callback),
@@ -196,20 +320,19 @@ void Map::dig(long x1, long y1, long x2, long y2) {
     if(y2 < y1) std::swap(y1, y2);
     SPDLOG_TRACE("Digging from ({}, {}) to ({}, {})", x1, y1, x2, y2);
 
-    for(int tx = x1; tx <= x2; ++tx) {
-        for(int ty = y1; ty <= y2; ++ty) {
-            get_tile(tx, ty).is_wall = false;
-        }
-    }
+    for_each_chunk(x1, y1, x2 + 1, y2 + 1, [](Chunk& chunk, ulong tiles) {
+        chunk.is_wall_bits &= ~tiles;
+    });
     SPDLOG_TRACE("Digging complete");
 }
 
-bool Map::can_place(long x, long y) {
-    Tile const& tile = get_tile(x, y);
-    if(tile.is_wall) return false;
-    if(tile.entity != nullptr) {
-        tile.entity->request_move();
-        return tile.entity == nullptr;
+bool Map::can_place(long x, long y) { return can_place(get_tile(x, y)); }
+
+bool Map::can_place(TileRef tile) {
+    if(tile.is_wall()) return false;
+    if(MapEntity* entity = tile.entity(); entity != nullptr) {
+        entity->request_move();
+        return tile.entity() == nullptr;
     }
     return true;
 }
@@ -224,7 +347,8 @@ void Map::add_entity(MapEntity& entity) {
 
     // notify that the entity was successfully moved
     auto entity_data = entity.get_data();
-    notify_all_moved_entity(entity_data.x, entity_data.y, entity);
+    TileStencil around(*this, entity_data.x, entity_data.y);
+    notify_all_moved_entity(around, entity);
 }
 
 void Map::remove_entity(MapEntity& entity) {
@@ -241,10 +365,11 @@ bool Map::move_entity(MapEntity& entity, long dx, long dy) {
     long new_x = x + dx, new_y = y + dy;
 
     SPDLOG_TRACE("Calling entity move callback");
-    ulong right_scents = get_tile(new_x + 1, new_y).scents;
-    ulong up_scents = get_tile(new_x, new_y - 1).scents;
-    ulong left_scents = get_tile(new_x - 1, new_y).scents;
-    ulong down_scents = get_tile(new_x, new_y + 1).scents;
+    TileStencil around(*this, new_x, new_y);
+    ulong right_scents = around.tile(1, 0).scents();
+    ulong up_scents = around.tile(0, -1).scents();
+    ulong left_scents = around.tile(-1, 0).scents();
+    ulong down_scents = around.tile(0, 1).scents();
 
     entity.move_callback({x,
                           y,
@@ -265,14 +390,15 @@ bool Map::move_entity(MapEntity& entity, long dx, long dy) {
     }
 
     // notify that the entity was successfully removed
-    notify_all_removed_entity(x, y);
+    TileStencil old_around(*this, x, y);
+    notify_all_removed_entity(old_around);
 
     data.x = new_x;
     data.y = new_y;
     add_entity(entity);
 
     // notify that the entity was successfully moved
-    notify_all_moved_entity(new_x, new_y, entity);
+    notify_all_moved_entity(around, entity);
 
     SPDLOG_TRACE("Successfully moved the entity");
     return true;
@@ -286,47 +412,36 @@ bool Map::dig(MapEntity& entity, long dx, long dy) {
     long new_x = x + dx, new_y = y + dy;
     SPDLOG_TRACE("Entity digging - new x: {} new y: {}", new_x, new_y);
 
-    Tile& tile = get_tile(new_x, new_y);
-    if(!tile.is_wall) {
+    TileRef tile = get_tile(new_x, new_y);
+    if(!tile.is_wall()) {
         SPDLOG_TRACE("Failed to dig at non-wall position");
         return false;
     }
 
-    tile.is_wall = false;
+    tile.set_wall(false);
     SPDLOG_TRACE("Entity successfully dug at - x: {} y: {}", new_x, new_y);
     return true;
 }
 
 void Map::add_building(Building& building) {
-    for(long x = building.border.x1; x <= building.border.x2; ++x) {
-        for(long y = building.border.y1; y <= building.border.y2; ++y) {
-            get_tile(x, y).building = &building;
+    for_each_span(building.border, [&building](TileSpan const& span) {
+        for(ulong offset = 0; offset < span.length; ++offset) {
+            span.chunk.buildings.set(span.idx + offset, &building);
         }
-    }
+    });
 }
 
 Building* Map::get_building(MapEntity& entity) {
     EntityData& data = entity.get_data();
-    return get_tile(data.x, data.y).building;
+    return get_tile(data.x, data.y).building();
 }
 
-void Map::create_chunk(long x, long y) {
-    ulong const chunk_id = chunks.get_chunk_id(x, y);
-    auto it = chunks.find(chunk_id);
-    if(it != chunks.end()) {
-        Chunk& chunk = *it->second;
-        chunk.update_parity = chunk_update_parity;
-        return;
-    }
+void Map::create_chunk(long x, long y) { get_chunk(x, y); }
 
-    long aligned_x = chunks.align(x), aligned_y = chunks.align(y);
-
-    SPDLOG_DEBUG("Adding chunk ({}, {}) - id: {}", x, y, chunk_id);
-    chunks.emplace(chunk_id,
-                   new Chunk(aligned_x, aligned_y, chunk_update_parity));
-
-    // create chunk
-    generate_chunk_callback(x, y);
+void Map::load_baked_chunk(long x, long y, ulong is_wall_bits) {
+    Chunk& chunk = get_chunk(x, y);
+    chunk.is_wall_bits &= is_wall_bits;
+    chunk.section_loaded = true;
 }
 
 std::vector<ChunkMarker> Map::get_chunk_markers(const Rect& rect) const {
@@ -335,14 +450,17 @@ std::vector<ChunkMarker> Map::get_chunk_markers(const Rect& rect) const {
 
 void Map::remove_unused_chunks() {
     SPDLOG_TRACE("Removing unused chunks");
-    for(auto it = chunks.begin(); it != chunks.end();) {
-        Chunk& chunk = *it->second;
-        if(chunk.update_parity == chunk_update_parity) {
-            ++it;
-            continue;
-        }
-
-        chunks.erase(it++);
+    if(pager) {
+        std::vector<Chunk*> unused;
+        for_each_cold_chunk([&](Chunk& chunk) {
+            if(chunk.update_parity != chunk_update_parity)
+                unused.push_back(&chunk);
+        });
+        page_out(std::move(unused));
+    } else {
+        chunks.erase_if([this](Chunk const& chunk) {
+            return chunk.update_parity != chunk_update_parity;
+        });
     }
     SPDLOG_TRACE("Finished removing unused chunks");
 }
@@ -356,51 +474,96 @@ void Map::update_chunks(Rect const& rect) {
 }
 
 void Map::reset_fov() {
-    for(auto it = chunks.begin_tile(); it != chunks.end_tile(); ++it) {
-        Tile& tile = *it;
-        tile.in_fov = false;
+    chunks.for_each([](Chunk& chunk) { chunk.in_fov_bits = 0; });
+}
+
+void Map::enable_paging(std::string const& path) {
+    pager = std::make_unique<ChunkPager>(path);
+    if(!pager->is_open()) pager.reset();
+}
+
+// A chunk the pager fails to take stays resident
+void Map::page_out(std::vector<Chunk*> cold_chunks) {
+    if(!pager || cold_chunks.empty()) return;
+    cold_chunks.erase(std::remove_if(cold_chunks.begin(), cold_chunks.end(),
+                                     [this](Chunk* chunk) {
+                                         return !pager->page_out(*chunk);
+                                     }),
+                      cold_chunks.end());
+    std::sort(cold_chunks.begin(), cold_chunks.end());
+    chunks.erase_if([&cold_chunks](Chunk const& chunk) {
+        return std::binary_search(cold_chunks.begin(), cold_chunks.end(),
+                                  const_cast<Chunk*>(&chunk));
+    });
+}
+
+// The paged chunks after the resident ones, by id as well
+void Map::add_paged_chunks(ant_proto::Map& msg) const {
+    if(!pager) return;
+    std::vector<std::pair<ulong, ant_proto::Chunk>> paged;
+    pager->for_each([&](Chunk& chunk) {
+        paged.emplace_back(chunks.get_chunk_id(chunk.x, chunk.y),
+                           chunk.get_proto());
+    });
+    std::sort(paged.begin(), paged.end(),
+              [](auto const& lhs, auto const& rhs) {
+                  return lhs.first < rhs.first;
+              });
+    for(auto& [key, chunk_msg] : paged) {
+        ant_proto::ChunkKeyVal& kv_msg =
+            *msg.mutable_chunks()->add_chunk_key_vals();
+        kv_msg.set_key(key);
+        *kv_msg.mutable_val() = std::move(chunk_msg);
     }
 }
 
+ulong Map::memory_usage() const {
+    ulong bytes = chunks.memory_usage();
+    chunks.for_each([&](Chunk const& chunk) { bytes += chunk.heap_bytes(); });
+    return bytes;
+}
+
 void Map::reset_tile(long x, long y) {
-    Tile& tile = get_tile(x, y);
-    tile.in_fov = false;
+    TileRef tile = get_tile(x, y);
+    tile.chunk.in_fov_bits &= ~(1ul << tile.idx);
 }
 
 void Map::explore(long x, long y) {
-    Tile& tile = get_tile(x, y);
-    tile.is_explored = true;
-    tile.in_fov = true;
+    TileRef tile = get_tile(x, y);
+    tile.chunk.is_explored_bits |= 1ul << tile.idx;
+    tile.chunk.in_fov_bits |= 1ul << tile.idx;
 }
 
 bool Map::chunk_built(const ChunkMarker& cm) const {
-    auto c_itr = chunks.find(cm.id);
-    if(c_itr == chunks.end()) return false;
-    return c_itr->second->section_loaded;
+    return chunk_built(cm.x, cm.y);
 }
 
 bool Map::chunk_built(long x, long y) const {
-    ulong id = chunks.get_chunk_id(x, y);
-    auto c_itr = chunks.find(id);
-    if(c_itr == chunks.end()) return false;
-    return c_itr->second->section_loaded;
+    Chunk const* chunk = chunks.find(x, y);
+    if(chunk == nullptr) {
+        return pager &&
+               pager->section_loaded(chunks.align(x), chunks.align(y));
+    }
+    return chunk->section_loaded;
 }
 
 bool Map::in_fov(long x, long y) {
     // SPDLOG_TRACE("Checking if tile at ({}, {}) is in fov", x, y);
 
-    return get_tile(x, y).in_fov;
+    TileRef tile = get_tile(x, y);
+    return tile.chunk.in_fov(tile.idx);
 }
 
 bool Map::is_explored(long x, long y) {
     // SPDLOG_TRACE("Checking if tile at ({}, {}) is explored", x, y);
-    return get_tile(x, y).is_explored;
+    TileRef tile = get_tile(x, y);
+    return tile.chunk.is_explored(tile.idx);
 }
 
-bool Map::is_wall(long x, long y) { return get_tile(x, y).is_wall; }
+bool Map::is_wall(long x, long y) { return get_tile(x, y).is_wall(); }
 
 bool Map::click(long x, long y) {
-    MapEntity* entity = get_tile(x, y).entity;
+    MapEntity* entity = get_tile(x, y).entity();
     if(entity == nullptr) return false;
     entity->click_callback(x, y);
     return true;
@@ -408,11 +571,11 @@ bool Map::click(long x, long y) {
 
 ulong& Map::get_tile_scents(MapEntity& entity) {
     EntityData& data = entity.get_data();
-    return get_tile(data.x, data.y).scents;
+    return get_tile(data.x, data.y).scents();
 }
 
 ulong Map::get_tile_scents_by_coord(long x, long y) {
-    return get_tile(x, y).scents;
+    return get_tile(x, y).scents();
 }
 
 ant_proto::Map Map::get_proto() const {
@@ -420,16 +583,50 @@ ant_proto::Map Map::get_proto() const {
     msg.set_needs_update(needs_update);
     msg.set_chunk_update_parity(chunk_update_parity);
     *msg.mutable_chunks() = chunks.get_proto();
+    add_paged_chunks(msg);
     return msg;
 }
 
+// Touching a chunk marks it as used in the current update parity
 Chunk& Map::get_chunk(long x, long y) {
-    create_chunk(x, y);
-    return chunks[{x, y}];
+    Chunk* chunk = chunks.find(x, y);
+    if(chunk != nullptr) {
+        touch(*chunk);
+        return *chunk;
+    }
+
+    long aligned_x = chunks.align(x), aligned_y = chunks.align(y);
+
+    SPDLOG_DEBUG("Adding chunk ({}, {}) - id: {}", x, y,
+                 chunks.get_chunk_id(x, y));
+    chunk = &chunks.create(aligned_x, aligned_y, chunk_update_parity);
+    bool const paged_in = pager && pager->page_in(aligned_x, aligned_y, *chunk);
+    touch(*chunk);
+    if(paged_in) return *chunk;
+
+    // create chunk
+    generate_chunk_callback(x, y);
+    return *chunk;
+}
+
+TileSnapshot Map::read_tile(long x, long y) const {
+    Chunk const* chunk = chunks.find(x, y);
+    if(chunk != nullptr) return chunk->snapshot(chunk->tile_idx(x, y));
+    TileSnapshot tile;
+    if(pager) pager->read_tile(x, y, tile);
+    return tile;
+}
+
+void Map::read_missing_chunk(long x, long y, Chunk& chunk) const {
+    long const aligned_x = chunks.align(x), aligned_y = chunks.align(y);
+    if(pager && pager->read(aligned_x, aligned_y, chunk)) return;
+    chunk.reset(aligned_x, aligned_y, chunk_update_parity);
 }
 
 Chunk const& Map::get_chunk_const(long x, long y) const {
-    return chunks.at(chunks.get_chunk_id(x, y));
+    Chunk const* chunk = chunks.find(x, y);
+    if(chunk == nullptr) throw std::out_of_range("chunk not created");
+    return *chunk;
 }
 
 long Map::get_local_idx(long chunk_x, long chunk_y, long x, long y) const {
@@ -438,9 +635,37 @@ long Map::get_local_idx(long chunk_x, long chunk_y, long x, long y) const {
     return local_idx;
 }
 
-Tile& Map::get_tile(long x, long y) {
+TileRef Map::get_tile(long x, long y) {
     Chunk& chunk = get_chunk(x, y);
-    return chunk[get_local_idx(chunk.x, chunk.y, x, y)];
+    return {chunk,
+            static_cast<ulong>(get_local_idx(chunk.x, chunk.y, x, y))};
+}
+
+Chunk& Map::get_linked_chunk(Chunk const* center, long x, long y,
+                             long chunk_dx, long chunk_dy) {
+    if(center != nullptr && (chunk_dx != 0 || chunk_dy != 0)) {
+        Chunk* chunk =
+            center->neighbours[Chunk::neighbour_idx(chunk_dx, chunk_dy)];
+        if(chunk != nullptr) {
+            touch(*chunk);
+            return *chunk;
+        }
+    }
+    return get_chunk(x, y);
+}
+
+TileStencil Map::get_stencil(long x, long y) { return {*this, x, y}; }
+
+TileRef TileStencil::tile(long dx, long dy) {
+    long const tile_x = x + dx, tile_y = y + dy;
+    long const chunk_dx = Chunks::chunk_coord(tile_x) - Chunks::chunk_coord(x);
+    long const chunk_dy = Chunks::chunk_coord(tile_y) - Chunks::chunk_coord(y);
+    Chunk*& chunk = chunks[(chunk_dy + 1) * 3 + chunk_dx + 1];
+    if(chunk == nullptr) {
+        chunk = &map.get_linked_chunk(chunks[4], tile_x, tile_y, chunk_dx,
+                                      chunk_dy);
+    }
+    return {*chunk, chunk->tile_idx(tile_x, tile_y)};
 }
 
 // Tile const& Map::get_tile(long x, long y) {
@@ -455,41 +680,44 @@ uchar Map::flip_direction_bits(uchar bits) {
     return ((bits >> 2) | (bits << 2)) & 0b1111;
 }
 
-void Map::notify_removed_entity(long x, long y, uchar bits) {
-    MapEntity* entity = get_tile(x, y).entity;
+void Map::notify_removed_entity(TileStencil& around, long dx, long dy,
+                                uchar bits) {
+    MapEntity* entity = around.tile(dx, dy).entity();
     if(entity == nullptr) return;
     entity->handle_empty_space(bits);
 }
 
-void Map::notify_moved_entity(MapEntity& source, long x, long y, uchar bits) {
+void Map::notify_moved_entity(MapEntity& source, TileStencil& around,
+                              long dx, long dy, uchar bits) {
     uchar source_bits = flip_direction_bits(bits);
-    if(can_place(x, y)) {
+    TileRef tile = around.tile(dx, dy);
+    if(can_place(tile)) {
         source.handle_empty_space(source_bits);
         return;
     }
     source.handle_full_space(source_bits);
 
-    MapEntity* entity = get_tile(x, y).entity;
+    MapEntity* entity = tile.entity();
     if(entity == nullptr) return;
     entity->handle_full_space(bits);
 }
 
 void Map::set_entity(long x, long y, MapEntity* entity) {
     SPDLOG_DEBUG("Setting entity at ({}, {})", x, y);
-    get_tile(x, y).entity = entity;
+    get_tile(x, y).set_entity(entity);
     needs_update = true;
 }
 
-void Map::notify_all_removed_entity(long x, long y) {
-    notify_removed_entity(x - 1, y, 0b0001);  // right
-    notify_removed_entity(x, y + 1, 0b0010);  // up
-    notify_removed_entity(x + 1, y, 0b0100);  // left
-    notify_removed_entity(x, y - 1, 0b1000);  // down
+void Map::notify_all_removed_entity(TileStencil& around) {
+    notify_removed_entity(around, -1, 0, 0b0001);  // right
+    notify_removed_entity(around, 0, 1, 0b0010);   // up
+    notify_removed_entity(around, 1, 0, 0b0100);   // left
+    notify_removed_entity(around, 0, -1, 0b1000);  // down
 }
 
-void Map::notify_all_moved_entity(long x, long y, MapEntity& entity) {
-    notify_moved_entity(entity, x - 1, y, 0b0001);  // right
-    notify_moved_entity(entity, x, y + 1, 0b0010);  // up
-    notify_moved_entity(entity, x + 1, y, 0b0100);  // left
-    notify_moved_entity(entity, x, y - 1, 0b1000);  // down
+void Map::notify_all_moved_entity(TileStencil& around, MapEntity& entity) {
+    notify_moved_entity(entity, around, -1, 0, 0b0001);  // right
+    notify_moved_entity(entity, around, 0, 1, 0b0010);   // up
+    notify_moved_entity(entity, around, 1, 0, 0b0100);   // left
+    notify_moved_entity(entity, around, 0, -1, 0b1000);  // down
 }
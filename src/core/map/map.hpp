@@ -1,6 +1,9 @@
 #pragma once
 
-#include <unordered_map>
+#include <algorithm>
+#include <bit>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "app/globals.hpp"
@@ -9,17 +12,12 @@
 #include "entity/entity_data.hpp"
 #include "map.pb.h"
 #include "map/section_data.hpp"
+#include "utils/arena.hpp"
+#include "utils/parallel.hpp"
+#include "utils/thread_pool.hpp"
 
-struct Tile {
-    bool is_explored = false;  // has this tile already been seen by the player?
-    bool in_fov = false;       // is the tile currently visible to the player?
-    bool is_wall = true;
-    MapEntity* entity = nullptr;
-    Building* building = nullptr;
-    ulong scents = 0;
-    Tile(bool is_explored = false, bool in_fov = false, bool is_wall = true)
-        : is_explored(is_explored), in_fov(in_fov), is_wall(is_wall) {}
-};
+class ChunkPager;
+class TileStencil;
 
 struct ChunkMarker {
     long x;
@@ -31,81 +29,290 @@ struct ChunkMarker {
     bool operator<(const ChunkMarker& rhs) const { return id < rhs.id; }
 };
 
+// Pointers of the few tiles of a chunk that have one - entities and
+// buildings occupy a small share of the tiles. The mask answers most
+// lookups without a scan.
+template <class T>
+class SparseTiles {
+    ulong mask = 0;
+    std::vector<std::pair<ulong, T*>> items;
+
+   public:
+    T* get(ulong idx) const {
+        if((mask >> idx & 1) == 0) return nullptr;
+        for(auto const& [item_idx, item] : items) {
+            if(item_idx == idx) return item;
+        }
+        return nullptr;
+    }
+    void set(ulong idx, T* item) {
+        auto it = std::find_if(items.begin(), items.end(),
+                               [idx](auto const& entry) {
+                                   return entry.first == idx;
+                               });
+        if(item == nullptr) {
+            if(it == items.end()) return;
+            *it = items.back();
+            items.pop_back();
+            mask &= ~(1ul << idx);
+            return;
+        }
+        if(it != items.end()) {
+            it->second = item;
+            return;
+        }
+        items.push_back({idx, item});
+        mask |= 1ul << idx;
+    }
+    // keeps the capacity for the next use of the chunk
+    void clear() {
+        mask = 0;
+        items.clear();
+    }
+    ulong tiles() const { return mask; }
+    ulong heap_bytes() const { return items.capacity() * sizeof(items[0]); }
+};
+
+// A copy of one tile for the read-only queries. The defaults are the tile of
+// a chunk that was never created.
+struct TileSnapshot {
+    bool is_wall = true;
+    bool is_explored = false;
+    bool in_fov = false;
+    ulong scents = 0;
+};
+
+// The tiles of a CHUNK_LENGTH x CHUNK_LENGTH square stored by field. Tile
+// idx is (x + idx % CHUNK_LENGTH, y + idx / CHUNK_LENGTH) and bit idx of the
+// flag masks, the layout of ant_proto::Chunk, so work on many tiles of a
+// chunk is a few word-wide bit ops.
 struct Chunk {
+    static_assert(globals::CHUNK_AREA == 64, "a chunk's flags fill a word");
+
     long x = 0, y = 0;
     bool update_parity = true;
     bool section_loaded = false;
-    std::vector<Tile> tiles;
+    uint last_access = 0;  // the map's access clock when it was last used
+    ulong is_wall_bits = ~0ul;
+    ulong is_explored_bits = 0;  // seen by the player before
+    ulong in_fov_bits = 0;       // visible to the player now
+    ulong scents[globals::CHUNK_AREA] = {};
+    SparseTiles<MapEntity> entities;
+    SparseTiles<Building> buildings;
+    // The chunks around by neighbour_idx, nullptr where there is none -
+    // kept by the Chunks the chunk is in
+    Chunk* neighbours[8] = {};
 
     Chunk() = default;
     Chunk(long x, long y, bool update_parity);
     Chunk(const ant_proto::Chunk& msg);
+    // Turns a recycled chunk into a new one at (x, y) - the neighbour links
+    // are left to the Chunks it goes into
+    void reset(long x, long y, bool update_parity);
 
-    Tile& operator[](long idx);
-    Tile const& operator[](long idx) const;
+    bool is_wall(ulong idx) const { return is_wall_bits >> idx & 1; }
+    bool is_explored(ulong idx) const { return is_explored_bits >> idx & 1; }
+    bool in_fov(ulong idx) const { return in_fov_bits >> idx & 1; }
+    long tile_x(ulong idx) const {
+        return x + static_cast<long>(idx) % globals::CHUNK_LENGTH;
+    }
+    long tile_y(ulong idx) const {
+        return y + static_cast<long>(idx) / globals::CHUNK_LENGTH;
+    }
+    // idx of the tile at (tile_x, tile_y) of the chunk
+    ulong tile_idx(long tile_x, long tile_y) const {
+        return static_cast<ulong>((tile_x - x) +
+                                  (tile_y - y) * globals::CHUNK_LENGTH);
+    }
+    TileSnapshot snapshot(ulong idx) const {
+        return {is_wall(idx), is_explored(idx), in_fov(idx), scents[idx]};
+    }
+    // Index in neighbours of the chunk at chunk offset (dx, dy) - row by
+    // row without the center, so the opposite of neighbour i is 7 - i
+    static ulong neighbour_idx(long dx, long dy) {
+        ulong const cell = static_cast<ulong>((dy + 1) * 3 + dx + 1);
+        return cell - (cell > 4);
+    }
+    // The chunk's tiles within [x_begin, x_end) x [y_begin, y_end)
+    ulong rect_mask(long x_begin, long y_begin, long x_end,
+                    long y_end) const;
+    // bytes of the occupancy lists outside the chunk
+    ulong heap_bytes() const {
+        return entities.heap_bytes() + buildings.heap_bytes();
+    }
 
     ant_proto::Chunk get_proto();
 };
 
-class Chunks {
-    using ChunkMap = std::unordered_map<ulong, Chunk*>;
-
-   public:
-    class tile_iterator {
-        using TileVector = std::vector<Tile>;
+// One tile of a chunk - a view into the chunk's planes
+struct TileRef {
+    Chunk& chunk;
+    ulong idx;
 
-       public:
-        tile_iterator(ChunkMap::iterator const& map_it)
-            : map_it(map_it), tile_idx(0) {}
+    bool is_wall() const { return chunk.is_wall(idx); }
+    void set_wall(bool is_wall) const {
+        ulong const bit = 1ul << idx;
+        chunk.is_wall_bits =
+            is_wall ? chunk.is_wall_bits | bit : chunk.is_wall_bits & ~bit;
+    }
+    MapEntity* entity() const { return chunk.entities.get(idx); }
+    void set_entity(MapEntity* entity) const {
+        chunk.entities.set(idx, entity);
+    }
+    Building* building() const { return chunk.buildings.get(idx); }
+    void set_building(Building* building) const {
+        chunk.buildings.set(idx, building);
+    }
+    ulong& scents() const { return chunk.scents[idx]; }
+};
 
-        tile_iterator& operator++();
+// A run of tiles (x, y) .. (x + length - 1, y) in one row of a chunk - tiles
+// idx .. idx + length - 1 of the chunk. ChunkT is Chunk or Chunk const.
+template <class ChunkT>
+struct BasicTileSpan {
+    ChunkT& chunk;
+    long x, y;
+    ulong idx;
+    ulong length;
 
-        Tile& operator*();
-        bool operator!=(tile_iterator const& other);
+    // the span's bits in the chunk's planes
+    ulong mask() const { return ((1ul << length) - 1) << idx; }
+    // the span's scents, contiguous in the chunk
+    auto* scents() const { return chunk.scents + idx; }
+    TileSnapshot snapshot(ulong offset) const {
+        return chunk.snapshot(idx + offset);
+    }
 
-       private:
-        TileVector& get_tiles();
+    // Calls fn(span) for each row of the tiles of the chunk
+    template <class SpanFn>
+    static void for_each_row(ChunkT& chunk, ulong tiles, SpanFn const& fn) {
+        for(ulong row = 0; tiles != 0; ++row, tiles >>= globals::CHUNK_LENGTH) {
+            ulong const row_tiles = tiles & 0xFFul;
+            if(row_tiles == 0) continue;
+            ulong const col = static_cast<ulong>(std::countr_zero(row_tiles));
+            ulong const idx = row * globals::CHUNK_LENGTH + col;
+            fn(BasicTileSpan{chunk, chunk.tile_x(idx), chunk.tile_y(idx), idx,
+                             static_cast<ulong>(std::popcount(row_tiles))});
+        }
+    }
+};
+using TileSpan = BasicTileSpan<Chunk>;
+using ConstTileSpan = BasicTileSpan<Chunk const>;
 
-        ChunkMap::iterator map_it;
-        ulong tile_idx;
+// Chunks keyed on their chunk coordinates (tile position / CHUNK_LENGTH) in
+// an open addressing table with linear probing. Lookups first check a
+// per-thread cache of the last chunk found - tile reads come in runs around
+// one position, so most of them skip the table. The spiral chunk id is only
+// computed for the chunk markers and the saves.
+//
+// The chunks live in the set's arena. Erased chunks go back to it and are
+// reused by the next created ones, so a map that keeps evicting and
+// exploring stops allocating once the arena covers its working set.
+class Chunks {
+    struct Slot {
+        long x = 0, y = 0;  // chunk coordinates
+        Chunk* chunk = nullptr;  // empty slot
     };
+    SlabArena<Chunk> arena;
+    std::vector<Slot> slots;  // size is a power of two
+    ulong num_chunks = 0;
+    // Names this set of chunks in the last-hit caches. A fresh one is taken
+    // from a global counter on construction, copy and erase, so a cache
+    // never answers for another set or for a removed chunk.
+    ulong epoch;
 
-    Chunks() = default;
+    ulong find_slot(long chunk_x, long chunk_y) const;
+    void insert_slot(Chunk* chunk);
+    void insert(Chunk* chunk);
+    void link(Chunk& chunk);
+    void unlink(Chunk& chunk);
+    std::vector<std::pair<ulong, Chunk*>> sorted_by_id() const;
 
-    Chunks(const ant_proto::Chunks& msg);
+   public:
+    static constexpr long chunk_shift = 3;
+    static_assert(globals::CHUNK_LENGTH == 1 << chunk_shift);
 
-    tile_iterator begin_tile() { return tile_iterator(chunks.begin()); }
-    tile_iterator end_tile() { return tile_iterator(chunks.end()); }
+    Chunks();
+    Chunks(const ant_proto::Chunks& msg);
+    Chunks(Chunks const& other);
+    Chunks(Chunks&& other) noexcept;
+    Chunks& operator=(Chunks const& other);
+    Chunks& operator=(Chunks&& other) noexcept;
 
-    ChunkMap::iterator begin() { return chunks.begin(); }
-    ChunkMap::const_iterator begin() const { return chunks.begin(); }
-    ChunkMap::iterator end() { return chunks.end(); }
-    ChunkMap::const_iterator end() const { return chunks.end(); }
+    // chunk coordinate of a tile position
+    static long chunk_coord(long pos) { return pos >> chunk_shift; }
 
-    ChunkMap::iterator find(ulong chunk_id) { return chunks.find(chunk_id); }
-    ChunkMap::const_iterator find(ulong chunk_id) const {
-        return chunks.find(chunk_id);
+    // The chunk holding the tile or nullptr
+    Chunk* find(long x, long y) const {
+        return find_chunk(chunk_coord(x), chunk_coord(y));
+    }
+    Chunk* find_chunk(long chunk_x, long chunk_y) const;
+    // The tile of its chunk or of a new chunk when there is none - creates
+    // nothing
+    TileSnapshot read_tile(long x, long y) const {
+        Chunk const* chunk = find(x, y);
+        if(chunk == nullptr) return {};
+        return chunk->snapshot(chunk->tile_idx(x, y));
+    }
+    // The tile's chunk must not be in the set yet
+    Chunk& create(long x, long y, bool update_parity);
+    Chunk& create(const ant_proto::Chunk& msg);
+    template <class Pred>
+    void erase_if(Pred pred) {
+        std::vector<Chunk*> kept;
+        kept.reserve(num_chunks);
+        for_each([&](Chunk& chunk) {
+            if(pred(chunk)) {
+                unlink(chunk);
+                arena.release(chunk);
+            } else {
+                kept.push_back(&chunk);
+            }
+        });
+        if(kept.size() == num_chunks) return;
+        std::fill(slots.begin(), slots.end(), Slot{});
+        num_chunks = 0;
+        for(Chunk* chunk : kept) insert_slot(chunk);
+        epoch = next_epoch();
+    }
+    template <class Fn>
+    void for_each(Fn fn) const {
+        for(Slot const& slot : slots) {
+            if(slot.chunk != nullptr) fn(*slot.chunk);
+        }
+    }
+    ulong size() const { return num_chunks; }
+    SlabArena<Chunk> const& get_arena() const { return arena; }
+    // bytes of the table and the arena, free chunks included
+    ulong memory_usage() const {
+        return sizeof(Chunks) + slots.capacity() * sizeof(Slot) +
+               arena.memory_usage();
     }
 
-    void create_chunk(const ChunkMarker& cm);
     std::vector<ChunkMarker> get_chunk_markers(const Rect& rect) const;
-
-    void erase(ChunkMap::iterator it) { chunks.erase(it); }
     long align(long pos) const;  // takes a tile pos and aligns it to chunk
     ulong get_chunk_id(long x, long y) const;
-    Chunk& operator[](ulong chunk_id) { return *chunks[chunk_id]; }
-    Chunk& operator[](std::pair<long, long> p) {
-        return *chunks[get_chunk_id(p.first, p.second)];
-    }
-    Chunk const& at(ulong chunk_id) const { return *chunks.at(chunk_id); }
-    void emplace(ulong chunk_id, Chunk* chunk) {
-        chunks.emplace(chunk_id, chunk);
-    }
 
     ant_proto::Chunks get_proto() const;
+    // Packs the chunks on the pool - the messages come out the same
+    template <class Job>
+    ant_proto::Chunks get_proto(ThreadPool<Job>& pool) const {
+        std::vector<std::pair<ulong, Chunk*>> const sorted = sorted_by_id();
+        std::vector<ant_proto::Chunk> chunk_msgs(sorted.size());
+        parallel_for(pool, 0, sorted.size(), 16, [&](ulong idx) {
+            chunk_msgs[idx] = sorted[idx].second->get_proto();
+        });
+        ant_proto::Chunks msg;
+        for(ulong idx = 0; idx < sorted.size(); ++idx) {
+            ant_proto::ChunkKeyVal& kv_msg = *msg.add_chunk_key_vals();
+            kv_msg.set_key(sorted[idx].first);
+            *kv_msg.mutable_val() = std::move(chunk_msgs[idx]);
+        }
+        return msg;
+    }
 
    private:
-    ChunkMap chunks;
+    static ulong next_epoch();
 };
 
 class Map {
@@ -121,6 +328,9 @@ class Map {
         f_xy_t pre_chunk_generation_callback);
     Map(const ant_proto::Map& msg, bool is_walls_enabled,
         f_xy_t pre_chunk_generation_callback);
+    Map(Map&& other) noexcept;
+    Map& operator=(Map&& other) noexcept;
+    ~Map();
 
     void load_section(MapSectionData const& section_data);
     void dig(long x1, long y1, long x2, long y2);
@@ -129,14 +339,30 @@ class Map {
     void add_entity(MapEntity& entity);
     void remove_entity(MapEntity& entity);
     bool move_entity(MapEntity& entity, long dx, long dy);
+    // The 3x3 tiles around (x, y) - see TileStencil
+    TileStencil get_stencil(long x, long y);
     bool dig(MapEntity& entity, long dx, long dy);
     void add_building(Building& building);
     Building* get_building(MapEntity& entity);
     void create_chunk(long x, long y);
+    // Puts a chunk generated ahead of time at (x, y) - digs out the tiles
+    // that are no walls in is_wall_bits and marks its section loaded. See
+    // BakedWorld.
+    void load_baked_chunk(long x, long y, ulong is_wall_bits);
     std::vector<ChunkMarker> get_chunk_markers(const Rect& rect) const;
+    // Drops the chunks not used in the current update parity - pages them
+    // out instead when paging is enabled
     void remove_unused_chunks();
     void update_chunks(Rect const& rect);
     void reset_fov();
+    template <class Job>
+    void reset_fov(ThreadPool<Job>& pool) {
+        std::vector<Chunk*> all_chunks;
+        all_chunks.reserve(chunks.size());
+        chunks.for_each([&](Chunk& chunk) { all_chunks.push_back(&chunk); });
+        parallel_for(pool, 0, all_chunks.size(), 64,
+                     [&](ulong idx) { all_chunks[idx]->in_fov_bits = 0; });
+    }
     void reset_tile(long x, long y);
     void explore(long x, long y);
     bool chunk_built(const ChunkMarker& cm) const;
@@ -148,19 +374,186 @@ class Map {
     ulong& get_tile_scents(MapEntity& entity);
     ulong get_tile_scents_by_coord(long x, long y);
     ant_proto::Map get_proto() const;
+    template <class Job>
+    ant_proto::Map get_proto(ThreadPool<Job>& pool) const {
+        ant_proto::Map msg;
+        msg.set_needs_update(needs_update);
+        msg.set_chunk_update_parity(chunk_update_parity);
+        *msg.mutable_chunks() = chunks.get_proto(pool);
+        add_paged_chunks(msg);
+        return msg;
+    }
+
+    // Calls fn(chunk, tiles) for the chunks overlapping [x_begin, x_end) x
+    // [y_begin, y_end) with the mask of the chunk's tiles inside, in the
+    // order a column by column scan of the tiles reaches them. Missing
+    // chunks are created on the way.
+    template <class ChunkFn>
+    void for_each_chunk(long x_begin, long y_begin, long x_end, long y_end,
+                        ChunkFn const& fn) {
+        for_each_chunk_pos(x_begin, y_begin, x_end, y_end,
+                           [&](long x, long y) {
+                               Chunk& chunk = get_chunk(x, y);
+                               fn(chunk, chunk.rect_mask(x_begin, y_begin,
+                                                         x_end, y_end));
+                           });
+    }
+    // The same on the pool. A chunk belongs to one job so fn may write it.
+    // The chunks are created beforehand on the calling thread.
+    template <class Job, class ChunkFn>
+    void for_each_chunk(ThreadPool<Job>& pool, long x_begin, long y_begin,
+                        long x_end, long y_end, ChunkFn const& fn) {
+        std::vector<Chunk*> loaded;
+        for_each_chunk_pos(x_begin, y_begin, x_end, y_end,
+                           [&](long x, long y) {
+                               loaded.push_back(&get_chunk(x, y));
+                           });
+        parallel_for(pool, 0, loaded.size(), 4, [&](ulong idx) {
+            Chunk& chunk = *loaded[idx];
+            fn(chunk, chunk.rect_mask(x_begin, y_begin, x_end, y_end));
+        });
+    }
+    // Calls fn(span) for each row of each chunk within [x_begin, x_end) x
+    // [y_begin, y_end) - a chunk lookup per chunk instead of per tile. The
+    // chunks come in for_each_chunk's order, their rows top to bottom.
+    template <class SpanFn>
+    void for_each_span(long x_begin, long y_begin, long x_end, long y_end,
+                       SpanFn const& fn) {
+        for_each_chunk(x_begin, y_begin, x_end, y_end,
+                       [&fn](Chunk& chunk, ulong tiles) {
+                           TileSpan::for_each_row(chunk, tiles, fn);
+                       });
+    }
+    template <class SpanFn>
+    void for_each_span(Rect const& rect, SpanFn const& fn) {
+        for_each_span(rect.x1, rect.y1, rect.x2 + 1, rect.y2 + 1, fn);
+    }
+    // bytes of all chunks of the map
+    ulong memory_usage() const;
+
+    // Read-only queries. They create and generate nothing - a tile of a
+    // chunk that was never created reads as a tile of a new chunk, a paged
+    // out one is read from the page file. Several threads may query at once
+    // while nothing changes the map.
+    TileSnapshot read_tile(long x, long y) const;
+    // Calls fn(chunk, tiles) like for_each_chunk, passing a new chunk at its
+    // position for the missing ones
+    template <class ChunkFn>
+    void read_chunks(long x_begin, long y_begin, long x_end, long y_end,
+                     ChunkFn const& fn) const {
+        Chunk missing;
+        for_each_chunk_pos(x_begin, y_begin, x_end, y_end,
+                           [&](long x, long y) {
+                               Chunk const* chunk = chunks.find(x, y);
+                               if(chunk == nullptr) {
+                                   read_missing_chunk(x, y, missing);
+                                   chunk = &missing;
+                               }
+                               fn(*chunk, chunk->rect_mask(x_begin, y_begin,
+                                                           x_end, y_end));
+                           });
+    }
+    // The spans of read_chunks - see for_each_span
+    template <class SpanFn>
+    void read_spans(long x_begin, long y_begin, long x_end, long y_end,
+                    SpanFn const& fn) const {
+        read_chunks(x_begin, y_begin, x_end, y_end,
+                    [&fn](Chunk const& chunk, ulong tiles) {
+                        ConstTileSpan::for_each_row(chunk, tiles, fn);
+                    });
+    }
+    template <class SpanFn>
+    void read_spans(Rect const& rect, SpanFn const& fn) const {
+        read_spans(rect.x1, rect.y1, rect.x2 + 1, rect.y2 + 1, fn);
+    }
+    // Creates the missing chunks of the rect, generating the world there -
+    // what the queries above leave to the caller
+    void load_chunks(long x_begin, long y_begin, long x_end, long y_end) {
+        for_each_chunk_pos(x_begin, y_begin, x_end, y_end,
+                           [this](long x, long y) { get_chunk(x, y); });
+    }
+
+    // Pages chunks out to a page file at path instead of dropping them.
+    // get_chunk pages them back in when they are used again.
+    void enable_paging(std::string const& path);
+    ChunkPager const* get_pager() const { return pager.get(); }
+    ulong num_resident_chunks() const { return chunks.size(); }
+    // Calls fn(chunk) for the resident chunks that may be paged out - the
+    // ones without occupants that were not used since the last
+    // advance_access_clock
+    template <class ChunkFn>
+    void for_each_cold_chunk(ChunkFn const& fn) {
+        if(!pager) return;
+        chunks.for_each([&](Chunk& chunk) {
+            if(chunk.last_access == access_clock) return;
+            if(chunk.entities.tiles() != 0 || chunk.buildings.tiles() != 0)
+                return;
+            fn(chunk);
+        });
+    }
+    // Pages out cold chunks of this map. Invalidates all chunk pointers.
+    void page_out(std::vector<Chunk*> cold_chunks);
+    // Chunks used from now on are not cold in the next paging pass
+    void advance_access_clock() { ++access_clock; }
 
    private:
+    // Calls fn(x, y) with a tile of each chunk of the rect in scan order
+    template <class PosFn>
+    void for_each_chunk_pos(long x_begin, long y_begin, long x_end,
+                            long y_end, PosFn const& fn) const {
+        for(long x = x_begin; x < x_end;
+            x = chunks.align(x) + globals::CHUNK_LENGTH) {
+            for(long y = y_begin; y < y_end;
+                y = chunks.align(y) + globals::CHUNK_LENGTH) {
+                fn(x, y);
+            }
+        }
+    }
+    // Marks a chunk as used now - see update_parity and last_access
+    void touch(Chunk& chunk) {
+        chunk.update_parity = chunk_update_parity;
+        chunk.last_access = access_clock;
+    }
     Chunk& get_chunk(long x, long y);
+    // The chunk of (x, y) at chunk offset (chunk_dx, chunk_dy) from center,
+    // through center's link when it has one
+    Chunk& get_linked_chunk(Chunk const* center, long x, long y,
+                            long chunk_dx, long chunk_dy);
     Chunk const& get_chunk_const(long x, long y) const;
     long get_local_idx(long chunk_x, long chunk_y, long x, long y) const;
-    Tile& get_tile(long x, long y);
+    TileRef get_tile(long x, long y);
+    bool can_place(TileRef tile);
     uchar flip_direction_bits(uchar bits);
-    void notify_removed_entity(long x, long y, uchar bits);
-    void notify_moved_entity(MapEntity& source, long x, long y, uchar bits);
+    void notify_removed_entity(TileStencil& around, long dx, long dy,
+                               uchar bits);
+    void notify_moved_entity(MapEntity& source, TileStencil& around,
+                             long dx, long dy, uchar bits);
     void set_entity(long x, long y, MapEntity* entity);
-    void notify_all_removed_entity(long x, long y);
-    void notify_all_moved_entity(long x, long y, MapEntity& entity);
+    void notify_all_removed_entity(TileStencil& around);
+    void notify_all_moved_entity(TileStencil& around, MapEntity& entity);
+
+    void add_paged_chunks(ant_proto::Map& msg) const;
+    void read_missing_chunk(long x, long y, Chunk& chunk) const;
 
     Chunks chunks;
     bool is_walls_enabled;
+    std::unique_ptr<ChunkPager> pager;
+    uint access_clock = 1;
+
+    friend class TileStencil;
+};
+
+// The 3x3 tiles around a center tile for the movement and notification
+// code - tile(dx, dy) for dx, dy in -1..1. The chunks are found through the
+// center chunk's neighbour links instead of the table, each the first time
+// a tile of it is used. A missing chunk is created then, like get_tile
+// would, so the stencil generates no more of the world than the tiles used.
+class TileStencil {
+    Map& map;
+    long x, y;
+    Chunk* chunks[9] = {};  // by chunk offset, row by row - the center's at 4
+
+   public:
+    TileStencil(Map& map, long x, long y) : map(map), x(x), y(y) {}
+    TileRef tile(long dx, long dy);
 };
@@ -0,0 +1,191 @@
+#include "map/pager.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+namespace {
+// Words of a record before the scents
+enum RecordWord : ulong {
+    X,
+    Y,
+    FLAGS,
+    IS_WALL,
+    IS_EXPLORED,
+    IN_FOV,
+    SCENT_MASK,
+    HEADER_WORDS,
+};
+ulong const UPDATE_PARITY_FLAG = 1;
+ulong const SECTION_LOADED_FLAG = 2;
+ulong const MIN_CAPACITY = 1ul << 20;
+
+ulong scent_mask(Chunk const& chunk) {
+    ulong mask = 0;
+    for(ulong idx = 0; idx < globals::CHUNK_AREA; ++idx) {
+        if(chunk.scents[idx] != 0) mask |= 1ul << idx;
+    }
+    return mask;
+}
+}  // namespace
+
+ChunkPager::ChunkPager(std::string const& path)
+    : fd(open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600)) {
+    if(fd < 0) {
+        SPDLOG_ERROR("Failed to open the page file {}", path);
+        return;
+    }
+    unlink(path.c_str());
+    if(!reserve(MIN_CAPACITY)) return;
+    SPDLOG_DEBUG("Paging chunks to {}", path);
+}
+
+ChunkPager::~ChunkPager() {
+    if(data != nullptr) munmap(data, capacity);
+    if(fd >= 0) close(fd);
+}
+
+// Grows the file and its mapping to hold bytes more after end
+bool ChunkPager::reserve(ulong bytes) {
+    if(fd < 0) return false;
+    if(end + bytes <= capacity) return true;
+    ulong new_capacity = std::max(capacity, MIN_CAPACITY);
+    while(new_capacity < end + bytes) new_capacity *= 2;
+    if(ftruncate(fd, static_cast<off_t>(new_capacity)) != 0) {
+        SPDLOG_ERROR("Failed to grow the page file to {} bytes", new_capacity);
+        return false;
+    }
+    void* mapped = mmap(nullptr, new_capacity, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, fd, 0);
+    if(mapped == MAP_FAILED) {
+        SPDLOG_ERROR("Failed to map {} bytes of the page file", new_capacity);
+        return false;
+    }
+    if(data != nullptr) munmap(data, capacity);
+    data = static_cast<char*>(mapped);
+    capacity = new_capacity;
+    return true;
+}
+
+bool ChunkPager::page_out(Chunk const& chunk) {
+    ulong const mask = scent_mask(chunk);
+    ulong const size =
+        (HEADER_WORDS + static_cast<ulong>(std::popcount(mask))) *
+        sizeof(ulong);
+    if(!reserve(size)) return false;
+
+    ulong* words = reinterpret_cast<ulong*>(data + end);
+    words[X] = static_cast<ulong>(chunk.x);
+    words[Y] = static_cast<ulong>(chunk.y);
+    words[FLAGS] = (chunk.update_parity ? UPDATE_PARITY_FLAG : 0) |
+                   (chunk.section_loaded ? SECTION_LOADED_FLAG : 0);
+    words[IS_WALL] = chunk.is_wall_bits;
+    words[IS_EXPLORED] = chunk.is_explored_bits;
+    words[IN_FOV] = chunk.in_fov_bits;
+    words[SCENT_MASK] = mask;
+    ulong* scent = words + HEADER_WORDS;
+    for(ulong bits = mask; bits != 0; bits &= bits - 1) {
+        *scent++ = chunk.scents[std::countr_zero(bits)];
+    }
+
+    records[{chunk.x, chunk.y}] = {end, size, chunk.section_loaded};
+    end += size;
+    ++stats.page_outs;
+    return true;
+}
+
+bool ChunkPager::page_in(long x, long y, Chunk& chunk) {
+    auto it = records.find({x, y});
+    if(it == records.end()) return false;
+    decode(data + it->second.offset, chunk);
+    garbage += it->second.size;
+    records.erase(it);
+    ++stats.page_ins;
+    if(garbage > end / 2 && end > MIN_CAPACITY / 2) compact();
+    return true;
+}
+
+void ChunkPager::decode(char const* record, Chunk& chunk) {
+    ulong const* words = reinterpret_cast<ulong const*>(record);
+    chunk.reset(static_cast<long>(words[X]), static_cast<long>(words[Y]),
+                words[FLAGS] & UPDATE_PARITY_FLAG);
+    chunk.section_loaded = words[FLAGS] & SECTION_LOADED_FLAG;
+    chunk.is_wall_bits = words[IS_WALL];
+    chunk.is_explored_bits = words[IS_EXPLORED];
+    chunk.in_fov_bits = words[IN_FOV];
+    ulong const* scent = words + HEADER_WORDS;
+    for(ulong bits = words[SCENT_MASK]; bits != 0; bits &= bits - 1) {
+        chunk.scents[std::countr_zero(bits)] = *scent++;
+    }
+}
+
+// Moves the live records to the front of the file in file order
+void ChunkPager::compact() {
+    std::vector<Record*> live;
+    live.reserve(records.size());
+    for(auto& [key, record] : records) live.push_back(&record);
+    std::sort(live.begin(), live.end(), [](Record* lhs, Record* rhs) {
+        return lhs->offset < rhs->offset;
+    });
+    ulong offset = 0;
+    for(Record* record : live) {
+        std::memmove(data + offset, data + record->offset, record->size);
+        record->offset = offset;
+        offset += record->size;
+    }
+    SPDLOG_DEBUG("Compacted the page file from {} to {} bytes", end, offset);
+    end = offset;
+    garbage = 0;
+}
+
+bool ChunkPager::read(long x, long y, Chunk& chunk) const {
+    auto it = records.find({x, y});
+    if(it == records.end()) return false;
+    decode(data + it->second.offset, chunk);
+    return true;
+}
+
+bool ChunkPager::read_tile(long x, long y, TileSnapshot& tile) const {
+    long const chunk_x = Chunks::chunk_coord(x) * globals::CHUNK_LENGTH;
+    long const chunk_y = Chunks::chunk_coord(y) * globals::CHUNK_LENGTH;
+    auto it = records.find({chunk_x, chunk_y});
+    if(it == records.end()) return false;
+    ulong const* words =
+        reinterpret_cast<ulong const*>(data + it->second.offset);
+    ulong const idx = static_cast<ulong>(
+        (x - chunk_x) + (y - chunk_y) * globals::CHUNK_LENGTH);
+    ulong const bit = 1ul << idx;
+    tile.is_wall = words[IS_WALL] & bit;
+    tile.is_explored = words[IS_EXPLORED] & bit;
+    tile.in_fov = words[IN_FOV] & bit;
+    tile.scents = 0;
+    if(words[SCENT_MASK] & bit) {
+        ulong const rank =
+            static_cast<ulong>(std::popcount(words[SCENT_MASK] & (bit - 1)));
+        tile.scents = words[HEADER_WORDS + rank];
+    }
+    return true;
+}
+
+bool ChunkPager::contains(long x, long y) const {
+    return records.find({x, y}) != records.end();
+}
+
+bool ChunkPager::section_loaded(long x, long y) const {
+    auto it = records.find({x, y});
+    return it != records.end() && it->second.section_loaded;
+}
+
+ChunkPagerStats ChunkPager::get_stats() const {
+    ChunkPagerStats current = stats;
+    current.num_paged = records.size();
+    current.file_bytes = end;
+    return current;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include "map/map.hpp"
+#include "utils/types.hpp"
+
+struct ChunkPagerStats {
+    ulong page_ins = 0;
+    ulong page_outs = 0;
+    ulong num_paged = 0;   // chunks in the page file now
+    ulong file_bytes = 0;  // bytes of the page file in use, garbage included
+};
+
+// Keeps chunks that were paged out of a Map in a memory-mapped page file.
+// A chunk is written as one record of its coordinates, flags and bit planes
+// followed by its non-zero scents only - an unexplored chunk takes 56 bytes
+// instead of a resident Chunk. Records are appended; the space of paged in
+// records is reclaimed by compacting the file once it is mostly garbage.
+//
+// The file is removed as soon as it is open, the pager is its only owner.
+// The occupancy lists (entities, buildings) are not paged - chunks with
+// occupants must stay resident.
+class ChunkPager {
+    struct Record {
+        ulong offset;
+        ulong size;
+        bool section_loaded;
+    };
+    struct KeyHash {
+        ulong operator()(std::pair<long, long> const& key) const {
+            return static_cast<ulong>(key.first) * 0x9E3779B97F4A7C15ul ^
+                   static_cast<ulong>(key.second);
+        }
+    };
+
+    int fd = -1;
+    char* data = nullptr;
+    ulong capacity = 0;
+    ulong end = 0;      // where the next record goes
+    ulong garbage = 0;  // bytes of paged in records before end
+    std::unordered_map<std::pair<long, long>, Record, KeyHash> records;
+    ChunkPagerStats stats;
+
+    bool reserve(ulong bytes);
+    void compact();
+    static void decode(char const* record, Chunk& chunk);
+
+   public:
+    explicit ChunkPager(std::string const& path);
+    ~ChunkPager();
+    ChunkPager(ChunkPager const&) = delete;
+    ChunkPager& operator=(ChunkPager const&) = delete;
+
+    bool is_open() const { return data != nullptr; }
+    // Writes the chunk to the file - false if the file could not grow
+    bool page_out(Chunk const& chunk);
+    // Reads the chunk at the aligned (x, y) into chunk and drops its record.
+    // False if it is not paged.
+    bool page_in(long x, long y, Chunk& chunk);
+    // Copies the chunk at the aligned (x, y) into chunk and keeps it paged
+    bool read(long x, long y, Chunk& chunk) const;
+    // The tile at (x, y) of a paged chunk - false if it is not paged
+    bool read_tile(long x, long y, TileSnapshot& tile) const;
+    bool contains(long x, long y) const;
+    bool section_loaded(long x, long y) const;
+
+    // Calls fn(chunk) with a copy of every paged chunk
+    template <class Fn>
+    void for_each(Fn const& fn) const {
+        Chunk chunk;
+        for(auto const& [key, record] : records) {
+            decode(data + record.offset, chunk);
+            fn(chunk);
+        }
+    }
+
+    ChunkPagerStats get_stats() const;
+};
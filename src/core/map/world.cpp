@@ -3,17 +3,22 @@
 #include <algorithm>
 #include <climits>
 #include <cstdint>
+#include <filesystem>
 #include <libtcod/mersenne.hpp>
+#include <unistd.h>
 
 #include "app/globals.hpp"
 #include "entity/ant.hpp"
 #include "entity/inventory.hpp"
 #include "map.pb.h"
+#include "map/baked_world.hpp"
 #include "map/builder.hpp"
+#include "map/generator.hpp"
 #include "map/section_data.hpp"
 #include "map/window.hpp"
+#include "map/zone_grid.hpp"
 
-Level::Level(const Map& map, ulong depth) : map(map), depth(depth) {}
+Level::Level(Map map, ulong depth) : map(std::move(map)), depth(depth) {}
 
 Level::Level(const ant_proto::Level& msg, const ulong& instr_clock,
              const ItemInfoMap& item_map,
@@ -29,12 +34,14 @@ Level::Level(const ant_proto::Level& msg, const ulong& instr_clock,
     for(const auto& building_msg : msg.buildings()) add_building(building_msg);
 }
 
-ant_proto::Level Level::get_proto() const {
+ant_proto::Level Level::get_proto(
+    ThreadPool<AsyncProgramJob>* loop_pool) const {
     ant_proto::Level msg;
     for(const auto worker : workers) *msg.add_workers() = worker->get_proto();
     for(const auto building : buildings)
         *msg.add_buildings() = building->get_proto();
-    *msg.mutable_map() = map.get_proto();
+    *msg.mutable_map() =
+        loop_pool != nullptr ? map.get_proto(*loop_pool) : map.get_proto();
 
     return msg;
 }
@@ -59,33 +66,53 @@ void Level::add_building(const ant_proto::Building& building) {
     }
 }
 
+void Section_Plan::build_section(Level& l) {
+    MapSectionData section(border);
+    TCODRandom rng(seed);
+    _generate_section(section, rng);
+    _load_section(l, *this, section);
+}
+
 Zone::Zone(ulong w, ulong h, ulong depth,
-           std::function<void(Level&, Section_Plan&)> build_section)
-    : w(w), h(h), depth(depth), build_section(build_section) {}
+           Section_Plan::generatef_t generate_section,
+           Section_Plan::loadf_t load_section)
+    : w(w),
+      h(h),
+      depth(depth),
+      generate_section(generate_section),
+      load_section(load_section) {}
 
 Peaceful_Cavern::Peaceful_Cavern()
     : Zone((globals::MIN_SECTION_LENGTH * 2) / globals::CHUNK_LENGTH,
            (globals::MIN_SECTION_LENGTH * 2) / globals::CHUNK_LENGTH,
-           globals::MAX_LEVEL_DEPTH, build_section) {}
+           globals::MAX_LEVEL_DEPTH, generate_section, load_section) {}
+
+void Peaceful_Cavern::generate_section(MapSectionData& section,
+                                       TCODRandom& rng) {
+    RandomMapBuilder(Rect(section.border), &rng)(section);
+}
 
-void Peaceful_Cavern::build_section(Level& l, Section_Plan& sp) {
-    MapSectionData section(sp.border);
-    RandomMapBuilder(Rect(sp.border))(section);
+void Peaceful_Cavern::load_section(Level& l, Section_Plan&,
+                                   MapSectionData const& section) {
     l.map.load_section(section);
 }
 
 Starting_Colony::Starting_Colony()
     : Zone{(globals::MIN_SECTION_LENGTH * 2) / globals::CHUNK_LENGTH,
            (globals::MIN_SECTION_LENGTH * 2) / globals::CHUNK_LENGTH,
-           globals::MAX_LEVEL_DEPTH, build_section} {}
+           globals::MAX_LEVEL_DEPTH, generate_section, load_section} {}
 
-void Starting_Colony::build_section(Level& l, Section_Plan& sp) {
-    MapSectionData section(sp.border);
-    EmptyMapBuilder(Rect(sp.border))(section);
+void Starting_Colony::generate_section(MapSectionData& section,
+                                       TCODRandom&) {
+    EmptyMapBuilder(Rect(section.border))(section);
+}
+
+void Starting_Colony::load_section(Level& l, Section_Plan& sp,
+                                   MapSectionData const& section) {
     l.map.load_section(section);
     if(sp.depth_in_zone == 0 &&
        l.depth == 0) {  // we know that zone takes up entire depth
-        Rect& first_room = section.rooms[0];
+        Rect const& first_room = section.rooms[0];
         int center_x = first_room.center_x;
         int center_y = first_room.center_y;
         l.add_building(Nursery(center_x - 1, center_y - 1, 0));
@@ -111,35 +138,6 @@ class World_BspListener : public ITCODBspCallback {
     }
 };
 
-bool Region::can_place_zone(chunk_assignments_t& chunk_assignemnts, long x,
-                            long y, long z, Zone& zone) {
-    if(z < 0 || x < 0 || y < 0) return false;
-    if(z + static_cast<long>(zone.depth) > globals::MAX_LEVEL_DEPTH)
-        return false;
-    for(ulong i = x; i < x + zone.w; ++i) {
-        for(ulong j = y; j < y + zone.h; ++j) {
-            for(ulong k = z; k < z + zone.depth; ++k) {
-                if(chunk_assignemnts[i][j][k] != nullptr) return false;
-            }
-        }
-    }
-    return true;
-}
-
-void Region::place_zone(chunk_assignments_t& chunk_assignments, long x, long y,
-                        long z, Zone& zone) {
-    if(z < 0 || x < 0 || y < 0) return;
-    if(z + static_cast<long>(zone.depth) > globals::MAX_LEVEL_DEPTH)
-        return;
-    for(ulong i = x; i < x + zone.w; ++i) {
-        for(ulong j = y; j < y + zone.h; ++j) {
-            for(ulong k = z; k < z + zone.depth; ++k) {
-                chunk_assignments[i][j][k] = &zone;
-            }
-        }
-    }
-}
-
 class shuffle_randomizer {
     TCODRandom& r;
 
@@ -151,58 +149,37 @@ class shuffle_randomizer {
     result_type operator()() { return r.getInt(min(), max()); }
 };
 
-void Region::do_blueprint_planning() {
-    // randomly partition world into smaller columns.
-    // These columns will then be sliced into
-    // section plans to go into the blueprints for each level
-
-    long xy_length = globals::WORLD_LENGTH / globals::CHUNK_LENGTH;
-    chunk_assignments_t chunk_assignments(
-        xy_length,
-        std::vector<std::vector<Zone*>>(
-            xy_length, std::vector<Zone*>(globals::MAX_LEVEL_DEPTH, 0)));
-
-    struct placed_zones_t {
-        long chunk_x;
-        long chunk_y;
-        long chunk_z;
-        Zone* zone;
-    };
-    std::vector<placed_zones_t> placed_zones;
-
-    if(is_first_region) {
-        Zone* starting_coloney = new Starting_Colony();
-        place_zone(chunk_assignments, 0, 0, 0, *starting_coloney);
-        placed_zones.emplace_back(placed_zones_t{0, 0, 0, starting_coloney});
+void Region::place_zones(ZoneGrid& grid, std::vector<Zone*>& shapes,
+                         TCODRandom& randomizer,
+                         std::vector<Zone_Placement>& placed_zones) {
+    // Zones are only ever added, so the first x a shape fits at on a level
+    // only grows - the search of the shape on the level starts there
+    std::unordered_map<Zone const*, std::vector<ulong>> first_x;
+    for(Zone const* shape : shapes) {
+        first_x[shape].assign(grid.get_depth(), 0);
     }
-
-    std::vector<Zone*> shapes = {new Peaceful_Cavern()};
-    std::shuffle(shapes.begin(), shapes.end(), shuffle_randomizer(randomizer));
-
     uint failed_attempts = 0;
     while(failed_attempts < 10) {
         bool successful_attempt = false;
         for(const auto& shape : shapes) {
             bool placed = false;
-            long shape_width = shape->w;
-            long shape_height = shape->h;
-            for(long z = 0;
-                z + static_cast<long>(shape->depth) <= globals::MAX_LEVEL_DEPTH;
-                ++z) {
-                for(long x = 0; x <= xy_length - shape_width; ++x) {
-                    for(long y = 0; y <= xy_length - shape_height; ++y) {
-                        if(can_place_zone(chunk_assignments, x, y, z, *shape)) {
-                            place_zone(chunk_assignments, x, y, z, *shape);
-                            placed_zones.emplace_back(
-                                placed_zones_t{x, y, z, shape});
-                            placed = true;
-                            break;
-                        }
-                    }
-                    if(placed) {
-                        break;
-                    }
+            std::vector<ulong>& shape_first_x = first_x[shape];
+            for(ulong z = 0; z + shape->depth <= grid.get_depth(); ++z) {
+                // once the shape is placed only the first column of the
+                // deeper levels is looked at
+                ulong const x_end = placed ? 1 : grid.get_length();
+                ulong x = 0, y = 0;
+                if(!grid.find_first(z, shape->w, shape->h, shape->depth,
+                                    shape_first_x[z], x_end, x, y)) {
+                    if(!placed) shape_first_x[z] = grid.get_length();
+                    continue;
                 }
+                shape_first_x[z] = x;
+                grid.place(x, y, z, shape->w, shape->h, shape->depth);
+                placed_zones.emplace_back(
+                    Zone_Placement{static_cast<long>(x), static_cast<long>(y),
+                                   static_cast<long>(z), shape});
+                placed = true;
             }
             if(placed) successful_attempt = true;
         }
@@ -210,10 +187,31 @@ void Region::do_blueprint_planning() {
         std::shuffle(shapes.begin(), shapes.end(),
                      shuffle_randomizer(randomizer));
     }
+}
+
+void Region::do_blueprint_planning() {
+    // randomly partition world into smaller columns.
+    // These columns will then be sliced into
+    // section plans to go into the blueprints for each level
+
+    ZoneGrid grid(globals::WORLD_LENGTH / globals::CHUNK_LENGTH,
+                  globals::MAX_LEVEL_DEPTH);
+    std::vector<Zone_Placement> placed_zones;
+
+    if(is_first_region) {
+        Zone* starting_coloney = new Starting_Colony();
+        grid.place(0, 0, 0, starting_coloney->w, starting_coloney->h,
+                   starting_coloney->depth);
+        placed_zones.emplace_back(Zone_Placement{0, 0, 0, starting_coloney});
+    }
+
+    std::vector<Zone*> shapes = {new Peaceful_Cavern()};
+    std::shuffle(shapes.begin(), shapes.end(), shuffle_randomizer(randomizer));
+    place_zones(grid, shapes, randomizer, placed_zones);
 
     // Plan out the sections in each level
     std::sort(placed_zones.begin(), placed_zones.end(),
-              [](placed_zones_t lhs, placed_zones_t rhs) {
+              [](Zone_Placement lhs, Zone_Placement rhs) {
                   if(lhs.chunk_x < rhs.chunk_x)
                       return true;
                   else if(lhs.chunk_x > rhs.chunk_x)
@@ -240,20 +238,73 @@ void Region::do_blueprint_planning() {
     for(const auto& zone_placement : placed_zones) {
         for(ulong z = zone_placement.chunk_z;
             z < zone_placement.chunk_z + zone_placement.zone->depth; ++z) {
+            long const x =
+                perimeter.x1 + (zone_placement.chunk_x * globals::CHUNK_LENGTH);
+            long const y =
+                perimeter.y1 + (zone_placement.chunk_y * globals::CHUNK_LENGTH);
             section_plans[z].emplace_back(
-                Rect(perimeter.x1 +
-                         (zone_placement.chunk_x * globals::CHUNK_LENGTH),
-                     perimeter.y1 +
-                         (zone_placement.chunk_y * globals::CHUNK_LENGTH),
-                     zone_placement.zone->w * globals::CHUNK_LENGTH,
+                Rect(x, y, zone_placement.zone->w * globals::CHUNK_LENGTH,
                      zone_placement.zone->h * globals::CHUNK_LENGTH),
-                z - zone_placement.chunk_z, zone_placement.zone->build_section);
+                z - zone_placement.chunk_z,
+                section_seed(x, y, static_cast<long>(z)),
+                zone_placement.zone->generate_section,
+                zone_placement.zone->load_section);
+        }
+    }
+    index_section_plans();
+}
+
+void Region::index_section_plans() {
+    long const xy_length = globals::WORLD_LENGTH / globals::CHUNK_LENGTH;
+    plan_grid.assign(section_plans.size() * xy_length * xy_length, NO_PLAN);
+    for(ulong z = 0; z < section_plans.size(); ++z) {
+        ushort* level_grid = plan_grid.data() + z * xy_length * xy_length;
+        for(ulong idx = 0; idx < section_plans[z].size(); ++idx) {
+            Rect const& border = section_plans[z][idx].border;
+            long const x1 = (border.x1 - perimeter.x1) / globals::CHUNK_LENGTH;
+            long const y1 = (border.y1 - perimeter.y1) / globals::CHUNK_LENGTH;
+            long const x2 = (border.x2 - perimeter.x1) / globals::CHUNK_LENGTH;
+            long const y2 = (border.y2 - perimeter.y1) / globals::CHUNK_LENGTH;
+            for(long x = x1; x <= x2; ++x) {
+                for(long y = y1; y <= y2; ++y) {
+                    level_grid[x * xy_length + y] = static_cast<ushort>(idx);
+                }
+            }
         }
     }
 }
 
+Section_Plan* Region::section_plan(long x, long y, long z) {
+    if(z < 0 || static_cast<size_t>(z) >= section_plans.size()) return nullptr;
+    if(!perimeter.is_inside(x, y) || plan_grid.empty()) return nullptr;
+    long const xy_length = globals::WORLD_LENGTH / globals::CHUNK_LENGTH;
+    long const chunk_x = (x - perimeter.x1) / globals::CHUNK_LENGTH;
+    long const chunk_y = (y - perimeter.y1) / globals::CHUNK_LENGTH;
+    ushort const idx =
+        plan_grid[(z * xy_length + chunk_x) * xy_length + chunk_y];
+    if(idx == NO_PLAN) return nullptr;
+    return &section_plans[z][idx];
+}
+
 uint32_t Region::get_seed() { return seed_x ^ seed_y; }
 
+uint32_t Region::section_seed(long x, long y, long z) const {
+    // splitmix64 steps over the region seeds and the position - every input
+    // bit reaches every output bit, so neighbouring sections get unrelated
+    // streams
+    auto mix = [](ulong state, ulong value) {
+        state += value + 0x9E3779B97F4A7C15ul;
+        state = (state ^ state >> 30) * 0xBF58476D1CE4E5B9ul;
+        state = (state ^ state >> 27) * 0x94D049BB133111EBul;
+        return state ^ state >> 31;
+    };
+    ulong state = mix(0, static_cast<ulong>(seed_x) << 32 | seed_y);
+    state = mix(state, static_cast<ulong>(x));
+    state = mix(state, static_cast<ulong>(y));
+    state = mix(state, static_cast<ulong>(z));
+    return static_cast<uint32_t>(state >> 32);
+}
+
 Region::Region(const Rect& perimeter)
     : perimeter(perimeter), is_first_region(true) {
     // NO Seeds provided so generate them
@@ -287,10 +338,69 @@ ant_proto::Region Region::get_proto() {
     return msg;
 }
 
+Region* Regions::find(long x, long y) {
+    Region_Key const key = Region_Key::of_tile(x, y);
+    if(last_region != nullptr && key == last_key) return last_region;
+
+    auto find_itr = rmap.find(key);
+    if(find_itr == rmap.end()) return nullptr;
+    last_key = key;
+    last_region = &find_itr->second;
+    return last_region;
+}
+
+Region Regions::plan(Region_Key key, uint32_t origin_seed_x,
+                     uint32_t origin_seed_y) {
+    long snap_x = key.x * globals::WORLD_LENGTH;
+    long snap_y = key.y * globals::WORLD_LENGTH;
+    auto new_seed_x = origin_seed_x + snap_x;
+    auto new_seed_y = origin_seed_y + snap_y;
+    return Region(new_seed_x, new_seed_y,
+                  Rect(snap_x, snap_y, globals::WORLD_LENGTH,
+                       globals::WORLD_LENGTH));
+}
+
+Region& Regions::add(Region_Key key, Region&& region) {
+    return rmap.try_emplace(key, std::move(region)).first->second;
+}
+
+Region& Regions::region(long x, long y) {
+    Region* found = find(x, y);
+    if(found != nullptr) return *found;
+    auto origin_itr = rmap.find({0, 0});
+    if(origin_itr == rmap.end()) {
+        SPDLOG_ERROR(
+            "Regions::region missing origin region; aborting. x={}, y={}.", x,
+            y);
+        std::abort();
+    }
+    Region_Key const key = Region_Key::of_tile(x, y);
+    last_key = key;
+    last_region = &add(key, plan(key, origin_itr->second.seed_x,
+                                 origin_itr->second.seed_y));
+    return *last_region;
+}
+
+void Regions::build_section(long x, long y, Level& l) {
+    Region& region = this->region(x, y);
+    Section_Plan* search_sp = region.section_plan(x, y, l.depth);
+    if(!search_sp) {
+        SPDLOG_ERROR(
+            "Regions::build_section missing Section_Plan; aborting. x={}, y={}, depth={}, region=({}, {}).",
+            x, y, l.depth, region.perimeter.x1, region.perimeter.y1);
+        std::abort();
+    }
+    if(search_sp->in_construction) return;
+    if(l.map.chunk_built(x, y)) return;
+    search_sp->in_construction = true;
+    search_sp->build_section(l);
+}
+
 struct Generate_Chunk_Callback {
     ulong depth;
     MapWorld& w;
     void operator()(long x, long y) {
+        if(w.load_baked_chunk(depth, x, y)) return;
         w.regions.build_section(x, y, w.levels[depth]);
     }
 };
@@ -312,6 +422,20 @@ MapWorld::MapWorld(const Rect& border, bool is_walls_enabled, uint32_t seed_x,
             Level(Map(is_walls_enabled, Generate_Chunk_Callback{i, *this}), i));
 }
 
+MapWorld::MapWorld(const Rect& border, bool is_walls_enabled,
+                   std::unique_ptr<BakedWorld> baked)
+    : levels{},
+      regions(baked ? Regions(baked->get_spec().seed_x,
+                              baked->get_spec().seed_y)
+                    : Regions()),
+      map_window(border),
+      baked(std::move(baked)) {
+    // Ensure that levels are created
+    for(size_t i = 0; i < globals::MAX_LEVEL_DEPTH; ++i)
+        levels.emplace_back(
+            Level(Map(is_walls_enabled, Generate_Chunk_Callback{i, *this}), i));
+}
+
 MapWorld::MapWorld(const ant_proto::MapWorld& msg,
                    ThreadPool<AsyncProgramJob>& thread_pool,
                    bool is_walls_enabled)
@@ -330,13 +454,16 @@ MapWorld::MapWorld(const ant_proto::MapWorld& msg,
     }
 }
 
+MapWorld::~MapWorld() = default;
+
 Level& MapWorld::current_level() { return levels[current_depth]; }
 
 Level& MapWorld::operator[](ulong depth) { return levels[depth]; }
 
 ant_proto::MapWorld MapWorld::get_proto() const {
     ant_proto::MapWorld msg;
-    for(const auto& level : levels) *msg.add_levels() = level.get_proto();
+    for(const auto& level : levels)
+        *msg.add_levels() = level.get_proto(loop_pool);
     msg.set_current_depth(current_depth);
     *msg.mutable_map_window() = map_window.get_proto();
 
@@ -351,3 +478,89 @@ bool MapWorld::get_origin_region_seeds(uint32_t& seed_x,
     seed_y = it->second.seed_y;
     return true;
 }
+
+void MapWorld::enable_paging(ulong budget) {
+    chunk_memory_budget = budget;
+    std::string const prefix = "ants_" + std::to_string(getpid()) + "_level_";
+    for(Level& level : levels) {
+        std::filesystem::path const path =
+            std::filesystem::temp_directory_path() /
+            (prefix + std::to_string(level.depth) + ".pages");
+        level.map.enable_paging(path.string());
+    }
+}
+
+void MapWorld::page_out_cold_chunks() {
+    if(chunk_memory_budget == 0) return;
+    ulong const max_resident = chunk_memory_budget / sizeof(Chunk);
+    ulong resident = 0;
+    for(Level const& level : levels) resident += level.map.num_resident_chunks();
+
+    if(resident > max_resident) {
+        struct ColdChunk {
+            uint last_access;
+            ulong depth;
+            Chunk* chunk;
+        };
+        std::vector<ColdChunk> cold;
+        for(Level& level : levels) {
+            level.map.for_each_cold_chunk([&](Chunk& chunk) {
+                cold.push_back({chunk.last_access, level.depth, &chunk});
+            });
+        }
+        ulong const num_out = std::min(resident - max_resident, cold.size());
+        std::nth_element(cold.begin(), cold.begin() + num_out, cold.end(),
+                         [](ColdChunk const& lhs, ColdChunk const& rhs) {
+                             return lhs.last_access < rhs.last_access;
+                         });
+        std::vector<std::vector<Chunk*>> out(levels.size());
+        for(ulong idx = 0; idx < num_out; ++idx) {
+            out[cold[idx].depth].push_back(cold[idx].chunk);
+        }
+        for(ulong depth = 0; depth < levels.size(); ++depth) {
+            levels[depth].map.page_out(std::move(out[depth]));
+        }
+    }
+    for(Level& level : levels) level.map.advance_access_clock();
+}
+
+ChunkPagerStats MapWorld::paging_stats() const {
+    ChunkPagerStats total;
+    for(Level const& level : levels) {
+        ChunkPager const* pager = level.map.get_pager();
+        if(pager == nullptr) continue;
+        ChunkPagerStats const stats = pager->get_stats();
+        total.page_ins += stats.page_ins;
+        total.page_outs += stats.page_outs;
+        total.num_paged += stats.num_paged;
+        total.file_bytes += stats.file_bytes;
+    }
+    return total;
+}
+
+bool MapWorld::load_baked_chunk(ulong depth, long x, long y) {
+    ulong is_wall_bits = 0;
+    if(!baked || !baked->find(depth, x, y, is_wall_bits)) return false;
+    levels[depth].map.load_baked_chunk(x, y, is_wall_bits);
+    return true;
+}
+
+bool MapWorld::is_baked(ulong depth, long x, long y) const {
+    return baked && baked->contains(depth, x, y);
+}
+
+void MapWorld::enable_background_generation() {
+    generator = std::make_unique<SectionGenerator>();
+}
+
+void MapWorld::queue_sections_ahead() {
+    if(generator) generator->queue_ahead(*this);
+}
+
+void MapWorld::add_generation_tasks(TaskGraph& graph) {
+    if(generator) generator->add_tasks(graph);
+}
+
+void MapWorld::load_generated_sections() {
+    if(generator) generator->load(*this);
+}
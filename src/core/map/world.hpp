@@ -11,6 +11,8 @@
 #include "hardware/program_executor.hpp"
 #include "map.pb.h"
 #include "map/map.hpp"
+#include "map/pager.hpp"
+#include "map/section_data.hpp"
 #include "map/window.hpp"
 #include "utils/math.hpp"
 #include "utils/thread_pool.hpp"
@@ -19,20 +21,40 @@ struct Worker;
 struct Building;
 class ItemInfoMap;
 struct Level;
+class BakedWorld;
+class SectionGenerator;
+struct SectionGeneratorStats;
+class TaskGraph;
+class ZoneGrid;
 
 struct Section_Plan {
-    using buildf_t = std::function<void(Level&, Section_Plan&)>;
+    // Fills in the rooms and corridors of a section. It touches nothing but
+    // its arguments, so it may run on any thread.
+    using generatef_t = std::function<void(MapSectionData&, TCODRandom&)>;
+    // Puts a generated section into the level
+    using loadf_t =
+        std::function<void(Level&, Section_Plan&, MapSectionData const&)>;
     Rect border;
     ulong depth_in_zone;
     bool in_construction;
-    Section_Plan(const Rect& border, ulong depth_in_zone,
-                 buildf_t _build_section)
+    // Queued for background generation - see SectionGenerator
+    bool is_queued = false;
+    // Seeds the rng the section is generated with - derived from the region
+    // seeds and where the section is, see Region::section_seed, so the
+    // section comes out the same whenever and on whichever thread it is
+    // built
+    uint32_t seed;
+    Section_Plan(const Rect& border, ulong depth_in_zone, uint32_t seed,
+                 generatef_t _generate_section, loadf_t _load_section)
         : border(border),
           depth_in_zone(depth_in_zone),
           in_construction(false),
-          _build_section(_build_section) {}
-    buildf_t _build_section;
-    void build_section(Level& l) { _build_section(l, *this); }
+          seed(seed),
+          _generate_section(_generate_section),
+          _load_section(_load_section) {}
+    generatef_t _generate_section;
+    loadf_t _load_section;
+    void build_section(Level& l);
 };
 
 struct Start_Data {
@@ -49,12 +71,13 @@ struct Level {
     Map map;
     ulong depth;
 
-    Level(const Map& map, ulong depth);
+    Level(Map map, ulong depth);
     Level(const ant_proto::Level& msg, const ulong& instr_clock,
           const ItemInfoMap& item_map, ThreadPool<AsyncProgramJob>& thread_pool,
           bool is_walls_enabled, f_xy_t pre_chunk_generation_callback);
 
-    ant_proto::Level get_proto() const;
+    ant_proto::Level get_proto(
+        ThreadPool<AsyncProgramJob>* loop_pool = nullptr) const;
 
     void add_building(const Building& building);
     void add_building(const ant_proto::Building& building);
@@ -64,9 +87,11 @@ struct Zone {
     ulong w;
     ulong h;
     ulong depth;
-    std::function<void(Level&, Section_Plan&)> build_section;
+    Section_Plan::generatef_t generate_section;
+    Section_Plan::loadf_t load_section;
     Zone(ulong w, ulong h, ulong depth,
-         std::function<void(Level&, Section_Plan&)> build_section);
+         Section_Plan::generatef_t generate_section,
+         Section_Plan::loadf_t load_section);
 
     virtual ~Zone() {}
 };
@@ -74,23 +99,36 @@ struct Zone {
 struct Peaceful_Cavern : public Zone {
     Peaceful_Cavern();
     ~Peaceful_Cavern() {}
-    static void build_section(Level&, Section_Plan&);
+    static void generate_section(MapSectionData&, TCODRandom&);
+    static void load_section(Level&, Section_Plan&, MapSectionData const&);
 };
 
 struct Starting_Colony : public Zone {
     Starting_Colony();
     ~Starting_Colony() {}
-    static void build_section(Level&, Section_Plan&);
+    static void generate_section(MapSectionData&, TCODRandom&);
+    static void load_section(Level&, Section_Plan&, MapSectionData const&);
+};
+
+// A zone placed in a region, in chunks from the region's corner
+struct Zone_Placement {
+    long chunk_x;
+    long chunk_y;
+    long chunk_z;
+    Zone* zone;
 };
 
 struct Region {
-    using chunk_assignments_t = std::vector<std::vector<std::vector<Zone*>>>;
     uint32_t seed_x;
     uint32_t seed_y;
     Rect perimeter;
     TCODRandom randomizer;
     bool is_first_region;
     std::vector<std::vector<Section_Plan>> section_plans = {};
+    // Index into section_plans[z] of the plan of every chunk of the region,
+    // level by level and column by column - NO_PLAN where there is none
+    std::vector<ushort> plan_grid = {};
+    static constexpr ushort NO_PLAN = 0xFFFF;
 
     Region() = delete;
     Region(const Rect& perimeter);
@@ -98,122 +136,71 @@ struct Region {
     Region(const ant_proto::Region& msg);
     ant_proto::Region get_proto();
 
-    // Section_Plan& section_plan(long x, long y) {
-    Section_Plan* section_plan(long x, long y, long z) {
-        if(z < 0 || static_cast<size_t>(z) >= section_plans.size()) return nullptr;
-        std::vector<Section_Plan>& level_sp = section_plans[z];
-
-        // auto search_sp = std::lower_bound(level_sp.begin(), level_sp.end(),
-        // Section_Plan(Rect(x,y, 1, 1), 0, [](Level&, Section_Plan&){}),
-        //     [](const Section_Plan& l, const Section_Plan& r) {
-        //         std::cout << "DEBUG: " << l.border.x1 << "  " << l.border.y1
-        //         << " : " << r.border.x1 << "  " << r.border.y1; if(
-        //         l.border.x1 < r.border.x1 ) { std::cout << " t" << std::endl;
-        //         return true; } if( l.border.x1 > r.border.x1 ) { std::cout <<
-        //         " f" << std::endl; return false; } if( l.border.y1 <
-        //         r.border.y1 ) { std::cout << " t" << std::endl; return true;
-        //         } std::cout << " f" << std::endl; return false;
-        //     }
-        // );
-        //
-        // if( search_sp == level_sp.end() ) return nullptr;
-        // ++search_sp;  // we want the seaerch that likely contains our x,y
-        // coordinates
-        // // if( search_sp == level_sp.end() ) return nullptr;
-        //
-        // if(! (x >= search_sp->border.x1 && x <= search_sp->border.x2) )
-        // return nullptr; if(! (y >= search_sp->border.y1 && y <=
-        // search_sp->border.y2) ) return nullptr; return &*search_sp;
-
-        // linear search for now, if a performance issue then use binary search
-        // like ^ but without the bugs
-        for(auto& scan_sp : level_sp) {
-            if(scan_sp.border.x1 <= x && scan_sp.border.x2 >= x &&
-               scan_sp.border.y1 <= y && scan_sp.border.y2 >= y)
-                return &scan_sp;
-        }
-        return nullptr;
-    }
-
+    // The plan of the section (x, y) is in on level z, nullptr if there is
+    // none - a look up in plan_grid
+    Section_Plan* section_plan(long x, long y, long z);
     uint32_t get_seed();
-    bool can_place_zone(chunk_assignments_t& chunk_assignemnts, long x, long y,
-                        long z, Zone& zone);
-    void place_zone(chunk_assignments_t& chunk_assignemnts, long x, long y,
-                    long z, Zone& zone);
+    // The seed of the section with top left corner (x, y) on level z - a
+    // hash of the region seeds and the position, independent of the other
+    // sections and of the order they are built in
+    uint32_t section_seed(long x, long y, long z) const;
+    // Places the shapes in grid a turn at a time - every shape of a turn at
+    // its first free spot, the shapes shuffled with randomizer after every
+    // turn - until ten turns placed nothing
+    static void place_zones(ZoneGrid& grid, std::vector<Zone*>& shapes,
+                            TCODRandom& randomizer,
+                            std::vector<Zone_Placement>& placed_zones);
     void do_blueprint_planning();
+    void index_section_plans();
 };
 
+// A region by its position in regions, not tiles - (x, y) of the region
+// with perimeter x1 = x * WORLD_LENGTH, y1 = y * WORLD_LENGTH
 struct Region_Key {
     long x;
     long y;
-    bool operator==(const Region_Key& rhs) {
-        return div_floor(x, globals::WORLD_LENGTH) <
-                   div_floor(rhs.x, globals::WORLD_LENGTH) &&
-               div_floor(y, globals::WORLD_LENGTH) <
-                   div_floor(rhs.y, globals::WORLD_LENGTH);
+    bool operator==(const Region_Key& rhs) const {
+        return x == rhs.x && y == rhs.y;
+    }
+    static Region_Key of_tile(long x, long y) {
+        return {div_floor(x, globals::WORLD_LENGTH),
+                div_floor(y, globals::WORLD_LENGTH)};
     }
 };
 
-namespace std {
-    template <>
-    struct hash<Region_Key> {
-        size_t operator()(const Region_Key& k) const {
-            return std::hash<long>()(div_floor(k.x, globals::WORLD_LENGTH)) ^
-                   std::hash<long>()(div_floor(k.y, globals::WORLD_LENGTH));
-        }
-    };
-
-    template <>
-    struct equal_to<Region_Key> {
-        bool operator()(const Region_Key& lhs, const Region_Key& rhs) const {
-            return div_floor(lhs.x, globals::WORLD_LENGTH) ==
-                       div_floor(rhs.x, globals::WORLD_LENGTH) &&
-                   div_floor(lhs.y, globals::WORLD_LENGTH) ==
-                       div_floor(rhs.y, globals::WORLD_LENGTH);
-        }
-    };
-}  // namespace std
+struct Region_Key_Hash {
+    size_t operator()(const Region_Key& k) const {
+        // mixes both coordinates so rows, columns and diagonals spread out
+        ulong hash = static_cast<ulong>(k.x) * 0x9E3779B97F4A7C15ul ^
+                     static_cast<ulong>(k.y);
+        return hash ^ hash >> 29;
+    }
+};
 
 struct Regions {
     long align_to_region(long pos) {
         return div_floor(pos, globals::WORLD_LENGTH) * globals::WORLD_LENGTH;
     }
-    std::unordered_map<Region_Key, Region> rmap;
-    void build_section(long x, long y, Level& l) {
-        auto find_itr = rmap.find({x, y});
-        if(find_itr == rmap.end()) {
-            long snap_x = align_to_region(x);
-            long snap_y = align_to_region(y);
-            auto origin_itr = rmap.find({0, 0});
-            if(origin_itr == rmap.end()) {
-                SPDLOG_ERROR(
-                    "Regions::build_section missing origin region; aborting. x={}, y={}, depth={}.",
-                    x, y, l.depth);
-                std::abort();
-            }
-            auto new_seed_x = origin_itr->second.seed_x + snap_x;
-            auto new_seed_y = origin_itr->second.seed_y + snap_y;
-            find_itr =
-                rmap.emplace(Region_Key{x, y},
-                             Region(new_seed_x, new_seed_y,
-                                    Rect(snap_x, snap_y, globals::WORLD_LENGTH,
-                                         globals::WORLD_LENGTH)))
-                    .first;
-        }
-
-        Section_Plan* search_sp = find_itr->second.section_plan(x, y, l.depth);
-        if(!search_sp) {
-            SPDLOG_ERROR(
-                "Regions::build_section missing Section_Plan; aborting. x={}, y={}, depth={}, region=({}, {}).",
-                x, y, l.depth, find_itr->second.perimeter.x1,
-                find_itr->second.perimeter.y1);
-            std::abort();
-        }
-        if(search_sp->in_construction) return;
-        if(l.map.chunk_built(x, y)) return;
-        search_sp->in_construction = true;
-        search_sp->build_section(l);
+    std::unordered_map<Region_Key, Region, Region_Key_Hash> rmap;
+
+    // The region (x, y) is in, planned the first time it is used
+    Region& region(long x, long y);
+    // The region (x, y) is in, nullptr if it is not planned yet
+    Region* find(long x, long y);
+    // The region at key, seeded from the origin region's seeds. Planning
+    // touches nothing but the new region, so it may run on any thread - see
+    // SectionGenerator.
+    static Region plan(Region_Key key, uint32_t origin_seed_x,
+                       uint32_t origin_seed_y);
+    // Adds a region planned with plan - the one in rmap if it got there
+    // first, which is the same
+    Region& add(Region_Key key, Region&& region);
+    // The plan of the section (x, y) is in on level z - see
+    // Region::section_plan
+    Section_Plan* section_plan(long x, long y, long z) {
+        return region(x, y).section_plan(x, y, z);
     }
+    void build_section(long x, long y, Level& l);
 
     Regions() : rmap() {
         rmap.emplace(Region_Key{0, 0},
@@ -227,6 +214,12 @@ struct Regions {
                             Rect(0, 0, globals::WORLD_LENGTH,
                                  globals::WORLD_LENGTH)));
     }
+
+   private:
+    // The region of the last look up - build_section runs for the chunks of
+    // a view at a time, which are mostly in one region
+    Region* last_region = nullptr;
+    Region_Key last_key = {0, 0};
 };
 
 class MapWorld {
@@ -237,17 +230,59 @@ class MapWorld {
     ulong current_depth = 0;
     ItemInfoMap item_info_map = {};
     ulong instr_action_clock = 0;
+    // Runs the chunk loops of the maps on the pool when set - see
+    // ProjectArguments::is_parallel_loops
+    ThreadPool<AsyncProgramJob>* loop_pool = nullptr;
+    // Bytes of resident chunks of all levels kept by page_out_cold_chunks -
+    // 0 keeps every chunk resident. See enable_paging.
+    ulong chunk_memory_budget = 0;
 
     MapWorld(const Rect& border,
              bool is_walls_enabled);  // guaranteed first world
     MapWorld(const Rect& border, bool is_walls_enabled, uint32_t seed_x,
              uint32_t seed_y);
+    // The world baked - seeded with its seeds, the baked chunks loaded from
+    // it instead of generated. Without one it is the first constructor's.
+    MapWorld(const Rect& border, bool is_walls_enabled,
+             std::unique_ptr<BakedWorld> baked);
     MapWorld(const ant_proto::MapWorld& msg,
              ThreadPool<AsyncProgramJob>& thread_pool, bool is_walls_enabled);
+    ~MapWorld();
     ant_proto::MapWorld get_proto() const;
 
     bool get_origin_region_seeds(uint32_t& seed_x, uint32_t& seed_y) const;
 
+    // Gives each level a page file in the temp directory and keeps the
+    // resident chunks within budget bytes from now on
+    void enable_paging(ulong budget);
+    // Pages the least recently used chunks of all levels out until the
+    // resident ones fit the budget. Invalidates all chunk pointers, so it
+    // runs between frames.
+    void page_out_cold_chunks();
+    ChunkPagerStats paging_stats() const;
+
+    // Generates the sections ahead of the player and the ants from now on -
+    // see SectionGenerator
+    void enable_background_generation();
+    // Queues the unbuilt sections around the map window and the ants
+    void queue_sections_ahead();
+    // Adds the tasks generating queued sections to the frame
+    void add_generation_tasks(TaskGraph& graph);
+    // Loads the sections generated during the frame into their levels - no
+    // task of the frame may be running
+    void load_generated_sections();
+    SectionGenerator const* get_generator() const { return generator.get(); }
+
+    // Loads the chunk of (x, y) on level depth from the baked world - false
+    // if it is not baked
+    bool load_baked_chunk(ulong depth, long x, long y);
+    bool is_baked(ulong depth, long x, long y) const;
+    BakedWorld const* get_baked() const { return baked.get(); }
+
     Level& current_level();
     Level& operator[](ulong depth);
+
+   private:
+    std::unique_ptr<SectionGenerator> generator;
+    std::unique_ptr<BakedWorld> baked;
 };
@@ -0,0 +1,97 @@
+#include "map/zone_grid.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace {
+ulong const WORD_BITS = 64;
+
+// The bits [first, first + count) of a row
+void set_bits(ulong* row, ulong first, ulong count) {
+    for(ulong y = first; y < first + count;) {
+        ulong const bit = y % WORD_BITS;
+        ulong const num = std::min(WORD_BITS - bit, first + count - y);
+        ulong const mask = num == WORD_BITS ? ~0ul : ((1ul << num) - 1) << bit;
+        row[y / WORD_BITS] |= mask;
+        y += num;
+    }
+}
+
+// Keeps the bits y of row with bit y + shift set as well
+void and_shifted(std::vector<ulong>& row, ulong shift) {
+    ulong const words = shift / WORD_BITS;
+    ulong const bits = shift % WORD_BITS;
+    for(ulong idx = 0; idx < row.size(); ++idx) {
+        ulong const lo = idx + words < row.size() ? row[idx + words] : 0;
+        ulong const hi = idx + words + 1 < row.size() ? row[idx + words + 1] : 0;
+        row[idx] &= bits == 0 ? lo : lo >> bits | hi << (WORD_BITS - bits);
+    }
+}
+}  // namespace
+
+ZoneGrid::ZoneGrid(ulong length, ulong depth)
+    : length(length),
+      depth(depth),
+      row_words((length + WORD_BITS - 1) / WORD_BITS),
+      bits(depth * length * row_words, 0),
+      free_rows(length * row_words),
+      window(row_words) {}
+
+void ZoneGrid::place(ulong x, ulong y, ulong z, ulong w, ulong h, ulong d) {
+    if(x + w > length || y + h > length || z + d > depth) return;
+    for(ulong k = z; k < z + d; ++k) {
+        for(ulong i = x; i < x + w; ++i) set_bits(row(i, k), y, h);
+    }
+}
+
+bool ZoneGrid::find_first(ulong z, ulong w, ulong h, ulong d, ulong x_begin,
+                          ulong x_end, ulong& x, ulong& y) {
+    if(w == 0 || h == 0 || w > length || h > length || z + d > depth) {
+        return false;
+    }
+    ulong const num_x = std::min(x_end, length - w + 1);
+    if(x_begin >= num_x) return false;
+    ulong const last_bits = length % WORD_BITS;
+    ulong const last_mask = last_bits == 0 ? ~0ul : (1ul << last_bits) - 1;
+    // the free chunks of row i on all d levels, worked out as the window
+    // reaches the row - the scan mostly stops long before the last one
+    auto free_row = [&](ulong i) {
+        ulong* free = free_rows.data() + i * row_words;
+        for(ulong word = 0; word < row_words; ++word) {
+            ulong taken = 0;
+            for(ulong k = z; k < z + d; ++k) taken |= row(i, k)[word];
+            free[word] = ~taken;
+        }
+        free[row_words - 1] &= last_mask;
+    };
+    for(ulong i = x_begin; i < x_begin + w - 1; ++i) free_row(i);
+
+    for(ulong i = x_begin; i < num_x; ++i) {
+        free_row(i + w - 1);
+        std::copy_n(free_rows.data() + i * row_words, row_words,
+                    window.begin());
+        ulong any = 0;
+        for(ulong word = 0; word < row_words; ++word) {
+            for(ulong j = i + 1; j < i + w; ++j) {
+                window[word] &= free_rows[j * row_words + word];
+            }
+            any |= window[word];
+        }
+        if(any == 0) continue;
+        // h free columns in a row start where the window and its copies
+        // shifted by 1 to h - 1 columns are free - doubling the run each step
+        for(ulong run = 1; run < h;) {
+            ulong const shift = std::min(run, h - run);
+            and_shifted(window, shift);
+            run += shift;
+        }
+        for(ulong word = 0; word < row_words; ++word) {
+            if(window[word] == 0) continue;
+            x = i;
+            y = word * WORD_BITS +
+                static_cast<ulong>(std::countr_zero(window[word]));
+            return true;
+        }
+    }
+    return false;
+}
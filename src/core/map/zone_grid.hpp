@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include "utils/types.hpp"
+
+// The chunks of a region taken by a zone, one bit per chunk. A level is a
+// row of words per x, bit y % 64 of word y / 64 - so a zone's y extent in a
+// row is tested a word at a time, and the rows of a zone's x extent and the
+// levels of its depth fold into one free mask with a word-wide and.
+class ZoneGrid {
+    ulong length;  // chunks per side
+    ulong depth;   // levels
+    ulong row_words;
+    std::vector<ulong> bits;
+    // free chunks of the levels searched, row by row, and of the rows of a
+    // window - reused across searches
+    std::vector<ulong> free_rows;
+    std::vector<ulong> window;
+
+    ulong* row(ulong x, ulong z) {
+        return bits.data() + (z * length + x) * row_words;
+    }
+
+   public:
+    ZoneGrid(ulong length, ulong depth);
+
+    // Takes the w x h chunks at (x, y) on the d levels from z down
+    void place(ulong x, ulong y, ulong z, ulong w, ulong h, ulong d);
+    // The free w x h chunks on the d levels from z down with the smallest x
+    // in [x_begin, x_end), then the smallest y - what a scan of x then y
+    // finds first. False if there are none.
+    bool find_first(ulong z, ulong w, ulong h, ulong d, ulong x_begin,
+                    ulong x_end, ulong& x, ulong& y);
+
+    ulong get_length() const { return length; }
+    ulong get_depth() const { return depth; }
+};
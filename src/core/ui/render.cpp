@@ -1,6 +1,7 @@
 #include "ui/render.hpp"
 #include "app/clock_speed.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <numeric>
 #include <sstream>
@@ -79,23 +80,21 @@ tcodRenderer::tcodRenderer(bool is_debug_graphics)
         use_default_tile_rendering();
 }
 
-void tcodRenderer::render_map(LayoutBox const &box, Map &map,
+void tcodRenderer::render_map(LayoutBox const &box, Map const &map,
                               MapWindow const &window) {
     std::unique_ptr<MapTileRenderer> tile_renderer =
         generate_tile_renderer(map);
 
     // SPDLOG_TRACE("Rendering map with border ({}, {}) - {}x{}",
-    for(long local_x = 0; local_x < window.border.w; ++local_x) {
-        for(long local_y = 0; local_y < window.border.h; ++local_y) {
-            long x = local_x + window.border.x1;
-            long y = local_y + window.border.y1;
-
-            // SPDLOG_TRACE("Rendering tile at ({}, {}) - local ({}, {})", x, y,
-            // local_x, local_y);
+    Rect const &border = window.border;
+    map.read_spans(border, [&](ConstTileSpan const &span) {
+        long const local_y = span.y - border.y1;
+        for(ulong offset = 0; offset < span.length; ++offset) {
+            long const local_x = span.x + static_cast<long>(offset) - border.x1;
             auto &tile = clear_tile(box, local_x, local_y);
-            (*tile_renderer)(tile, x, y);
+            (*tile_renderer)(tile, span.snapshot(offset));
         }
-    }
+    });
     // render the debug info on the screen
     DEBUG_CHUNKS(
         box, map, window,
@@ -105,23 +104,25 @@ void tcodRenderer::render_map(LayoutBox const &box, Map &map,
         is_debug_graphics);
 }
 
-DebugMapTileRenderer::DebugMapTileRenderer(Map &map) : map(map) {}
+DebugMapTileRenderer::DebugMapTileRenderer(Map const &map) : map(map) {}
 
-void DebugMapTileRenderer::operator()(TCOD_ConsoleTile &tile, long x, long y) {
+void DebugMapTileRenderer::operator()(TCOD_ConsoleTile &tile,
+                                      TileSnapshot const &map_tile) {
     TCOD_ColorRGBA darkWall = color::light_black;
     TCOD_ColorRGBA lightWall = color::indian_red;
     TCOD_ColorRGBA lightGround = color::grey;
 
-    if(map.in_fov(x, y)) {
-        tile.bg = map.is_wall(x, y) ? lightWall : lightGround;
+    if(map_tile.in_fov) {
+        tile.bg = map_tile.is_wall ? lightWall : lightGround;
     } else {
-        tile.bg = map.is_wall(x, y) ? darkWall : lightGround;
+        tile.bg = map_tile.is_wall ? darkWall : lightGround;
     }
 }
 
-TcodMapTileRenderer::TcodMapTileRenderer(Map &map) : map(map) {}
+TcodMapTileRenderer::TcodMapTileRenderer(Map const &map) : map(map) {}
 
-void TcodMapTileRenderer::operator()(TCOD_ConsoleTile &tile, long x, long y) {
+void TcodMapTileRenderer::operator()(TCOD_ConsoleTile &tile,
+                                     TileSnapshot const &map_tile) {
     // SPDLOG_TRACE("Rendering map");
     TCOD_ColorRGBA darkWall = color::light_black;
     TCOD_ColorRGBA darkGround = color::dark_grey;
@@ -132,40 +133,41 @@ void TcodMapTileRenderer::operator()(TCOD_ConsoleTile &tile, long x, long y) {
     if(is_debug_graphics) {
         return;
     }
-    if(map.in_fov(x, y)) {
-        tile.bg = map.is_wall(x, y) ? lightWall : lightGround;
+    if(map_tile.in_fov) {
+        tile.bg = map_tile.is_wall ? lightWall : lightGround;
     } else {
-        tile.bg =
-            map.is_wall(x, y) || !map.is_explored(x, y) ? darkWall : darkGround;
+        tile.bg = map_tile.is_wall || !map_tile.is_explored ? darkWall
+                                                            : darkGround;
     }
 }
 
-ScentMapTileRenderer::ScentMapTileRenderer(Map &map, ulong scent_idx)
+ScentMapTileRenderer::ScentMapTileRenderer(Map const &map, ulong scent_idx)
     : map(map), scent_idx(scent_idx) {
     SPDLOG_TRACE("Created scent map tile renderer with scent_idx: {}",
                  scent_idx);
 }
 
-void ScentMapTileRenderer::operator()(TCOD_ConsoleTile &tile, long x, long y) {
+void ScentMapTileRenderer::operator()(TCOD_ConsoleTile &tile,
+                                      TileSnapshot const &map_tile) {
     // SPDLOG_TRACE("Rendering map");
     TCOD_ColorRGBA darkWall = color::light_black;
     TCOD_ColorRGBA darkGround = color::dark_grey;
     TCOD_ColorRGBA lightWall = color::indian_red;
 
-    ulong scents = map.get_tile_scents_by_coord(x, y);
-    unsigned char scent = static_cast<signed char>(scents >> scent_idx);
+    unsigned char scent =
+        static_cast<signed char>(map_tile.scents >> scent_idx);
     TCOD_ColorRGBA scent_color{scent, scent, scent, 255};
 
-    if(map.in_fov(x, y)) {
-        tile.bg = map.is_wall(x, y) ? lightWall : scent_color;
+    if(map_tile.in_fov) {
+        tile.bg = map_tile.is_wall ? lightWall : scent_color;
     } else {
-        tile.bg =
-            map.is_wall(x, y) || !map.is_explored(x, y) ? darkWall : darkGround;
+        tile.bg = map_tile.is_wall || !map_tile.is_explored ? darkWall
+                                                            : darkGround;
     }
 }
 
-void tcodRenderer::render_ant(LayoutBox const &box, Map &map, EntityData &a,
-                              MapWindow const &window) {
+void tcodRenderer::render_ant(LayoutBox const &box, Map const &map,
+                              EntityData &a, MapWindow const &window) {
     // SPDLOG_TRACE("Rendering ant at ({}, {})", a.x, a.y);
     long x, y;
     bool is_valid;
@@ -194,7 +196,7 @@ void tcodRenderer::render_ant(LayoutBox const &box, Map &map, EntityData &a,
         clear_tile(box, last_x, last_y);
     }
 
-    if(map.in_fov(a.x, a.y)) {
+    if(map.read_tile(a.x, a.y).in_fov) {
         // SPDLOG_TRACE("Rendering ant in FOV at ({}, {})", a.x, a.y);
         auto &tile = get_tile(box, x, y);
         tile.ch = a.ch;
@@ -343,6 +345,27 @@ void tcodRenderer::render_sidebar(LayoutBox const& box, SidebarMenu const& menu,
                      TCOD_BKGND_SET);
 }
 
+void tcodRenderer::render_sidebar_stats(LayoutBox const& box,
+                                        std::vector<std::string> const& lines) {
+    long w = box.get_width();
+    long h = box.get_height();
+    ulong text_w = 0;
+    for(std::string const& line : lines) {
+        text_w = std::max(text_w, static_cast<ulong>(line.size()));
+    }
+    long x = w - static_cast<long>(text_w) - 2;
+    if(x <= 1 || h <= 3) return;
+
+    for(ulong i = 0; i < lines.size() && static_cast<long>(i) < h - 2; ++i) {
+        tcod::print_rect(root_console,
+                         get_rect(box, static_cast<int>(x),
+                                  static_cast<int>(i + 1),
+                                  static_cast<int>(text_w), 1),
+                         lines[i], color::light_green, color::dark_grey,
+                         TCOD_LEFT, TCOD_BKGND_SET);
+    }
+}
+
 void tcodRenderer::render_toggle_button(bool is_expanded) {
     long x = 0, y = 0, w = 0, h = 0;
     SidebarMenu::get_toggle_button_bounds(x, y, w, h);
@@ -398,21 +421,21 @@ const std::array<int, 4> tcodRenderer::get_rect(LayoutBox const &box, long x,
 
 void tcodRenderer::use_default_tile_rendering() {
     SPDLOG_INFO("Using default map tile renderer");
-    generate_tile_renderer = [](Map &map) {
+    generate_tile_renderer = [](Map const &map) {
         return std::make_unique<TcodMapTileRenderer>(map);
     };
 }
 
 void tcodRenderer::use_debug_tile_rendering() {
     SPDLOG_INFO("Using default map tile renderer");
-    generate_tile_renderer = [](Map &map) {
+    generate_tile_renderer = [](Map const &map) {
         return std::make_unique<DebugMapTileRenderer>(map);
     };
 }
 
 void tcodRenderer::use_scent_tile_rendering(ulong scent_idx) {
     SPDLOG_INFO("Using scent map tile renderer - scent index: {}", scent_idx);
-    generate_tile_renderer = [scent_idx](Map &map) {
+    generate_tile_renderer = [scent_idx](Map const &map) {
         return std::make_unique<ScentMapTileRenderer>(map, scent_idx);
     };
 }
@@ -15,9 +15,10 @@
 
 class Renderer {
    public:
-    virtual void render_map(LayoutBox const&, Map&, MapWindow const&) = 0;
-    virtual void render_ant(LayoutBox const& box, Map& map, EntityData& a,
+    virtual void render_map(LayoutBox const&, Map const&,
                             MapWindow const&) = 0;
+    virtual void render_ant(LayoutBox const& box, Map const& map,
+                            EntityData& a, MapWindow const&) = 0;
     virtual void render_building(LayoutBox const& box, Building& b,
                                  MapWindow const&) = 0;
     virtual void render_text_editor(LayoutBox const& box,
@@ -26,6 +27,9 @@ class Renderer {
     virtual void render_help_boxes(LayoutBox const& box) = 0;
     virtual void render_sidebar(LayoutBox const& box, SidebarMenu const& menu,
                                 ClockSpeed clock_speed) = 0;
+    // right aligned over the sidebar - call after render_sidebar
+    virtual void render_sidebar_stats(
+        LayoutBox const& box, std::vector<std::string> const& lines) = 0;
     virtual void render_toggle_button(bool is_expanded) = 0;
     virtual void present() = 0;
     virtual void pixel_to_tile_coordinates(int pixel_x, int pixel_y,
@@ -37,12 +41,15 @@ class Renderer {
 class NoneRenderer : public Renderer {
    public:
     NoneRenderer() { SPDLOG_INFO("NoneRenderer initialized"); }
-    void render_map(LayoutBox const&, Map&, MapWindow const&) {};
-    void render_ant(LayoutBox const&, Map&, EntityData&, MapWindow const&) {};
+    void render_map(LayoutBox const&, Map const&, MapWindow const&) {};
+    void render_ant(LayoutBox const&, Map const&, EntityData&,
+                    MapWindow const&) {};
     void render_building(LayoutBox const&, Building&, MapWindow const&) {};
     void render_text_editor(LayoutBox const&, TextEditor const&, ulong) {};
     void render_help_boxes(LayoutBox const&) {};
     void render_sidebar(LayoutBox const&, SidebarMenu const&, ClockSpeed) {};
+    void render_sidebar_stats(LayoutBox const&,
+                              std::vector<std::string> const&) {};
     void render_toggle_button(bool) {};
     void present() {};
     void pixel_to_tile_coordinates(int, int, long& tile_x, long& tile_y) {
@@ -53,36 +60,38 @@ class NoneRenderer : public Renderer {
     void use_scent_tile_rendering(ulong) {}
 };
 
+// Colors the console tile of a map tile
 struct MapTileRenderer {
     virtual ~MapTileRenderer() {}
-    virtual void operator()(TCOD_ConsoleTile& tile, long x, long y) = 0;
+    virtual void operator()(TCOD_ConsoleTile& tile,
+                            TileSnapshot const& map_tile) = 0;
 };
 
 struct TcodMapTileRenderer : public MapTileRenderer {
-    Map& map;
+    Map const& map;
     bool is_debug_graphics = false;
-    TcodMapTileRenderer(Map& map);
-    void operator()(TCOD_ConsoleTile& tile, long x, long y);
+    TcodMapTileRenderer(Map const& map);
+    void operator()(TCOD_ConsoleTile& tile, TileSnapshot const& map_tile);
 };
 
 struct ScentMapTileRenderer : public MapTileRenderer {
-    Map& map;
+    Map const& map;
     ulong scent_idx;
-    ScentMapTileRenderer(Map& map, ulong scent_idx);
-    void operator()(TCOD_ConsoleTile& tile, long x, long y);
+    ScentMapTileRenderer(Map const& map, ulong scent_idx);
+    void operator()(TCOD_ConsoleTile& tile, TileSnapshot const& map_tile);
 };
 
 struct DebugMapTileRenderer : public MapTileRenderer {
-    Map& map;
-    DebugMapTileRenderer(Map& map);
-    void operator()(TCOD_ConsoleTile& tile, long x, long y);
+    Map const& map;
+    DebugMapTileRenderer(Map const& map);
+    void operator()(TCOD_ConsoleTile& tile, TileSnapshot const& map_tile);
 };
 
 class tcodRenderer : public Renderer {
    public:
     tcodRenderer(bool is_debug_graphics);
-    void render_map(LayoutBox const&, Map&, MapWindow const&);
-    void render_ant(LayoutBox const& box, Map& map, EntityData& a,
+    void render_map(LayoutBox const&, Map const&, MapWindow const&);
+    void render_ant(LayoutBox const& box, Map const& map, EntityData& a,
                     MapWindow const&);
     void render_building(LayoutBox const& box, Building& b, MapWindow const&);
     void render_text_editor(LayoutBox const& box, TextEditor const& editor,
@@ -90,6 +99,8 @@ class tcodRenderer : public Renderer {
     void render_help_boxes(LayoutBox const&);
     void render_sidebar(LayoutBox const& box, SidebarMenu const& menu,
                         ClockSpeed clock_speed);
+    void render_sidebar_stats(LayoutBox const& box,
+                              std::vector<std::string> const& lines);
     void render_toggle_button(bool is_expanded);
     void present();
     void pixel_to_tile_coordinates(int pixel_x, int pixel_y, long& tile_x,
@@ -107,6 +118,6 @@ class tcodRenderer : public Renderer {
     bool is_debug_graphics = false;
     tcod::Context context;
     tcod::Console root_console;
-    std::function<std::unique_ptr<MapTileRenderer>(Map&)>
+    std::function<std::unique_ptr<MapTileRenderer>(Map const&)>
         generate_tile_renderer;
 };
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "utils/types.hpp"
+
+// Owns objects of one type in slabs of slab_size and hands released objects
+// out again before it grows. A released object is not destroyed - whoever
+// acquires it resets it, which lets it keep the heap memory of its members.
+// All objects are destroyed with the arena.
+template <class T, ulong slab_size = 64>
+class SlabArena {
+    std::vector<std::unique_ptr<T[]>> slabs;
+    ulong slab_used = slab_size;  // objects handed out of the last slab
+    std::vector<T*> free_list;
+
+   public:
+    SlabArena() = default;
+    SlabArena(SlabArena const&) = delete;
+    SlabArena& operator=(SlabArena const&) = delete;
+    SlabArena(SlabArena&&) noexcept = default;
+    SlabArena& operator=(SlabArena&&) noexcept = default;
+
+    // A released object or a default constructed one
+    T& acquire() {
+        if(!free_list.empty()) {
+            T* object = free_list.back();
+            free_list.pop_back();
+            return *object;
+        }
+        if(slab_used == slab_size) {
+            slabs.emplace_back(new T[slab_size]);
+            slab_used = 0;
+        }
+        return slabs.back()[slab_used++];
+    }
+    void release(T& object) { free_list.push_back(&object); }
+
+    ulong num_slabs() const { return slabs.size(); }
+    ulong num_free() const { return free_list.size(); }
+    // objects handed out and not released
+    ulong size() const {
+        if(slabs.empty()) return 0;
+        return (slabs.size() - 1) * slab_size + slab_used - free_list.size();
+    }
+    // bytes of the slabs and the free list - not the objects' heap memory
+    ulong memory_usage() const {
+        return slabs.size() * slab_size * sizeof(T) +
+               free_list.capacity() * sizeof(T*);
+    }
+};
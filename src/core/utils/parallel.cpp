@@ -0,0 +1,37 @@
+#include "utils/parallel.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+ParallelRange::ParallelRange(ulong begin, ulong end, ulong grain,
+                             ulong max_jobs, Partition partition, Body body,
+                             void const* context)
+    : body(body),
+      context(context),
+      begin(begin),
+      end(std::max(begin, end)),
+      grain(std::max(grain, 1ul)),
+      num_chunks((this->end - begin + this->grain - 1) / this->grain),
+      num_jobs(std::min(num_chunks, std::max(max_jobs, 1ul))),
+      partition(partition) {}
+
+void ParallelRange::run_chunks(ulong first, ulong last) const {
+    for(ulong chunk = first; chunk < last; ++chunk) {
+        ulong const chunk_start = chunk_begin(chunk);
+        body(context, chunk_start, std::min(chunk_start + grain, end));
+    }
+}
+
+void ParallelRange::run_job(ulong job) const {
+    assert(job < num_jobs);
+    if(partition == Partition::STATIC) {
+        run_chunks(job * num_chunks / num_jobs,
+                   (job + 1) * num_chunks / num_jobs);
+        return;
+    }
+    for(;;) {
+        ulong const chunk = next_chunk.fetch_add(1, std::memory_order_relaxed);
+        if(chunk >= num_chunks) return;
+        run_chunks(chunk, chunk + 1);
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <type_traits>
+#include <vector>
+
+#include "utils/thread_pool.hpp"
+#include "utils/types.hpp"
+
+// How the chunks of a ParallelRange are handed to the jobs. STATIC gives job
+// j the j-th contiguous block of chunks, DYNAMIC lets the jobs claim the
+// next chunk until none is left - better when the cost per index varies.
+enum class Partition {
+    STATIC,
+    DYNAMIC,
+};
+
+// The index range [begin, end) of a parallel_for cut into chunks of grain
+// indices. One job per pool thread (and the caller) runs the body on its
+// chunks. The body has no state here - it lives on the caller's stack for
+// the duration of run().
+class ParallelRange {
+   public:
+    using Body = void (*)(void const* context, ulong begin, ulong end);
+
+   private:
+    Body body;
+    void const* context;
+    ulong begin;
+    ulong end;
+    ulong grain;
+    ulong num_chunks;
+    ulong num_jobs;
+    Partition partition;
+    mutable std::atomic<ulong> next_chunk = 0;
+
+    void run_chunks(ulong first, ulong last) const;
+
+   public:
+    ParallelRange(ulong begin, ulong end, ulong grain, ulong max_jobs,
+                  Partition partition, Body body, void const* context);
+
+    // Job must be constructible from (ParallelRange const&, ulong job) and
+    // call run_job from its run(). Only the pool's owner may call this - it
+    // awaits every job of the pool, not only the range's.
+    template <class Job>
+    void run(ThreadPool<Job>& pool) {
+        for(ulong job = 0; job < num_jobs; ++job) {
+            Job range_job(*this, job);
+            pool.submit_job(range_job);
+        }
+        pool.await_jobs();
+    }
+
+    void run_job(ulong job) const;
+
+    ulong size() const { return num_chunks; }
+    // first index of the chunk
+    ulong chunk_begin(ulong chunk) const { return begin + chunk * grain; }
+    ulong chunk_of(ulong idx) const { return (idx - begin) / grain; }
+};
+
+// Calls fn(idx) for every idx in [begin, end) on the pool's threads and the
+// calling thread. Returns once all of them ran.
+template <class Job, class Fn>
+void parallel_for(ThreadPool<Job>& pool, ulong begin, ulong end, ulong grain,
+                  Fn const& fn, Partition partition = Partition::DYNAMIC) {
+    ParallelRange range(
+        begin, end, grain, pool.size() + 1, partition,
+        [](void const* context, ulong first, ulong last) {
+            Fn const& fn = *static_cast<Fn const*>(context);
+            for(ulong idx = first; idx < last; ++idx) fn(idx);
+        },
+        &fn);
+    range.run(pool);
+}
+
+// Folds map(idx) over [begin, end) with reduce, starting every chunk from
+// identity. The partial result of each chunk is kept and the partials are
+// folded in index order, so the result does not depend on the thread count
+// or the partition even when reduce is not associative (floating point).
+template <class Job, class T, class MapFn, class ReduceFn>
+T parallel_reduce(ThreadPool<Job>& pool, ulong begin, ulong end, ulong grain,
+                  T const& identity, MapFn const& map,
+                  ReduceFn const& reduce,
+                  Partition partition = Partition::DYNAMIC) {
+    // std::vector<bool> packs the partials into shared words
+    static_assert(!std::is_same_v<T, bool>, "reduce into a wider type");
+    struct Context {
+        MapFn const& map;
+        ReduceFn const& reduce;
+        T const& identity;
+        std::vector<T> partials;
+        ParallelRange const* range;
+    } context{map, reduce, identity, {}, nullptr};
+
+    ParallelRange range(
+        begin, end, grain, pool.size() + 1, partition,
+        [](void const* data, ulong first, ulong last) {
+            // the partials are written by the chunk's job alone
+            Context& context =
+                *const_cast<Context*>(static_cast<Context const*>(data));
+            T partial = context.identity;
+            for(ulong idx = first; idx < last; ++idx) {
+                partial = context.reduce(partial, context.map(idx));
+            }
+            context.partials[context.range->chunk_of(first)] = partial;
+        },
+        &context);
+    context.partials.assign(range.size(), identity);
+    context.range = &range;
+    range.run(pool);
+
+    T result = identity;
+    for(T const& partial : context.partials) result = reduce(result, partial);
+    return result;
+}
@@ -0,0 +1,40 @@
+#include "utils/task_graph.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+TaskGraph::TaskId TaskGraph::add(std::string name, Work work,
+                                 std::vector<TaskId> dependencies,
+                                 Affinity affinity) {
+    TaskId const id = tasks.size();
+    ulong wave = 0;
+    for(TaskId dependency : dependencies) {
+        assert(dependency < id);
+        wave = std::max(wave, tasks[dependency].wave + 1);
+    }
+    tasks.push_back({std::move(name), std::move(work),
+                     std::move(dependencies), affinity, wave});
+    if(waves.size() <= wave) waves.resize(wave + 1);
+    waves[wave].push_back(id);
+    return id;
+}
+
+void TaskGraph::clear() {
+    tasks.clear();
+    waves.clear();
+}
+
+std::string TaskGraph::describe() const {
+    std::string text;
+    for(ulong wave = 0; wave < waves.size(); ++wave) {
+        text += "wave " + std::to_string(wave) + ":";
+        char const* separator = " ";
+        for(TaskId id : waves[wave]) {
+            text += separator + tasks[id].name;
+            if(tasks[id].affinity == Affinity::CALLER) text += " [caller]";
+            separator = ", ";
+        }
+        text += "\n";
+    }
+    return text;
+}
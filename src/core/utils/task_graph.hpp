@@ -0,0 +1,73 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "utils/thread_pool.hpp"
+#include "utils/types.hpp"
+
+// Tasks of one frame with explicit dependencies. A task is placed in the
+// wave after the latest wave of its dependencies, so the schedule only
+// depends on the declarations. run() executes the waves in order and the
+// tasks of a wave concurrently on the pool - the result is deterministic as
+// long as tasks without a dependency path between them touch disjoint
+// state.
+class TaskGraph {
+   public:
+    using TaskId = ulong;
+    using Work = std::function<void()>;
+
+    enum class Affinity {
+        POOL,
+        // Runs on the thread calling run() after the pool tasks of its wave
+        // are submitted. Such a task may submit jobs of its own, the wave
+        // awaits them with the rest.
+        CALLER,
+    };
+
+   private:
+    struct Task {
+        std::string name;
+        Work work;
+        std::vector<TaskId> dependencies;
+        Affinity affinity;
+        ulong wave;
+    };
+    std::vector<Task> tasks;
+    std::vector<std::vector<TaskId>> waves;
+
+   public:
+    // Dependencies must be tasks added before, which keeps the graph acyclic
+    TaskId add(std::string name, Work work,
+               std::vector<TaskId> dependencies = {},
+               Affinity affinity = Affinity::POOL);
+    void clear();
+
+    // Job must be constructible from (TaskGraph&, TaskId) and call
+    // run_task from its run()
+    template <class Job>
+    void run(ThreadPool<Job>& pool) {
+        for(std::vector<TaskId> const& wave : waves) {
+            for(TaskId id : wave) {
+                if(tasks[id].affinity != Affinity::POOL) continue;
+                Job job(*this, id);
+                pool.submit_job(job);
+            }
+            for(TaskId id : wave) {
+                if(tasks[id].affinity == Affinity::CALLER) run_task(id);
+            }
+            pool.await_jobs();
+        }
+    }
+
+    void run_task(TaskId id) const { tasks[id].work(); }
+
+    ulong size() const { return tasks.size(); }
+    std::vector<std::vector<TaskId>> const& get_waves() const {
+        return waves;
+    }
+    std::string const& name(TaskId id) const { return tasks[id].name; }
+    // One line per wave - "wave 1: actions L0, actions L3, view [caller]"
+    std::string describe() const;
+};
@@ -1,3 +1,95 @@
-#include "thread_pool.hpp"
+#include "utils/thread_pool.hpp"
 
-std::mutex globals::threadpool_mutex;
+#include <cstdio>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+ulong default_thread_count() {
+    unsigned const num_cpus = std::thread::hardware_concurrency();
+    return num_cpus > 1 ? num_cpus - 1 : 0;
+}
+
+bool ThreadWorker::pin(ulong cpu) {
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    int const err =
+        pthread_setaffinity_np(_thread.native_handle(), sizeof(cpus), &cpus);
+    if(err != 0) {
+        SPDLOG_WARN("Failed to pin pool thread to cpu {} - error {}", cpu,
+                    err);
+        return false;
+    }
+    return true;
+#else
+    (void)cpu;
+    SPDLOG_WARN("Pinning pool threads is only supported on Linux");
+    return false;
+#endif
+}
+
+double WorkerStats::utilization() const {
+    ulong const total = busy_ns + spin_ns + parked_ns;
+    if(total == 0) return 0;
+    return static_cast<double>(busy_ns) / static_cast<double>(total);
+}
+
+double ThreadPoolStats::utilization() const {
+    if(workers.empty()) return 0;
+    double sum = 0;
+    for(WorkerStats const& worker : workers) sum += worker.utilization();
+    return sum / static_cast<double>(workers.size());
+}
+
+double ThreadPoolStats::steal_ratio() const {
+    ulong jobs = 0, steals = 0;
+    for(WorkerStats const& worker : workers) {
+        jobs += worker.jobs;
+        steals += worker.steals;
+    }
+    if(jobs == 0) return 0;
+    return static_cast<double>(steals) / static_cast<double>(jobs);
+}
+
+double ThreadPoolStats::caller_wait_ratio() const {
+    ulong const total = caller.busy_ns + caller.parked_ns;
+    if(total == 0) return 0;
+    return static_cast<double>(caller.parked_ns) / static_cast<double>(total);
+}
+
+// Short lines for the sidebar
+std::vector<std::string> ThreadPoolStats::summary() const {
+    auto line = [](char const* label, double value, char const* unit) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%-6s%5.0f%s", label, value, unit);
+        return std::string(text);
+    };
+    return {
+        "POOL " + std::to_string(workers.size()) + " THREADS",
+        line("UTIL", utilization() * 100, "%"),
+        line("STEAL", steal_ratio() * 100, "%"),
+        line("WAIT", caller_wait_ratio() * 100, "%"),
+        line("QMAX", static_cast<double>(caller.max_queue_depth), ""),
+    };
+}
+
+WorkerStats PoolCounters::load() const {
+    WorkerStats stats;
+    stats.jobs = jobs.load(std::memory_order_relaxed);
+    stats.steals = steals.load(std::memory_order_relaxed);
+    stats.busy_ns = busy_ns.load(std::memory_order_relaxed);
+    stats.spin_ns = spin_ns.load(std::memory_order_relaxed);
+    stats.parked_ns = parked_ns.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void PoolCounters::reset() {
+    for(std::atomic<ulong>* counter :
+        {&jobs, &steals, &busy_ns, &spin_ns, &parked_ns}) {
+        counter->store(0, std::memory_order_relaxed);
+    }
+}
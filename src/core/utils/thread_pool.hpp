@@ -4,97 +4,329 @@
 #include <atomic>
 #include <cassert>
 #include <chrono>
-#include <ctime>
-#include <deque>
+#include <cstring>
 #include <list>
-#include <mutex>
+#include <memory>
+#include <new>
 #include <optional>
+#include <string>
 #include <thread>
+#include <type_traits>
+#include <vector>
 
-#include "app/globals.hpp"
 #include "utils/types.hpp"
 #include "spdlog/spdlog.h"
 
+// One worker per hardware thread besides the one that submits the jobs,
+// which helps running them. 0 on a single core - the jobs then run inline.
+ulong default_thread_count();
+
+// What one thread of a ThreadPool did since the last reset_stats. Spinning
+// is the time spent looking for work before parking.
+struct WorkerStats {
+    ulong jobs = 0;
+    ulong steals = 0;  // jobs taken from the deque of another worker
+    ulong busy_ns = 0;
+    ulong spin_ns = 0;
+    ulong parked_ns = 0;
+    ulong max_queue_depth = 0;  // of the worker's deque at submit
+
+    double utilization() const;
+};
+
+struct ThreadPoolStats {
+    std::vector<WorkerStats> workers;
+    // The submitting thread - busy with the jobs it helped with in
+    // await_jobs, parked while it waited for the workers. Its queue depth
+    // is the maximum of all deques.
+    WorkerStats caller;
+    ulong jobs_submitted = 0;
+
+    // mean over the workers
+    double utilization() const;
+    // share of the jobs the workers stole
+    double steal_ratio() const;
+    // share of await_jobs the caller spent blocked
+    double caller_wait_ratio() const;
+    std::vector<std::string> summary() const;
+};
+
+// Counters of one thread of the pool. Only that thread writes them and each
+// sits on its own cache line, so the relaxed increments stay cheap.
+struct alignas(64) PoolCounters {
+    using Clock = std::chrono::steady_clock;
+    std::atomic<ulong> jobs = 0;
+    std::atomic<ulong> steals = 0;
+    std::atomic<ulong> busy_ns = 0;
+    std::atomic<ulong> spin_ns = 0;
+    std::atomic<ulong> parked_ns = 0;
+
+    static void add(std::atomic<ulong>& counter, Clock::time_point from,
+                    Clock::time_point to) {
+        counter.fetch_add(static_cast<ulong>(
+                              std::chrono::duration_cast<
+                                  std::chrono::nanoseconds>(to - from)
+                                  .count()),
+                          std::memory_order_relaxed);
+    }
+    WorkerStats load() const;
+    void reset();
+};
+
+// Chase-Lev work-stealing deque. One owner thread pushes and pops at the
+// bottom, any thread steals from the top. The pool's owner is the thread
+// that submits and awaits the jobs - the workers only ever steal.
+//
+// Jobs are copied in and out of the slots word by word through relaxed
+// atomics, since a thief can read a slot the owner is about to reuse. Its
+// compare-and-swap on top then fails and the torn copy is dropped.
+template <class ThreadTask>
+class WorkDeque {
+    static_assert(std::is_trivially_copyable_v<ThreadTask>,
+                  "jobs are copied through the deque slots bytewise");
+    static constexpr ulong slot_words =
+        (sizeof(ThreadTask) + sizeof(ulong) - 1) / sizeof(ulong);
+
+    struct Buffer {
+        ulong const capacity;  // power of two
+        std::unique_ptr<std::atomic<ulong>[]> words;
+
+        explicit Buffer(ulong capacity)
+            : capacity(capacity),
+              words(new std::atomic<ulong>[capacity * slot_words]) {}
+
+        void put(long idx, ThreadTask const& task) {
+            ulong bytes[slot_words] = {};
+            std::memcpy(bytes, &task, sizeof(ThreadTask));
+            std::atomic<ulong>* slot = slot_at(idx);
+            for(ulong w = 0; w < slot_words; ++w) {
+                slot[w].store(bytes[w], std::memory_order_relaxed);
+            }
+        }
+
+        ThreadTask get(long idx) const {
+            ulong bytes[slot_words];
+            std::atomic<ulong> const* slot = slot_at(idx);
+            for(ulong w = 0; w < slot_words; ++w) {
+                bytes[w] = slot[w].load(std::memory_order_relaxed);
+            }
+            alignas(ThreadTask) unsigned char task[sizeof(ThreadTask)];
+            std::memcpy(task, bytes, sizeof(ThreadTask));
+            return *std::launder(reinterpret_cast<ThreadTask*>(task));
+        }
+
+        std::atomic<ulong>* slot_at(long idx) const {
+            return &words[(static_cast<ulong>(idx) & (capacity - 1)) *
+                          slot_words];
+        }
+    };
+
+    alignas(64) std::atomic_long top;
+    alignas(64) std::atomic_long bottom;
+    std::atomic<Buffer*> buffer;
+    // Outgrown buffers stay alive until the deque dies since a thief may
+    // still be reading from them.
+    std::vector<std::unique_ptr<Buffer>> buffers;
+
+    Buffer* grow(Buffer* old, long top_idx, long bottom_idx) {
+        buffers.push_back(std::make_unique<Buffer>(old->capacity * 2));
+        Buffer* grown = buffers.back().get();
+        for(long idx = top_idx; idx < bottom_idx; ++idx) {
+            grown->put(idx, old->get(idx));
+        }
+        buffer.store(grown, std::memory_order_release);
+        SPDLOG_TRACE("Work deque grew to {} jobs", grown->capacity);
+        return grown;
+    }
+
+   public:
+    explicit WorkDeque(ulong capacity = 64) : top(0), bottom(0) {
+        buffers.push_back(std::make_unique<Buffer>(capacity));
+        buffer.store(buffers.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkDeque(const WorkDeque&) = delete;
+    WorkDeque& operator=(const WorkDeque&) = delete;
+
+    // owner only - returns the number of queued jobs including this one
+    ulong push(ThreadTask const& task) {
+        long const b = bottom.load(std::memory_order_relaxed);
+        long const t = top.load(std::memory_order_acquire);
+        Buffer* buf = buffer.load(std::memory_order_relaxed);
+        if(b - t >= static_cast<long>(buf->capacity)) buf = grow(buf, t, b);
+        buf->put(b, task);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return static_cast<ulong>(b - t + 1);
+    }
+
+    // owner only
+    std::optional<ThreadTask> pop() {
+        long const b = bottom.load(std::memory_order_relaxed) - 1;
+        Buffer* buf = buffer.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long t = top.load(std::memory_order_relaxed);
+        if(t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        std::optional<ThreadTask> task(buf->get(b));
+        if(t == b) {
+            // last job - race the thieves for it
+            if(!top.compare_exchange_strong(t, t + 1,
+                                            std::memory_order_seq_cst,
+                                            std::memory_order_relaxed)) {
+                task.reset();
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    // Any thread. Retries when it loses a race for the top job, so an empty
+    // result means the deque was empty.
+    std::optional<ThreadTask> steal() {
+        while(true) {
+            long t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            long const b = bottom.load(std::memory_order_acquire);
+            if(t >= b) return std::nullopt;
+            ThreadTask task =
+                buffer.load(std::memory_order_acquire)->get(t);
+            if(top.compare_exchange_strong(t, t + 1,
+                                           std::memory_order_seq_cst,
+                                           std::memory_order_relaxed)) {
+                return task;
+            }
+        }
+    }
+};
+
+// State shared by the pool and its workers. There is one deque per worker;
+// submit_job deals the jobs out round robin and a worker drains its own
+// deque before stealing from the others.
+template <class ThreadTask>
+struct ThreadPoolState {
+    std::vector<std::unique_ptr<WorkDeque<ThreadTask>>> deques;
+    std::atomic_bool is_active = true;
+    // Bumped on every submit so a worker about to park notices jobs that
+    // arrived after it last looked. Both parking words are 32 bit - the
+    // width std::atomic::wait can hand to a futex directly.
+    std::atomic_uint work_epoch = 0;
+    std::atomic_uint num_sleeping = 0;
+    std::atomic_uint unfinished_jobs_count = 0;
+    // one per worker, the last for the submitting thread
+    std::unique_ptr<PoolCounters[]> counters;
+    // owner only
+    std::vector<ulong> max_queue_depths;
+    ulong jobs_submitted = 0;
+
+    ThreadPoolState(ulong number_deques, ulong number_threads)
+        : counters(new PoolCounters[number_threads + 1]),
+          max_queue_depths(number_deques, 0) {
+        for(ulong i = 0; i < number_deques; ++i) {
+            deques.push_back(std::make_unique<WorkDeque<ThreadTask>>());
+        }
+    }
+
+    // from is set to the deque the job came from
+    std::optional<ThreadTask> steal(ulong first, ulong& from) {
+        for(ulong i = 0; i < deques.size(); ++i) {
+            from = (first + i) % deques.size();
+            auto task = deques[from]->steal();
+            if(task.has_value()) return task;
+        }
+        return std::nullopt;
+    }
+
+    void finish_job() {
+        if(unfinished_jobs_count.fetch_sub(1) == 1) {
+            unfinished_jobs_count.notify_all();
+        }
+    }
+};
+
 template <class ThreadTask>
 class ThreadWork {
-    std::atomic_bool& is_working;
-    std::atomic_bool const& threadpool_active;
-    std::atomic_bool running_task;
-    std::deque<ThreadTask>& pending_jobs;
-    std::optional<ThreadTask> active_task;
-    // TODO: consolidate counts into one for just the number of unfinished jobs
-    std::atomic_ullong& pending_jobs_count;
-    std::atomic_ullong& active_worker_count;
-    std::atomic_ullong& unfinished_jobs_count;
+    using Clock = PoolCounters::Clock;
+    ThreadPoolState<ThreadTask>& state;
+    ulong const index;
+    PoolCounters& counters;
+    // end of the last job or park - the time since was spent spinning
+    Clock::time_point mark;
+    // rounds of looking for work before parking - keeps a worker awake
+    // between the bursts of jobs within one tick
+    static constexpr ulong spin_rounds = 32;
+
+    bool run_next() {
+        ulong from = index;
+        std::optional<ThreadTask> task = state.steal(index, from);
+        if(!task.has_value()) return false;
+        SPDLOG_TRACE("Threadwork {} acquired task", index);
+        Clock::time_point const start = Clock::now();
+        PoolCounters::add(counters.spin_ns, mark, start);
+        task->run();
+        mark = Clock::now();
+        PoolCounters::add(counters.busy_ns, start, mark);
+        counters.jobs.fetch_add(1, std::memory_order_relaxed);
+        if(from != index) {
+            counters.steals.fetch_add(1, std::memory_order_relaxed);
+        }
+        state.finish_job();
+        return true;
+    }
+
+    // Sleeps until the next submit. The epoch is read before looking at the
+    // deques one last time, so a job pushed after that look has bumped it
+    // and the wait returns at once.
+    void park() {
+        state.num_sleeping.fetch_add(1);
+        unsigned const epoch = state.work_epoch.load();
+        bool const has_work = run_next();
+        if(!has_work && state.is_active) {
+            Clock::time_point const start = Clock::now();
+            PoolCounters::add(counters.spin_ns, mark, start);
+            state.work_epoch.wait(epoch);
+            mark = Clock::now();
+            PoolCounters::add(counters.parked_ns, start, mark);
+        }
+        state.num_sleeping.fetch_sub(1);
+    }
 
    public:
-    explicit ThreadWork(std::atomic_bool& is_working,
-                        std::atomic_bool const& threadpool_active,
-                        std::deque<ThreadTask>& pending_jobs,
-                        std::atomic_ullong& pending_jobs_count,
-                                                std::atomic_ullong& active_worker_count,
-                                                std::atomic_ullong& unfinished_jobs_count)
-        : is_working(is_working),
-          threadpool_active(threadpool_active),
-          running_task(false),
-          pending_jobs(pending_jobs),
-          active_task(),
-          pending_jobs_count(pending_jobs_count),
-                    active_worker_count(active_worker_count),
-                    unfinished_jobs_count(unfinished_jobs_count) {}
+    ThreadWork(ThreadPoolState<ThreadTask>& state, ulong index)
+        : state(state),
+          index(index),
+          counters(state.counters[index]),
+          mark(Clock::now()) {}
 
     void operator()() {
-        std::chrono::nanoseconds initial_backoff(10);
-        std::chrono::nanoseconds max_backoff(1000);
-        std::chrono::nanoseconds backoff(initial_backoff);
-        while(threadpool_active) {
-            {
-                std::scoped_lock lock(globals::threadpool_mutex);
-                if(!pending_jobs.empty()) {
-                    active_task.emplace(std::move(pending_jobs.front()));
-                    pending_jobs.pop_front();
-                    ++active_worker_count;
-                    --pending_jobs_count;
-                    SPDLOG_TRACE("Threadwork acquired task");
-                    backoff = initial_backoff;
-                }
-            }
-            if(active_task.has_value()) {
-                running_task = true;
-                active_task->run();
-                --unfinished_jobs_count;
-                --active_worker_count;
-                running_task = false;
-                active_task.reset();  // Clear the active task after it's done
-            } else {
-                std::this_thread::sleep_for(backoff);
-                backoff *= 2;
-                if(backoff > max_backoff) backoff = max_backoff;
+        while(state.is_active) {
+            bool has_work = false;
+            for(ulong round = 0; round < spin_rounds && !has_work; ++round) {
+                has_work = run_next();
+                if(!has_work) std::this_thread::yield();
             }
+            if(!has_work) park();
         }
     }
 };
 
 class ThreadWorker {
-    std::atomic_bool _is_working;
     std::thread _thread;
 
    public:
     template <class ThreadTask>
-    ThreadWorker(std::atomic_bool const& threadpool_active,
-                 std::deque<ThreadTask>& pending_jobs,
-                 std::atomic_ullong& pending_jobs_count,
-                 std::atomic_ullong& active_worker_count,
-                 std::atomic_ullong& unfinished_jobs_count)
-        : _is_working(false), _thread([&]() {
-              ThreadWork<ThreadTask> thread_work(
-                  _is_working, threadpool_active, pending_jobs,
-                  pending_jobs_count, active_worker_count,
-                  unfinished_jobs_count);
+    ThreadWorker(ThreadPoolState<ThreadTask>& state, ulong index)
+        : _thread([&state, index]() {
+              ThreadWork<ThreadTask> thread_work(state, index);
               thread_work();
           }) {}
 
-    bool is_working() const { return _is_working; }
+    // Restricts the thread to the cpu. Returns false where affinity is not
+    // supported.
+    bool pin(ulong cpu);
 
     ~ThreadWorker() {
         if(_thread.joinable()) {
@@ -107,26 +339,23 @@ class ThreadWorker {
     ThreadWorker& operator=(const ThreadWorker&) = delete;
 };
 
+// Work-stealing pool. submit_job and await_jobs must be called from the same
+// thread, which helps running the jobs while it awaits them. A pool without
+// threads runs every job inside await_jobs. stats() and reset_stats() belong
+// to that thread as well.
 template <class ThreadTask>
 class ThreadPool {
+    std::unique_ptr<ThreadPoolState<ThreadTask>> state;
     std::list<ThreadWorker> workers;
-    std::deque<ThreadTask> pending_jobs;
-    std::atomic_bool is_active;
-    std::atomic_ullong pending_jobs_count;
-    std::atomic_ullong active_worker_count;
-    std::atomic_ullong unfinished_jobs_count;
+    ulong next_deque = 0;
 
    public:
     ThreadPool(ulong number_threads)
-        : workers(),
-          pending_jobs(),
-          is_active(true),
-          pending_jobs_count(0),
-          active_worker_count(0),
-          unfinished_jobs_count(0) {
+        : state(std::make_unique<ThreadPoolState<ThreadTask>>(
+              std::max(number_threads, 1ul), number_threads)),
+          workers() {
         for(ulong i = 0; i < number_threads; ++i) {
-            workers.emplace_back(is_active, pending_jobs, pending_jobs_count,
-                                 active_worker_count, unfinished_jobs_count);
+            workers.emplace_back(*state, i);
         }
     }
 
@@ -134,21 +363,88 @@ class ThreadPool {
     ThreadPool(const ThreadPool<ThreadTask>&) = delete;
     ThreadPool& operator=(const ThreadPool<ThreadTask>&) = delete;
 
+    ulong size() const { return workers.size(); }
+
+    // Pins worker i to cpu i + 1, wrapping around the hardware threads, so
+    // cpu 0 stays with the submitting thread that helps with the jobs.
+    bool pin_threads() {
+        ulong const num_cpus =
+            std::max(std::thread::hardware_concurrency(), 1u);
+        ulong cpu = 0;
+        for(ThreadWorker& worker : workers) {
+            cpu = (cpu + 1) % num_cpus;
+            if(!worker.pin(cpu)) return false;
+        }
+        SPDLOG_DEBUG("Pinned {} pool threads to {} cpus", workers.size(),
+                     num_cpus);
+        return true;
+    }
+
     void await_jobs() const {
-        while(unfinished_jobs_count > 0) {
-            std::this_thread::yield();
+        using Clock = PoolCounters::Clock;
+        PoolCounters& counters = state->counters[workers.size()];
+        ulong idx = 0;
+        while(true) {
+            unsigned const unfinished = state->unfinished_jobs_count.load();
+            if(unfinished == 0) return;
+
+            // pop the newest jobs while the workers steal the oldest
+            std::optional<ThreadTask> task;
+            for(ulong i = 0; i < state->deques.size() && !task; ++i) {
+                idx = (idx + 1) % state->deques.size();
+                task = state->deques[idx]->pop();
+            }
+            Clock::time_point const start = Clock::now();
+            if(task.has_value()) {
+                task->run();
+                PoolCounters::add(counters.busy_ns, start, Clock::now());
+                counters.jobs.fetch_add(1, std::memory_order_relaxed);
+                state->finish_job();
+            } else {
+                // every job is running on a worker
+                state->unfinished_jobs_count.wait(unfinished);
+                PoolCounters::add(counters.parked_ns, start, Clock::now());
+            }
         }
     }
 
     void submit_job(ThreadTask& task) {
-        ++unfinished_jobs_count;
-        ++pending_jobs_count;
-        std::scoped_lock lock(globals::threadpool_mutex);
-        pending_jobs.push_back(std::move(task));
+        state->unfinished_jobs_count.fetch_add(1);
+        ulong& max_depth = state->max_queue_depths[next_deque];
+        max_depth = std::max(max_depth, state->deques[next_deque]->push(task));
+        ++state->jobs_submitted;
+        next_deque = (next_deque + 1) % state->deques.size();
+        state->work_epoch.fetch_add(1);
+        if(state->num_sleeping.load() > 0) state->work_epoch.notify_one();
+    }
+
+    ThreadPoolStats stats() const {
+        ThreadPoolStats stats;
+        for(ulong i = 0; i < workers.size(); ++i) {
+            stats.workers.push_back(state->counters[i].load());
+            stats.workers.back().max_queue_depth = state->max_queue_depths[i];
+        }
+        stats.caller = state->counters[workers.size()].load();
+        for(ulong depth : state->max_queue_depths) {
+            stats.caller.max_queue_depth =
+                std::max(stats.caller.max_queue_depth, depth);
+        }
+        stats.jobs_submitted = state->jobs_submitted;
+        return stats;
+    }
+
+    void reset_stats() {
+        for(ulong i = 0; i <= workers.size(); ++i) state->counters[i].reset();
+        std::fill(state->max_queue_depths.begin(),
+                  state->max_queue_depths.end(), 0);
+        state->jobs_submitted = 0;
     }
 
     ~ThreadPool() {
-        is_active = false;
-        assert(pending_jobs.empty());
+        assert(state->unfinished_jobs_count == 0);
+        state->is_active = false;
+        state->work_epoch.fetch_add(1);
+        state->work_epoch.notify_all();
+        workers.clear();  // joins
     }
 };
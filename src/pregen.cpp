@@ -0,0 +1,66 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "app/arg_parse.hpp"
+#include "app/globals.hpp"
+#include "hardware/program_executor.hpp"
+#include "map/baked_world.hpp"
+#include "utils/thread_pool.hpp"
+
+// Bakes the regions and levels of a seeded world ahead of time into a file
+// the game maps at start-up with --baked_world - see BakedWorld
+
+static void help() {
+    std::cout << "Usage: ants_pregen --out <path> [options]\n";
+    std::cout << "Options:\n";
+    std::cout << "  --out <path>         File to write the baked world to\n";
+    std::cout << "  --seed_x <n>         Seeds of the origin region. default: 0\n";
+    std::cout << "  --seed_y <n>\n";
+    std::cout << "  --radius <n>         Regions baked around the origin region\n";
+    std::cout << "                        in each direction. default: 1\n";
+    std::cout << "  --min_depth <n>      Levels min_depth to max_depth are baked.\n";
+    std::cout << "  --max_depth <n>       default: 0 to 0\n";
+    std::cout << "  --threads <n>        Worker threads, a region per job.\n";
+    std::cout << "                        default: one per cpu besides this one\n";
+}
+
+int main(int argc, char* argv[]) {
+    ArgumentParser args(argc, argv);
+    if(args.hasKey("help") || !args.hasKey("out")) {
+        help();
+        return args.hasKey("help") ? 0 : 1;
+    }
+    BakeSpec spec;
+    spec.seed_x =
+        static_cast<uint32_t>(std::stoul(args.getString("seed_x", "0")));
+    spec.seed_y =
+        static_cast<uint32_t>(std::stoul(args.getString("seed_y", "0")));
+    spec.radius = args.getInt("radius", 1);
+    long const min_depth = args.getInt("min_depth", 0);
+    long const max_depth = args.getInt("max_depth", 0);
+    if(spec.radius < 0 || min_depth < 0 || max_depth < min_depth ||
+       max_depth >= static_cast<long>(globals::MAX_LEVEL_DEPTH)) {
+        std::cerr << "Invalid radius or depth range" << std::endl;
+        return 1;
+    }
+    spec.depth_begin = static_cast<ulong>(min_depth);
+    spec.depth_end = static_cast<ulong>(max_depth) + 1;
+    ulong const num_threads =
+        args.hasKey("threads")
+            ? static_cast<ulong>(args.getInt("threads"))
+            : default_thread_count();
+
+    ThreadPool<AsyncProgramJob> pool(num_threads);
+    std::string const& path = args.getString("out");
+    auto const start = std::chrono::steady_clock::now();
+    if(!BakedWorld::bake(path, spec, pool)) return 1;
+    auto const ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+    std::cout << "Baked " << spec.side() * spec.side() << " regions x "
+              << spec.num_levels() << " levels into " << path << " ("
+              << BakedWorld::file_words(spec) * sizeof(ulong) << " bytes) in "
+              << ms << " ms" << std::endl;
+    return 0;
+}
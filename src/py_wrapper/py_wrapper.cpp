@@ -1,6 +1,7 @@
 #include "app/facade.hpp"
 
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 namespace py = pybind11;
 
 PYBIND11_MODULE(ant_core, m){
@@ -14,8 +15,27 @@ PYBIND11_MODULE(ant_core, m){
         .def_readonly("event_index", &ReplayError::event_index)
         .def_readonly("event_kind", &ReplayError::event_kind);
 
+    py::class_<WorkerStats>(m, "WorkerStats")
+        .def_readonly("jobs", &WorkerStats::jobs)
+        .def_readonly("steals", &WorkerStats::steals)
+        .def_readonly("busy_ns", &WorkerStats::busy_ns)
+        .def_readonly("spin_ns", &WorkerStats::spin_ns)
+        .def_readonly("parked_ns", &WorkerStats::parked_ns)
+        .def_readonly("max_queue_depth", &WorkerStats::max_queue_depth)
+        .def("utilization", &WorkerStats::utilization);
+
+    py::class_<ThreadPoolStats>(m, "ThreadPoolStats")
+        .def_readonly("workers", &ThreadPoolStats::workers)
+        .def_readonly("caller", &ThreadPoolStats::caller)
+        .def_readonly("jobs_submitted", &ThreadPoolStats::jobs_submitted)
+        .def("utilization", &ThreadPoolStats::utilization)
+        .def("steal_ratio", &ThreadPoolStats::steal_ratio)
+        .def("caller_wait_ratio", &ThreadPoolStats::caller_wait_ratio)
+        .def("summary", &ThreadPoolStats::summary);
+
     py::class_<AntGameFacade>(m, "AntGameFacade")
         .def(py::init<>())   // our constructor
+        .def(py::init<std::vector<std::string> const&>(), py::arg("args"))
         .def("update", &AntGameFacade::update)
         .def("engine_update", &AntGameFacade::engine_update)
         .def("start_replay_recording",
@@ -30,6 +50,8 @@ PYBIND11_MODULE(ant_core, m){
         .def("replay_has_error", &AntGameFacade::replay_has_error)
         .def("replay_last_error", &AntGameFacade::replay_last_error)
         .def("replay_done", &AntGameFacade::replay_done)
+        .def("job_pool_stats", &AntGameFacade::job_pool_stats)
+        .def("reset_job_pool_stats", &AntGameFacade::reset_job_pool_stats)
         .def("action_move_player", &AntGameFacade::action_move_player)
         .def("action_dig", &AntGameFacade::action_dig)
         .def("action_create_ant", &AntGameFacade::action_create_ant)
@@ -1,4 +1,4 @@
-from typing import List
+from typing import List, overload
 
 
 class ReplayError:
@@ -10,10 +10,45 @@ class ReplayError:
     event_kind: str
 
 
+class WorkerStats:
+    jobs: int
+    steals: int
+    busy_ns: int
+    spin_ns: int
+    parked_ns: int
+    max_queue_depth: int
+
+    def utilization(self) -> float:
+        pass
+
+
+class ThreadPoolStats:
+    workers: List[WorkerStats]
+    caller: WorkerStats
+    jobs_submitted: int
+
+    def utilization(self) -> float:
+        pass
+
+    def steal_ratio(self) -> float:
+        pass
+
+    def caller_wait_ratio(self) -> float:
+        pass
+
+    def summary(self) -> List[str]:
+        pass
+
+
 class AntGameFacade:
+    @overload
     def __init__(self) -> None:
         pass
 
+    @overload
+    def __init__(self, args: List[str]) -> None:
+        pass
+
     def update(self) -> bool:
         pass
 
@@ -38,6 +73,12 @@ class AntGameFacade:
     def replay_done(self) -> bool:
         pass
 
+    def job_pool_stats(self) -> ThreadPoolStats:
+        pass
+
+    def reset_job_pool_stats(self) -> None:
+        pass
+
     def action_move_player(self, dx: int, dy: int) -> None:
         pass
 
@@ -16,7 +16,8 @@ class TestRenderer : public Renderer {
         tcod::ColorRGB bg = color::black;
     };
 
-    void render_map(LayoutBox const&, Map& map, MapWindow const& window) override {
+    void render_map(LayoutBox const&, Map const& map,
+                    MapWindow const& window) override {
         ensure_tiles(window);
         for(long local_x = 0; local_x < window.border.w; ++local_x) {
             for(long local_y = 0; local_y < window.border.h; ++local_y) {
@@ -32,14 +33,14 @@ class TestRenderer : public Renderer {
         }
     }
 
-    void render_ant(LayoutBox const&, Map& map, EntityData& a,
+    void render_ant(LayoutBox const&, Map const& map, EntityData& a,
                     MapWindow const& window) override {
         long local_x = 0;
         long local_y = 0;
         bool is_valid = false;
         window.to_local_coords(a.x, a.y, local_x, local_y, is_valid);
         if(!is_valid) return;
-        if(!map.in_fov(a.x, a.y)) return;
+        if(!map.read_tile(a.x, a.y).in_fov) return;
 
         TileState& tile = tiles[local_index(local_x, local_y)];
         tile.ch = a.ch;
@@ -68,6 +69,8 @@ class TestRenderer : public Renderer {
         sidebar_rendered = true;
         render_sidebar_tiles(box, menu);
     }
+    void render_sidebar_stats(LayoutBox const&,
+                              std::vector<std::string> const&) override {}
     void render_toggle_button(bool expanded) override {
         toggle_button_rendered = true;
         toggle_button_expanded = expanded;
@@ -252,36 +255,35 @@ class TestRenderer : public Renderer {
         return static_cast<size_t>(local_y * last_window_border.w + local_x);
     }
 
-    tcod::ColorRGB get_default_bg(Map& map, long x, long y) const {
+    tcod::ColorRGB get_default_bg(Map const& map, long x, long y) const {
         const tcod::ColorRGB dark_wall = color::light_black;
         const tcod::ColorRGB dark_ground = color::dark_grey;
         const tcod::ColorRGB light_wall = color::indian_red;
         const tcod::ColorRGB light_ground = color::grey;
 
-        if(map.in_fov(x, y)) {
-            return map.is_wall(x, y) ? light_wall : light_ground;
+        TileSnapshot const tile = map.read_tile(x, y);
+        if(tile.in_fov) {
+            return tile.is_wall ? light_wall : light_ground;
         }
 
-        return map.is_wall(x, y) || !map.is_explored(x, y) ? dark_wall
-                                                           : dark_ground;
+        return tile.is_wall || !tile.is_explored ? dark_wall : dark_ground;
     }
 
-    tcod::ColorRGB get_scent_bg(Map& map, long x, long y) const {
+    tcod::ColorRGB get_scent_bg(Map const& map, long x, long y) const {
         const tcod::ColorRGB dark_wall = color::light_black;
         const tcod::ColorRGB dark_ground = color::dark_grey;
         const tcod::ColorRGB light_wall = color::indian_red;
 
-        ulong scents = map.get_tile_scents_by_coord(x, y);
-        unsigned char scent =
-            static_cast<unsigned char>(static_cast<signed char>(scents >> scent_index));
+        TileSnapshot const tile = map.read_tile(x, y);
+        unsigned char scent = static_cast<unsigned char>(
+            static_cast<signed char>(tile.scents >> scent_index));
         const tcod::ColorRGB scent_color{scent, scent, scent};
 
-        if(map.in_fov(x, y)) {
-            return map.is_wall(x, y) ? light_wall : scent_color;
+        if(tile.in_fov) {
+            return tile.is_wall ? light_wall : scent_color;
         }
 
-        return map.is_wall(x, y) || !map.is_explored(x, y) ? dark_wall
-                                                           : dark_ground;
+        return tile.is_wall || !tile.is_explored ? dark_wall : dark_ground;
     }
 
     RenderMode render_mode = RenderMode::DEFAULT;
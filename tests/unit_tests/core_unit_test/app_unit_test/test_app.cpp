@@ -52,6 +52,20 @@ TEST(AppProjectArgumentsTest, ParsesCliFlags) {
     EXPECT_FALSE(args.is_walls_enabled);
 }
 
+TEST(AppProjectArgumentsTest, ParsesThreadCount) {
+    ProjectArguments inline_args({"--threads", "0", "--pin_threads"});
+    EXPECT_EQ(inline_args.num_threads, 0u);
+    EXPECT_TRUE(inline_args.is_pinning_threads);
+
+    ProjectArguments explicit_args({"--no_render", "--threads", "12"});
+    EXPECT_EQ(explicit_args.num_threads, 12u);
+    EXPECT_FALSE(explicit_args.is_render);
+
+    ProjectArguments auto_args({"--threads", "auto"});
+    EXPECT_EQ(auto_args.num_threads, default_thread_count());
+    EXPECT_FALSE(auto_args.is_pinning_threads);
+}
+
 static std::string make_temp_path(const std::string& prefix,
                                   const SaveRestoreSeed& seed) {
     auto ts = std::chrono::steady_clock::now().time_since_epoch().count();
@@ -1,9 +1,14 @@
 #include <gtest/gtest.h>
 
+#include <memory>
+#include <vector>
+
 #include "hardware/hardware_manager.hpp"
+#include "hardware/machine_code.hpp"
 #include "hardware/command_config.hpp"
 #include "hardware/compile_args.hpp"
 #include "hardware/brain.hpp"
+#include "hardware/parser.hpp"
 #include "hardware/program_executor.hpp"
 #include "utils/thread_pool.hpp"
 
@@ -73,3 +78,168 @@ TEST(HardwareManagerTest, PushBackSupportsMultipleExecutors) {
 
     EXPECT_EQ(std::distance(manager.begin(), manager.end()), 2);
 }
+
+TEST(HardwareManagerTest, GetProgramSharesIdenticalMachineCode) {
+    CommandMap map;
+    HardwareManager manager(map);
+    MachineCode code_a, code_b, code_c;
+    code_a.code = {static_cast<uchar>(CommandEnum::MOVE << 3),
+                   static_cast<uchar>(CommandEnum::LT << 3)};
+    code_b.code = code_a.code;
+    code_c.code = {static_cast<uchar>(CommandEnum::DIG << 3)};
+
+    Status status;
+    DecodedProgram const* program_a = manager.get_program(code_a, status);
+    DecodedProgram const* program_b = manager.get_program(code_b, status);
+    DecodedProgram const* program_c = manager.get_program(code_c, status);
+
+    EXPECT_FALSE(status.p_err);
+    ASSERT_NE(program_a, nullptr);
+    EXPECT_EQ(program_a, program_b);
+    EXPECT_NE(program_a, program_c);
+    EXPECT_EQ(program_a->size(), 2u);
+    EXPECT_EQ(program_c->size(), 1u);
+    EXPECT_EQ(manager.num_programs(), 2u);
+}
+
+TEST(HardwareManagerTest, SharedProgramRunsAgainstEachAntsRegisters) {
+    CommandMap map;
+    HardwareManager manager(map);
+    MachineCode code;
+    code.code = {static_cast<uchar>(CommandEnum::INC << 3),
+                 static_cast<uchar>(CommandEnum::MOVE << 3)};
+
+    Status status;
+    DecodedProgram const* program = manager.get_program(code, status);
+    ASSERT_NE(program, nullptr);
+
+    ulong instr_clock = 0;
+    ThreadPool<AsyncProgramJob> pool(1);
+    DualRegisters cpu_a, cpu_b;
+    cpu_b[0] = 41;
+    ProgramExecutor exec_a(instr_clock, 10, cpu_a.instr_ptr_register, pool);
+    ProgramExecutor exec_b(instr_clock, 10, cpu_b.instr_ptr_register, pool);
+    exec_a.use_decoded(cpu_a, *program);
+    exec_b.use_decoded(cpu_b, *program);
+
+    exec_a.run_async();
+    exec_b.run_async();
+
+    EXPECT_EQ(cpu_a[0], 1u);
+    EXPECT_EQ(cpu_b[0], 42u);
+    EXPECT_EQ(cpu_a.instr_ptr_register, 1);
+    EXPECT_EQ(cpu_b.instr_ptr_register, 1);
+}
+
+// Runs one executor through the manager's ready list and timer wheel and a
+// copy on its own every tick, the way PrimaryMode::update did before the
+// timer wheel.
+TEST(HardwareManagerTest, TimerWheelKeepsWaitTicks) {
+    CommandMap map;
+    HardwareManager manager(map);
+    Parser parser(map);
+    MachineCode code;
+    Status status;
+    parser.parse({"top:", "INC A", "DIG", "INC B", "MOVE", "JMP top"}, code,
+                 status);
+    ASSERT_FALSE(status.p_err);
+    DecodedProgram const* program = manager.get_program(code, status);
+    ASSERT_NE(program, nullptr);
+
+    ulong instr_clock = 0;
+    ThreadPool<AsyncProgramJob> pool(1);
+    DualRegisters cpu, reference_cpu;
+    ProgramExecutor exec(instr_clock, 10, cpu.instr_ptr_register, pool);
+    ProgramExecutor reference(instr_clock, 10,
+                              reference_cpu.instr_ptr_register, pool);
+    exec.use_decoded(cpu, *program);
+    reference.use_decoded(reference_cpu, *program);
+    manager.push_back(&exec);
+
+    ulong num_idle_ticks = 0;
+    for(int tick = 0; tick < 100; ++tick) {
+        manager.begin_tick();
+        num_idle_ticks += manager.ready().empty();
+        for(ProgramExecutor* ready : manager.ready()) {
+            ready->reset();
+            ready->execute_async();
+        }
+        reference.reset();
+        reference.execute_async();
+        pool.await_jobs();
+        for(ProgramExecutor* ready : manager.ready()) ready->execute_sync();
+        reference.execute_sync();
+        manager.end_tick();
+
+        manager.store_wait_ticks();
+        ASSERT_EQ(cpu.instr_ptr_register, reference_cpu.instr_ptr_register)
+            << "tick " << tick;
+        ASSERT_EQ(cpu[0], reference_cpu[0]) << "tick " << tick;
+        ASSERT_EQ(cpu[1], reference_cpu[1]) << "tick " << tick;
+        ASSERT_EQ(exec.instr_trigger, reference.instr_trigger)
+            << "tick " << tick;
+    }
+    // the executor sat out most ticks waiting for the DIG and the MOVE
+    EXPECT_GT(num_idle_ticks, 70u);
+}
+
+TEST(HardwareManagerTest, AdaptiveJobSpanScalesWithAntsAndThreads) {
+    // small colonies are not split below the minimum span
+    EXPECT_EQ(HardwareManager::adaptive_job_span(10, 8), 16u);
+    EXPECT_EQ(HardwareManager::adaptive_job_span(10000, 8), 313u);
+    EXPECT_EQ(HardwareManager::adaptive_job_span(10000, 1), 2500u);
+    EXPECT_EQ(HardwareManager::adaptive_job_span(10000, 0), 2500u);
+}
+
+TEST(HardwareManagerTest, JobSpansRunEveryReadyExecutor) {
+    CommandMap map;
+    HardwareManager manager(map);
+    manager.set_job_span(7);
+    Parser parser(map);
+    MachineCode code;
+    Status status;
+    parser.parse({"top:", "INC A", "CHK", "JNF top", "MOVE", "JMP top"},
+                 code, status);
+    ASSERT_FALSE(status.p_err);
+    DecodedProgram const* program = manager.get_program(code, status);
+    ASSERT_NE(program, nullptr);
+
+    ulong const num_ants = 100;
+    ulong instr_clock = 0;
+    ThreadPool<AsyncProgramJob> pool(3);
+    std::vector<DualRegisters> cpus(num_ants), reference_cpus(num_ants);
+    std::vector<std::unique_ptr<ProgramExecutor>> execs, references;
+    for(ulong i = 0; i < num_ants; ++i) {
+        cpus[i].is_space_empty_flags = reference_cpus[i].is_space_empty_flags =
+            static_cast<uchar>(i % 16);
+        execs.push_back(std::make_unique<ProgramExecutor>(
+            instr_clock, 10, cpus[i].instr_ptr_register, pool));
+        execs.back()->use_decoded(cpus[i], *program);
+        manager.push_back(execs.back().get());
+        references.push_back(std::make_unique<ProgramExecutor>(
+            instr_clock, 10, reference_cpus[i].instr_ptr_register, pool));
+        references.back()->use_decoded(reference_cpus[i], *program);
+    }
+
+    for(int tick = 0; tick < 50; ++tick) {
+        manager.begin_tick();
+        for(ProgramExecutor* exec : manager.ready()) exec->reset();
+        manager.execute_async_spans(pool);
+        for(auto& reference : references) {
+            reference->reset();
+            reference->execute_async();
+        }
+        pool.await_jobs();
+        for(ProgramExecutor* exec : manager.ready()) exec->execute_sync();
+        for(auto& reference : references) reference->execute_sync();
+        manager.end_tick();
+
+        for(ulong i = 0; i < num_ants; ++i) {
+            ASSERT_EQ(cpus[i].instr_ptr_register,
+                      reference_cpus[i].instr_ptr_register)
+                << "ant " << i << " tick " << tick;
+            ASSERT_EQ(cpus[i][0], reference_cpus[i][0])
+                << "ant " << i << " tick " << tick;
+        }
+    }
+}
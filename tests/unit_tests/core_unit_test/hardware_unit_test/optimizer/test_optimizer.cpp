@@ -0,0 +1,226 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hardware/batch_executor.hpp"
+#include "hardware/brain.hpp"
+#include "hardware/command_config.hpp"
+#include "hardware/compile_args.hpp"
+#include "hardware/compiler.hpp"
+#include "hardware/machine_code.hpp"
+#include "hardware/optimizer.hpp"
+#include "hardware/parser.hpp"
+#include "hardware/program_executor.hpp"
+#include "utils/thread_pool.hpp"
+
+namespace {
+DecodedProgram decode(std::vector<std::string> const& lines) {
+    CommandMap command_map;
+    Parser parser(command_map);
+    Compiler compiler(command_map);
+    MachineCode code;
+    Status status;
+    parser.parse(lines, code, status);
+    EXPECT_FALSE(status.p_err);
+
+    DualRegisters cpu;
+    std::vector<Op> ops;
+    DecodedProgram program;
+    CompileArgs args(code.code, cpu, ops, program.instructions);
+    compiler.compile(args);
+    EXPECT_FALSE(args.status.p_err);
+    return program;
+}
+
+std::vector<OpCode> opcodes(DecodedProgram const& program) {
+    std::vector<OpCode> result;
+    for(Instruction const& instr : program.instructions) {
+        result.push_back(instr.opcode);
+    }
+    return result;
+}
+
+void expect_same_state(DualRegisters const& expected,
+                       DualRegisters const& actual, int tick) {
+    EXPECT_EQ(expected.instr_ptr_register, actual.instr_ptr_register)
+        << "tick " << tick;
+    EXPECT_EQ(expected[0], actual[0]) << "tick " << tick;
+    EXPECT_EQ(expected[1], actual[1]) << "tick " << tick;
+    EXPECT_EQ(expected.zero_flag, actual.zero_flag) << "tick " << tick;
+    EXPECT_EQ(expected.dir_flag1, actual.dir_flag1) << "tick " << tick;
+    EXPECT_EQ(expected.dir_flag2, actual.dir_flag2) << "tick " << tick;
+    EXPECT_EQ(expected.is_move_flag, actual.is_move_flag) << "tick " << tick;
+    EXPECT_EQ(expected.stack_ptr_register, actual.stack_ptr_register)
+        << "tick " << tick;
+    EXPECT_EQ(expected.base_ptr_register, actual.base_ptr_register)
+        << "tick " << tick;
+}
+}  // namespace
+
+TEST(OptimizerTest, FusesSequencesInPlace) {
+    DecodedProgram program = decode({
+        "LT", "LT", "RT", "MOVE", "PUSH A", "POP B", "top:", "DEC A",
+        "JNZ top",
+    });
+    ulong const size = program.size();
+    optimize(program.instructions, OptimizerPasses());
+
+    // the covered instructions stay so jumps into the sequence still work
+    ASSERT_EQ(program.size(), size);
+    std::vector<OpCode> const expected = {
+        OpCode::TURN_AROUND, OpCode::LT,  OpCode::RT_MOVE,
+        OpCode::MOVE,        OpCode::PUSH_POP, OpCode::POP,
+        OpCode::DEC_JNZ,     OpCode::JNZ,
+    };
+    EXPECT_EQ(opcodes(program), expected);
+    EXPECT_EQ(program.instructions[0].skip, 1);
+    EXPECT_EQ(program.instructions[2].num_ticks,
+              program.instructions[3].num_ticks);
+    EXPECT_EQ(program.instructions[4].arg0, 0);
+    EXPECT_EQ(program.instructions[4].arg1, 1);
+    EXPECT_EQ(program.instructions[6].address, program.instructions[7].address);
+}
+
+TEST(OptimizerTest, DisabledPassesLeaveProgramUntouched) {
+    std::vector<std::string> const lines = {
+        "NOP", "NOP", "LT",  "LT",      "LOAD A 1", "JNZ end",
+        "INC B", "JNZ end", "end:", "JMP next", "next:", "MOVE",
+    };
+    DecodedProgram const original = decode(lines);
+    DecodedProgram program = decode(lines);
+    optimize(program.instructions, OptimizerPasses::none());
+    EXPECT_EQ(opcodes(program), opcodes(original));
+
+    OptimizerPasses only_turns = OptimizerPasses::none();
+    only_turns.fuse_turns = true;
+    optimize(program.instructions, only_turns);
+    std::vector<OpCode> expected = opcodes(original);
+    expected[2] = OpCode::TURN_AROUND;
+    EXPECT_EQ(opcodes(program), expected);
+}
+
+TEST(OptimizerTest, FoldsKnownZeroFlag) {
+    DecodedProgram program = decode({
+        "LOAD A 5", "JNZ end", "LOAD B 0", "JNZ end", "end:", "MOVE",
+    });
+    optimize(program.instructions, OptimizerPasses());
+
+    EXPECT_EQ(program.instructions[0].opcode, OpCode::LOAD_JMP);
+    EXPECT_EQ(program.instructions[0].address, program.instructions[1].address);
+    // a zero constant never takes the jump - the LOAD just skips it
+    EXPECT_EQ(program.instructions[2].opcode, OpCode::LOAD);
+    EXPECT_EQ(program.instructions[2].skip, 1);
+}
+
+TEST(OptimizerTest, ThreadsJumpsToJumps) {
+    DecodedProgram program = decode({
+        "start:", "JNZ a", "a:", "JMP b", "b:", "JMP c", "c:", "MOVE",
+        "loop:", "JMP loop",
+    });
+    optimize(program.instructions, OptimizerPasses());
+
+    // every jump lands on the MOVE - stored as target - 1
+    EXPECT_EQ(program.instructions[0].address, 2);
+    EXPECT_EQ(program.instructions[1].address, 2);
+    EXPECT_EQ(program.instructions[2].address, 2);
+    // a jump to itself is left alone
+    EXPECT_EQ(program.instructions[4].address, 3);
+}
+
+// A NOP chain waits exactly as long as the single merged NOP.
+TEST(OptimizerTest, MergedNopsKeepTiming) {
+    std::vector<std::string> const lines = {"NOP", "NOP", "NOP", "INC A",
+                                            "MOVE"};
+    DecodedProgram plain = decode(lines);
+    DecodedProgram merged = decode(lines);
+    OptimizerPasses only_nops = OptimizerPasses::none();
+    only_nops.merge_nops = true;
+    optimize(merged.instructions, only_nops);
+    plain.build_blocks();
+    merged.build_blocks();
+    ASSERT_EQ(merged.instructions[0].skip, 2);
+
+    ulong instr_clock = 0;
+    ThreadPool<AsyncProgramJob> job_pool(1);
+    DualRegisters plain_cpu, merged_cpu;
+    ProgramExecutor plain_exec(instr_clock, 100, plain_cpu.instr_ptr_register,
+                               job_pool);
+    ProgramExecutor merged_exec(instr_clock, 100,
+                                merged_cpu.instr_ptr_register, job_pool);
+    plain_exec.use_decoded(plain_cpu, plain);
+    merged_exec.use_decoded(merged_cpu, merged);
+
+    int plain_tick = -1, merged_tick = -1;
+    for(int tick = 0; tick < 20; ++tick) {
+        for(ProgramExecutor* exec : {&plain_exec, &merged_exec}) {
+            exec->reset();
+            exec->execute_async();
+            job_pool.await_jobs();
+            exec->execute_sync();
+        }
+        if(plain_tick < 0 && plain_cpu.is_move_flag) plain_tick = tick;
+        if(merged_tick < 0 && merged_cpu.is_move_flag) merged_tick = tick;
+    }
+    EXPECT_EQ(plain_tick, 6);
+    EXPECT_EQ(merged_tick, plain_tick);
+    expect_same_state(plain_cpu, merged_cpu, 20);
+}
+
+// Runs the program unoptimized, optimized and optimized in a ProgramBatch.
+// The budget is large enough that every tick ends on a sync instruction, so
+// the fused sequences leave the same state at the end of every tick.
+TEST(OptimizerTest, OptimizedProgramMatchesUnoptimized) {
+    std::vector<std::string> const lines = {
+        "start:",   "LOAD B 3", "LOAD A 1", "JNZ body", "NOP",
+        "body:",    "LT",       "LT",       "MOVE",     "PUSH B",
+        "POP A",    "CALL sub", "DEC B",    "JNZ body", "LOAD A 0",
+        "JNZ start", "INC A",   "JNZ hop",  "JMP start", "hop:",
+        "JMP start", "sub:",    "RT",       "MOVE",     "RET",
+    };
+    DecodedProgram plain = decode(lines);
+    DecodedProgram optimized = decode(lines);
+    OptimizerPasses passes;
+    passes.merge_nops = false;  // changes the instruction pointer mid wait
+    optimize(optimized.instructions, passes);
+    plain.build_blocks();
+    optimized.build_blocks();
+
+    ulong instr_clock = 0;
+    ThreadPool<AsyncProgramJob> job_pool(1);
+    DualRegisters plain_cpu, optimized_cpu, batch_cpu;
+    ProgramExecutor plain_exec(instr_clock, 1000, plain_cpu.instr_ptr_register,
+                               job_pool);
+    ProgramExecutor optimized_exec(instr_clock, 1000,
+                                   optimized_cpu.instr_ptr_register, job_pool);
+    ProgramExecutor batch_exec(instr_clock, 1000, batch_cpu.instr_ptr_register,
+                               job_pool);
+    plain_exec.use_decoded(plain_cpu, plain);
+    optimized_exec.use_decoded(optimized_cpu, optimized);
+    batch_exec.use_decoded(batch_cpu, optimized);
+
+    BatchExecutor batch_executor;
+    for(int tick = 0; tick < 300; ++tick) {
+        plain_exec.reset();
+        plain_exec.execute_async();
+        optimized_exec.reset();
+        optimized_exec.execute_async();
+        batch_executor.clear();
+        batch_exec.reset();
+        if(batch_exec.begin_async()) batch_executor.add(batch_exec);
+        for(ProgramBatch& batch : batch_executor) batch.run();
+        job_pool.await_jobs();
+        plain_exec.execute_sync();
+        optimized_exec.execute_sync();
+        batch_exec.execute_sync();
+
+        expect_same_state(plain_cpu, optimized_cpu, tick);
+        expect_same_state(plain_cpu, batch_cpu, tick);
+        ASSERT_EQ(plain_exec.instr_trigger, optimized_exec.instr_trigger);
+        ASSERT_EQ(plain_exec.instr_trigger, batch_exec.instr_trigger);
+        for(DualRegisters* cpu : {&plain_cpu, &optimized_cpu, &batch_cpu}) {
+            cpu->is_move_flag = false;
+        }
+    }
+}
@@ -8,6 +8,13 @@
 #include <chrono>
 #include <cstdlib>
 
+#include "hardware/batch_executor.hpp"
+#include "hardware/brain.hpp"
+#include "hardware/command_config.hpp"
+#include "hardware/compile_args.hpp"
+#include "hardware/compiler.hpp"
+#include "hardware/machine_code.hpp"
+#include "hardware/parser.hpp"
 #include "hardware/program_executor.hpp"
 #include "utils/thread_pool.hpp"
 #include "assembly_program_builder.hpp"
@@ -418,3 +425,337 @@ TEST_F(ProgramExecutorTest, ResetFunctionality) {
 
     SPDLOG_DEBUG("Reset functionality test completed successfully");
 }
+
+// Compiles the program for both execution modes, runs it tick by tick and
+// checks the decoded interpreter leaves the registers exactly like the
+// closure ops do.
+TEST_F(ProgramExecutorTest, DecodedModeMatchesClosureMode) {
+    SPDLOG_INFO("Starting DecodedModeMatchesClosureMode test");
+
+    std::vector<std::string> const lines = {
+        "LOAD A 3", "LOAD B 7",    "top:",    "INC B",   "PUSH B",
+        "RT",       "CALL turn",   "POP A",   "SUB A B", "SWN C",
+        "SWP C 9",  "CHK",         "JNF skip", "DEC A",   "skip:",
+        "MOVE",     "DIG",         "JNZ top", "JMP top", "turn:",
+        "LT",       "LT",          "SRT",     "SWF",     "RET",
+    };
+    CommandMap command_map;
+    Parser parser(command_map);
+    Compiler compiler(command_map);
+    MachineCode code;
+    Status status;
+    parser.parse(lines, code, status);
+    ASSERT_FALSE(status.p_err);
+
+    DualRegisters closure_cpu, decoded_cpu;
+    decoded_cpu.is_space_empty_flags = closure_cpu.is_space_empty_flags = 0b0101;
+    ProgramExecutor closure_exec(instr_clock, max_instructions_per_tick,
+                                 closure_cpu.instr_ptr_register, *job_pool);
+    ProgramExecutor decoded_exec(instr_clock, max_instructions_per_tick,
+                                 decoded_cpu.instr_ptr_register, *job_pool);
+
+    CompileArgs closure_args(code.code, closure_cpu, closure_exec._ops);
+    compiler.compile(closure_args);
+    DecodedProgram program;
+    CompileArgs decoded_args(code.code, decoded_cpu, decoded_exec._ops,
+                             program.instructions);
+    compiler.compile(decoded_args);
+    program.build_blocks();
+    decoded_exec.use_decoded(decoded_cpu, program);
+
+    ASSERT_TRUE(decoded_exec._ops.empty());
+    ASSERT_EQ(closure_exec.size(), decoded_exec.size());
+
+    for(int tick = 0; tick < 200; ++tick) {
+        for(ProgramExecutor* exec : {&closure_exec, &decoded_exec}) {
+            exec->reset();
+            exec->execute_async();
+        }
+        waitForAsyncCompletion();
+        closure_exec.execute_sync();
+        decoded_exec.execute_sync();
+        closure_cpu.is_move_flag = decoded_cpu.is_move_flag = false;
+        closure_cpu.is_dig_flag = decoded_cpu.is_dig_flag = false;
+
+        ASSERT_EQ(closure_cpu.instr_ptr_register,
+                  decoded_cpu.instr_ptr_register) << "tick " << tick;
+        ASSERT_EQ(closure_cpu[0], decoded_cpu[0]) << "tick " << tick;
+        ASSERT_EQ(closure_cpu[1], decoded_cpu[1]) << "tick " << tick;
+        ASSERT_EQ(closure_cpu.zero_flag, decoded_cpu.zero_flag);
+        ASSERT_EQ(closure_cpu.instr_failed_flag, decoded_cpu.instr_failed_flag);
+        ASSERT_EQ(closure_cpu.dir_flag1, decoded_cpu.dir_flag1);
+        ASSERT_EQ(closure_cpu.dir_flag2, decoded_cpu.dir_flag2);
+        ASSERT_EQ(closure_cpu.stack_ptr_register,
+                  decoded_cpu.stack_ptr_register);
+        ASSERT_EQ(closure_cpu.base_ptr_register, decoded_cpu.base_ptr_register);
+        ASSERT_EQ(closure_cpu.scent_behaviors.priorities,
+                  decoded_cpu.scent_behaviors.priorities);
+        ASSERT_EQ(closure_exec.instr_trigger, decoded_exec.instr_trigger);
+    }
+
+    SPDLOG_DEBUG("Decoded mode matched closure mode for 200 ticks");
+}
+
+TEST_F(ProgramExecutorTest, DecodedModeStopsAtSyncInstruction) {
+    SPDLOG_INFO("Starting DecodedModeStopsAtSyncInstruction test");
+
+    DualRegisters cpu;
+    ProgramExecutor exec(instr_clock, max_instructions_per_tick,
+                         cpu.instr_ptr_register, *job_pool);
+    DecodedProgram program;
+    program.instructions = {
+        {.opcode = OpCode::INC, .arg0 = 0},
+        {.opcode = OpCode::LT},
+        {.opcode = OpCode::MOVE, .num_ticks = 12},
+        {.opcode = OpCode::INC, .arg0 = 1},
+    };
+    program.build_blocks();
+    exec.use_decoded(cpu, program);
+
+    exec.execute_async();
+    waitForAsyncCompletion();
+    EXPECT_EQ(cpu.instr_ptr_register, 2);
+    EXPECT_EQ(cpu[0], 1u);
+    EXPECT_TRUE(exec.is_sync());
+
+    exec.execute_sync();
+    EXPECT_EQ(cpu.instr_ptr_register, 3);
+    EXPECT_TRUE(cpu.is_move_flag);
+    EXPECT_EQ(exec.instr_trigger, 12u);
+    EXPECT_EQ(cpu[1], 0u);
+
+    SPDLOG_DEBUG("Decoded sync instruction handled correctly");
+}
+
+TEST_F(ProgramExecutorTest, DecodedProgramSplitsBasicBlocks) {
+    SPDLOG_INFO("Starting DecodedProgramSplitsBasicBlocks test");
+
+    DecodedProgram program;
+    program.instructions = {
+        {.opcode = OpCode::INC, .arg0 = 0},
+        {.opcode = OpCode::LT},
+        {.opcode = OpCode::MOVE, .num_ticks = 12},
+        {.opcode = OpCode::INC, .arg0 = 1},
+        {.opcode = OpCode::JNZ, .address = 0xFFFF},  // jumps to 0
+        {.opcode = OpCode::DEC, .arg0 = 0},
+    };
+    program.build_blocks();
+
+    ASSERT_EQ(program.blocks.size(), 3u);
+    BasicBlock const& first = program.blocks[0];
+    EXPECT_EQ(first.start, 0);
+    EXPECT_EQ(first.length, 3);
+    EXPECT_TRUE(first.ends_in_sync);
+    EXPECT_EQ(first.successors[0], BasicBlock::no_successor);
+    EXPECT_EQ(first.successors[1], 3);
+
+    BasicBlock const& loop = program.blocks[1];
+    EXPECT_EQ(loop.start, 3);
+    EXPECT_EQ(loop.length, 2);
+    EXPECT_FALSE(loop.ends_in_sync);
+    EXPECT_EQ(loop.successors[0], 0);
+    EXPECT_EQ(loop.successors[1], 5);
+
+    // falls off the end of the program
+    EXPECT_EQ(program.blocks[2].successors[1], BasicBlock::no_successor);
+
+    std::vector<ushort> const async_run = {2, 1, 0, 2, 1, 1};
+    EXPECT_EQ(program.async_run, async_run);
+    std::vector<ushort> const block_index = {0, 0, 0, 1, 1, 2};
+    EXPECT_EQ(program.block_index, block_index);
+}
+
+TEST_F(ProgramExecutorTest, BlockRunnerResumesAfterBudget) {
+    SPDLOG_INFO("Starting BlockRunnerResumesAfterBudget test");
+
+    DecodedProgram program;
+    program.instructions = {
+        {.opcode = OpCode::INC, .arg0 = 0},
+        {.opcode = OpCode::INC, .arg0 = 0},
+        {.opcode = OpCode::INC, .arg0 = 0},
+        {.opcode = OpCode::INC, .arg0 = 0},
+        {.opcode = OpCode::INC, .arg0 = 0},
+        {.opcode = OpCode::MOVE, .num_ticks = 12},
+    };
+    program.build_blocks();
+    program.is_profiled = true;
+
+    DualRegisters cpu;
+    EXPECT_EQ(interpret_async(program, cpu, 3), 3u);
+    EXPECT_EQ(cpu.instr_ptr_register, 3);
+    EXPECT_EQ(cpu[0], 3u);
+
+    // stops in front of the MOVE
+    EXPECT_EQ(interpret_async(program, cpu, 10), 2u);
+    EXPECT_EQ(cpu.instr_ptr_register, 5);
+    EXPECT_EQ(cpu[0], 5u);
+    EXPECT_EQ(interpret_async(program, cpu, 10), 0u);
+
+    // entered once and resumed once
+    EXPECT_EQ(program.block_executions[0].load(), 2u);
+}
+
+TEST_F(ProgramExecutorTest, ParksAntPollingBlockedSpace) {
+    SPDLOG_INFO("Starting ParksAntPollingBlockedSpace test");
+
+    DualRegisters cpu;
+    cpu.is_space_empty_flags = 0;  // boxed in
+    ProgramExecutor exec(instr_clock, max_instructions_per_tick,
+                         cpu.instr_ptr_register, *job_pool);
+    DecodedProgram program;
+    program.instructions = {
+        {.opcode = OpCode::CHECK},
+        {.opcode = OpCode::JNF, .address = 2},     // jumps to 3
+        {.opcode = OpCode::JMP, .address = 0xFFFF},  // jumps to 0
+        {.opcode = OpCode::MOVE, .num_ticks = 12},
+    };
+    program.build_blocks();
+    exec.use_decoded(cpu, program);
+
+    auto tick = [&]() {
+        exec.reset();
+        exec.execute_async();
+        waitForAsyncCompletion();
+        exec.execute_sync();
+    };
+
+    // the first tick spends the budget, the second finds the cycle
+    tick();
+    EXPECT_FALSE(exec.is_parked);
+    EXPECT_TRUE(exec.is_watching_cycle);
+    tick();
+    ASSERT_TRUE(exec.is_parked);
+
+    ushort const parked_instr_ptr = cpu.instr_ptr_register;
+    for(int i = 0; i < 5; ++i) tick();
+    EXPECT_EQ(cpu.instr_ptr_register, parked_instr_ptr);
+    EXPECT_FALSE(cpu.is_move_flag);
+
+    // the space on the right frees up
+    cpu.is_space_empty_flags = 0b0001;
+    exec.wake();
+    tick();
+    tick();
+    EXPECT_FALSE(exec.is_parked);
+    EXPECT_TRUE(cpu.is_move_flag);
+}
+
+TEST_F(ProgramExecutorTest, DoesNotParkTerminatingLoop) {
+    SPDLOG_INFO("Starting DoesNotParkTerminatingLoop test");
+
+    DualRegisters cpu;
+    ProgramExecutor exec(instr_clock, max_instructions_per_tick,
+                         cpu.instr_ptr_register, *job_pool);
+    DecodedProgram program;
+    program.instructions = {
+        {.opcode = OpCode::LOAD, .arg0 = 0, .value = 30},
+        {.opcode = OpCode::DEC, .arg0 = 0},
+        {.opcode = OpCode::JNZ, .address = 0},  // jumps to 1
+        {.opcode = OpCode::MOVE, .num_ticks = 12},
+    };
+    program.build_blocks();
+    exec.use_decoded(cpu, program);
+
+    for(int i = 0; i < 10 && !cpu.is_move_flag; ++i) {
+        exec.reset();
+        exec.execute_async();
+        waitForAsyncCompletion();
+        exec.execute_sync();
+        EXPECT_FALSE(exec.is_parked);
+    }
+    EXPECT_TRUE(cpu.is_move_flag);
+    EXPECT_EQ(cpu[0], 0u);
+}
+
+// Runs the same program for ants that start with different registers and
+// surroundings so their instruction pointers diverge, and checks the batched
+// lanes end every tick exactly like the ants run one by one.
+TEST_F(ProgramExecutorTest, BatchModeMatchesDecodedMode) {
+    SPDLOG_INFO("Starting BatchModeMatchesDecodedMode test");
+
+    std::vector<std::string> const lines = {
+        "top:",     "INC B",     "COPY B A",  "CHK",     "JNF blocked",
+        "LT",       "ADD B A",   "JNZ moved", "blocked:", "RT",
+        "PUSH B",   "CALL turn", "POP A",     "SUB A B", "moved:",
+        "MOVE",     "DEC A",     "JNZ top",   "DIG",     "JMP top",
+        "turn:",    "LT",        "SWN C",     "SWF",     "RET",
+    };
+    CommandMap command_map;
+    Parser parser(command_map);
+    Compiler compiler(command_map);
+    MachineCode code;
+    Status status;
+    parser.parse(lines, code, status);
+    ASSERT_FALSE(status.p_err);
+
+    DualRegisters decode_cpu;
+    std::vector<Op> unused_ops;
+    DecodedProgram program;
+    CompileArgs args(code.code, decode_cpu, unused_ops, program.instructions);
+    compiler.compile(args);
+    ASSERT_FALSE(args.status.p_err);
+    program.build_blocks();
+
+    // more ants than fit in one batch
+    ulong const num_ants = ProgramBatch::lane_count + 44;
+    std::vector<DualRegisters> single_cpus(num_ants), batch_cpus(num_ants);
+    std::vector<std::unique_ptr<ProgramExecutor>> single_execs, batch_execs;
+    for(ulong i = 0; i < num_ants; ++i) {
+        for(DualRegisters* cpu : {&single_cpus[i], &batch_cpus[i]}) {
+            (*cpu)[1] = static_cast<cpu_word_size>(i * 7);
+            cpu->is_space_empty_flags = static_cast<uchar>(i % 16);
+            cpu->dir_flag1 = i % 3 == 0;
+        }
+        single_execs.push_back(std::make_unique<ProgramExecutor>(
+            instr_clock, max_instructions_per_tick,
+            single_cpus[i].instr_ptr_register, *job_pool));
+        single_execs.back()->use_decoded(single_cpus[i], program);
+        batch_execs.push_back(std::make_unique<ProgramExecutor>(
+            instr_clock, max_instructions_per_tick,
+            batch_cpus[i].instr_ptr_register, *job_pool));
+        batch_execs.back()->use_decoded(batch_cpus[i], program);
+    }
+
+    BatchExecutor batch_executor;
+    for(int tick = 0; tick < 200; ++tick) {
+        batch_executor.clear();
+        for(ulong i = 0; i < num_ants; ++i) {
+            single_execs[i]->reset();
+            single_execs[i]->execute_async();
+            batch_execs[i]->reset();
+            if(batch_execs[i]->begin_async()) {
+                batch_executor.add(*batch_execs[i]);
+            }
+        }
+        ASSERT_LE(batch_executor.size(), 2u);
+        for(ProgramBatch& batch : batch_executor) {
+            AsyncProgramJob job(batch);
+            job_pool->submit_job(job);
+        }
+        waitForAsyncCompletion();
+
+        for(ulong i = 0; i < num_ants; ++i) {
+            single_execs[i]->execute_sync();
+            batch_execs[i]->execute_sync();
+            DualRegisters& expected = single_cpus[i];
+            DualRegisters& actual = batch_cpus[i];
+            expected.is_move_flag = actual.is_move_flag = false;
+            expected.is_dig_flag = actual.is_dig_flag = false;
+
+            ASSERT_EQ(expected.instr_ptr_register, actual.instr_ptr_register)
+                << "tick " << tick << " ant " << i;
+            ASSERT_EQ(expected[0], actual[0]) << "tick " << tick << " ant " << i;
+            ASSERT_EQ(expected[1], actual[1]) << "tick " << tick << " ant " << i;
+            ASSERT_EQ(expected.zero_flag, actual.zero_flag);
+            ASSERT_EQ(expected.instr_failed_flag, actual.instr_failed_flag);
+            ASSERT_EQ(expected.dir_flag1, actual.dir_flag1);
+            ASSERT_EQ(expected.dir_flag2, actual.dir_flag2);
+            ASSERT_EQ(expected.stack_ptr_register, actual.stack_ptr_register);
+            ASSERT_EQ(expected.base_ptr_register, actual.base_ptr_register);
+            ASSERT_EQ(single_execs[i]->instr_trigger,
+                      batch_execs[i]->instr_trigger);
+        }
+    }
+
+    SPDLOG_DEBUG("Batched lanes matched single ant execution for 200 ticks");
+}
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include "hardware/program_executor.hpp"
+#include "hardware/timer_wheel.hpp"
+#include "utils/thread_pool.hpp"
+
+namespace {
+struct Executors {
+    ulong instr_clock = 0;
+    ThreadPool<AsyncProgramJob> job_pool{1};
+    std::vector<ushort> instr_ptrs;
+    std::vector<std::unique_ptr<ProgramExecutor>> list;
+
+    explicit Executors(ulong count) : instr_ptrs(count) {
+        for(ulong i = 0; i < count; ++i) {
+            list.push_back(std::make_unique<ProgramExecutor>(
+                instr_clock, 1, instr_ptrs[i], job_pool));
+        }
+    }
+};
+
+// Advances the wheel to last_tick and records the tick every executor
+// expired on.
+std::vector<ulong> run_until(TimerWheel& wheel, Executors const& executors,
+                             ulong last_tick) {
+    std::vector<ulong> expired_at(executors.list.size(), 0);
+    std::vector<ProgramExecutor*> expired;
+    while(wheel.tick() < last_tick) {
+        expired.clear();
+        wheel.advance(expired);
+        for(ProgramExecutor* exec : expired) {
+            for(ulong i = 0; i < executors.list.size(); ++i) {
+                if(executors.list[i].get() == exec) {
+                    EXPECT_EQ(expired_at[i], 0u) << "expired twice";
+                    expired_at[i] = wheel.tick();
+                }
+            }
+        }
+    }
+    return expired_at;
+}
+}  // namespace
+
+TEST(TimerWheelTest, ExpiresOnDueTickAcrossLevels) {
+    std::vector<ulong> const dues = {1,    2,    63,   64,    65,   127,
+                                     4095, 4096, 4097, 10000, 70000};
+    Executors executors(dues.size());
+    TimerWheel wheel;
+    for(ulong i = 0; i < dues.size(); ++i) {
+        wheel.schedule(*executors.list[i], dues[i]);
+    }
+    EXPECT_EQ(wheel.size(), dues.size());
+
+    EXPECT_EQ(run_until(wheel, executors, 70000), dues);
+    EXPECT_EQ(wheel.size(), 0u);
+}
+
+TEST(TimerWheelTest, SchedulesRelativeToCurrentTick) {
+    Executors executors(4);
+    TimerWheel wheel;
+    std::vector<ProgramExecutor*> expired;
+    for(ulong i = 0; i < 4000; ++i) wheel.advance(expired);
+    ASSERT_TRUE(expired.empty());
+
+    // crosses the level 1 and level 2 boundaries at 4032 and 4096
+    std::vector<ulong> const dues = {4001, 4040, 4100, 4000 + 65536};
+    for(ulong i = 0; i < dues.size(); ++i) {
+        wheel.schedule(*executors.list[i], dues[i]);
+    }
+    EXPECT_EQ(run_until(wheel, executors, dues.back()), dues);
+}
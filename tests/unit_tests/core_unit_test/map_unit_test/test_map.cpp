@@ -1,22 +1,70 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <filesystem>
+#include <random>
+#include <set>
+
+#include "map/baked_world.hpp"
+#include "map/generator.hpp"
 #include "map/map.hpp"
+#include "map/pager.hpp"
 #include "map/world.hpp"
+#include "map/zone_grid.hpp"
 #include "app/globals.hpp"
+#include "utils/parallel.hpp"
+#include "utils/task_graph.hpp"
+#include "utils/thread_pool.hpp"
 
 TEST(MapChunkTest, ChunkConstructorCreatesTiles) {
     Chunk chunk(0, 0, true);
-    EXPECT_EQ(chunk.tiles.size(), static_cast<ulong>(globals::CHUNK_AREA));
+    for(ulong idx = 0; idx < globals::CHUNK_AREA; ++idx) {
+        EXPECT_TRUE(chunk.is_wall(idx));
+        EXPECT_FALSE(chunk.in_fov(idx));
+        EXPECT_EQ(chunk.scents[idx], 0u);
+    }
 }
 
 TEST(MapChunkTest, ChunkProtoRoundTripPreservesWalls) {
     Chunk chunk(0, 0, true);
-    chunk[0].is_wall = false;
+    TileRef{chunk, 0}.set_wall(false);
+    chunk.is_explored_bits = 0x8000000000000001ul;
 
     ant_proto::Chunk msg = chunk.get_proto();
     Chunk restored(msg);
 
-    EXPECT_FALSE(restored[0].is_wall);
+    EXPECT_FALSE(restored.is_wall(0));
+    EXPECT_TRUE(restored.is_wall(1));
+    EXPECT_TRUE(restored.is_explored(63));
+}
+
+TEST(MapChunkTest, RectMaskClipsToChunk) {
+    Chunk chunk(8, -8, true);
+    EXPECT_EQ(chunk.rect_mask(0, 0, 100, 100), 0u);
+    EXPECT_EQ(chunk.rect_mask(0, -100, 100, 100), ~0ul);
+    // columns 1-2 of rows 6-7
+    EXPECT_EQ(chunk.rect_mask(9, -2, 11, 5), 0x0606ul << 48);
+    EXPECT_EQ(chunk.tile_x(63), 15);
+    EXPECT_EQ(chunk.tile_y(63), -1);
+}
+
+TEST(MapChunkTest, SparseTilesKeepFewPointers) {
+    int first = 0, second = 0;
+    SparseTiles<int> tiles;
+    tiles.set(5, &first);
+    tiles.set(60, &second);
+    EXPECT_EQ(tiles.get(5), &first);
+    EXPECT_EQ(tiles.get(60), &second);
+    EXPECT_EQ(tiles.get(6), nullptr);
+    EXPECT_EQ(tiles.tiles(), (1ul << 5) | (1ul << 60));
+
+    tiles.set(5, nullptr);
+    tiles.set(60, &first);
+    EXPECT_EQ(tiles.get(5), nullptr);
+    EXPECT_EQ(tiles.get(60), &first);
+    EXPECT_EQ(tiles.tiles(), 1ul << 60);
 }
 
 TEST(MapChunkTest, ChunksAlignsToChunkLength) {
@@ -32,6 +80,88 @@ TEST(MapChunkTest, ChunkMarkersGeneratedForRect) {
     EXPECT_FALSE(markers.empty());
 }
 
+// The last-hit cache must not answer for another set of chunks or for an
+// erased chunk
+TEST(MapChunkTest, ChunksFindAfterCopyAndErase) {
+    Chunks chunks;
+    Chunk* origin = &chunks.create(0, 0, true);
+    Chunk* negative = &chunks.create(-8, -8, true);
+    EXPECT_EQ(chunks.find(7, 7), origin);
+    EXPECT_EQ(chunks.find(-1, -8), negative);
+    EXPECT_EQ(chunks.find(8, 0), nullptr);
+
+    Chunks copy(chunks);
+    Chunk* right = &copy.create(8, 0, true);
+    EXPECT_EQ(copy.find(9, 1), right);
+    EXPECT_EQ(chunks.find(9, 1), nullptr);
+
+    copy.erase_if([right](Chunk const& chunk) { return &chunk == right; });
+    EXPECT_EQ(copy.find(9, 1), nullptr);
+    EXPECT_EQ(copy.find(0, 0)->x, 0);
+    EXPECT_EQ(copy.size(), 2u);
+
+    for(long idx = 1; idx < 200; ++idx) {
+        chunks.create(0, idx * globals::CHUNK_LENGTH, true);
+    }
+    EXPECT_EQ(chunks.size(), 201u);
+    EXPECT_EQ(chunks.find(3, 1000)->y, 1000);
+    EXPECT_EQ(chunks.find(-3, -3), negative);
+}
+
+// Erased chunks are handed out again, reset, before the arena grows
+TEST(MapChunkTest, ChunksRecycleErasedChunks) {
+    Chunks chunks;
+    for(long idx = 0; idx < 100; ++idx) {
+        Chunk& chunk = chunks.create(idx * globals::CHUNK_LENGTH, 0, true);
+        TileRef{chunk, 3}.set_wall(false);
+        chunk.scents[3] = 7;
+    }
+    ulong const num_slabs = chunks.get_arena().num_slabs();
+
+    for(int round = 0; round < 3; ++round) {
+        chunks.erase_if([](Chunk const&) { return true; });
+        EXPECT_EQ(chunks.size(), 0u);
+        EXPECT_EQ(chunks.get_arena().num_free(), 100u);
+        for(long idx = 0; idx < 100; ++idx) {
+            chunks.create(0, (idx + 1) * -globals::CHUNK_LENGTH, false);
+        }
+    }
+    EXPECT_EQ(chunks.get_arena().num_slabs(), num_slabs);
+    EXPECT_EQ(chunks.get_arena().num_free(), 0u);
+
+    Chunk const* chunk = chunks.find(0, -8);
+    ASSERT_NE(chunk, nullptr);
+    EXPECT_TRUE(chunk->is_wall(3));
+    EXPECT_EQ(chunk->scents[3], 0u);
+    EXPECT_FALSE(chunk->update_parity);
+}
+
+TEST(MapChunkTest, ChunksLinkNeighbours) {
+    long const len = globals::CHUNK_LENGTH;
+    Chunks chunks;
+    Chunk& center = chunks.create(0, 0, true);
+    Chunk& right = chunks.create(len, 0, true);
+    Chunk& below_left = chunks.create(-len, len, true);
+    EXPECT_EQ(center.neighbours[Chunk::neighbour_idx(1, 0)], &right);
+    EXPECT_EQ(right.neighbours[Chunk::neighbour_idx(-1, 0)], &center);
+    EXPECT_EQ(center.neighbours[Chunk::neighbour_idx(-1, 1)], &below_left);
+    EXPECT_EQ(below_left.neighbours[Chunk::neighbour_idx(1, -1)], &center);
+    EXPECT_EQ(center.neighbours[Chunk::neighbour_idx(0, -1)], nullptr);
+    EXPECT_EQ(right.neighbours[Chunk::neighbour_idx(-1, 1)], nullptr);
+
+    Chunks copy(chunks);
+    Chunk* copy_center = copy.find(0, 0);
+    ASSERT_NE(copy_center, nullptr);
+    EXPECT_EQ(copy_center->neighbours[Chunk::neighbour_idx(1, 0)],
+              copy.find(len, 0));
+
+    chunks.erase_if([len](Chunk const& chunk) { return chunk.x == len; });
+    EXPECT_EQ(center.neighbours[Chunk::neighbour_idx(1, 0)], nullptr);
+    EXPECT_EQ(center.neighbours[Chunk::neighbour_idx(-1, 1)], &below_left);
+    Chunk& new_right = chunks.create(len, 0, true);
+    EXPECT_EQ(center.neighbours[Chunk::neighbour_idx(1, 0)], &new_right);
+}
+
 struct ChunkIdCase {
     long x;
     long y;
@@ -98,3 +228,516 @@ TEST(MapTest, CanPlaceRejectsWalls) {
     Map map(true, [](long, long) {});
     EXPECT_FALSE(map.can_place(0, 0));
 }
+
+struct MapRangeJob {
+    ParallelRange const* range;
+    ulong job;
+    MapRangeJob(ParallelRange const& range, ulong job)
+        : range(&range), job(job) {}
+    void run() { range->run_job(job); }
+};
+
+// The pooled loops touch the same tiles as the serial ones and save the
+// same chunks
+TEST(MapTest, PooledTileLoopsMatchSerial) {
+    ThreadPool<MapRangeJob> pool(3);
+    std::vector<std::pair<long, long>> generated;
+    Map serial(true, [](long, long) {});
+    Map pooled(true, [&](long x, long y) { generated.push_back({x, y}); });
+    for(long x = -13; x < 21; ++x) {
+        for(long y = -5; y < 30; ++y) {
+            if((x + y) % 3 == 0) serial.explore(x, y);
+        }
+    }
+    pooled.for_each_chunk(pool, -13, -5, 21, 30,
+                          [](Chunk& chunk, ulong tiles) {
+                              for(ulong idx = 0; idx < 64; ++idx) {
+                                  if((tiles >> idx & 1) == 0) continue;
+                                  long const x = chunk.tile_x(idx);
+                                  if((x + chunk.tile_y(idx)) % 3 != 0) continue;
+                                  chunk.is_explored_bits |= 1ul << idx;
+                                  chunk.in_fov_bits |= 1ul << idx;
+                              }
+                          });
+    // chunks created column by column like the serial scan
+    ASSERT_FALSE(generated.empty());
+    EXPECT_EQ(generated.front(), std::make_pair(-13l, -5l));
+    for(ulong idx = 1; idx < generated.size(); ++idx) {
+        EXPECT_LE(generated[idx - 1].first, generated[idx].first);
+    }
+    EXPECT_EQ(serial.get_proto().SerializeAsString(),
+              pooled.get_proto(pool).SerializeAsString());
+
+    pooled.reset_fov(pool);
+    for(long x = -13; x < 21; ++x) {
+        for(long y = -5; y < 30; ++y) {
+            EXPECT_FALSE(pooled.in_fov(x, y));
+            EXPECT_EQ(pooled.is_explored(x, y), (x + y) % 3 == 0);
+        }
+    }
+}
+
+// Paged out chunks keep their tunnels and scents, are paged back in on
+// use and are still saved
+TEST(MapTest, PagedChunksComeBackOnUse) {
+    ulong generated = 0;
+    Map map(true, [&](long, long) { ++generated; });
+    map.enable_paging((std::filesystem::temp_directory_path() /
+                       "ants_test_map.pages")
+                          .string());
+    ASSERT_NE(map.get_pager(), nullptr);
+    map.dig(-20, -20, 19, 19);
+    map.for_each_chunk(3, 4, 4, 5, [](Chunk& chunk, ulong tiles) {
+        chunk.scents[std::countr_zero(tiles)] = 0xABCD;
+    });
+    ulong const num_chunks = map.num_resident_chunks();
+    ulong const num_generated = generated;
+    ant_proto::Map const saved = map.get_proto();
+
+    map.advance_access_clock();
+    std::vector<Chunk*> cold;
+    map.for_each_cold_chunk([&](Chunk& chunk) { cold.push_back(&chunk); });
+    EXPECT_EQ(cold.size(), num_chunks);
+    map.page_out(cold);
+    EXPECT_EQ(map.num_resident_chunks(), 0u);
+    EXPECT_EQ(map.get_pager()->get_stats().page_outs, num_chunks);
+
+    EXPECT_EQ(map.get_proto().chunks().chunk_key_vals_size(),
+              saved.chunks().chunk_key_vals_size());
+    EXPECT_FALSE(map.is_wall(-20, 19));
+    EXPECT_TRUE(map.is_wall(24, 19));
+    EXPECT_EQ(map.get_tile_scents_by_coord(3, 4), 0xABCDu);
+    EXPECT_EQ(generated, num_generated + 1);  // only the chunk of (24, 19)
+
+    ChunkPagerStats const stats = map.get_pager()->get_stats();
+    EXPECT_EQ(stats.page_ins, 2u);
+    EXPECT_EQ(stats.num_paged, num_chunks - 2);
+    EXPECT_EQ(map.num_resident_chunks(), 3u);
+}
+
+// The read-only queries neither create nor generate chunks, and agree with
+// the mutating ones from several threads
+TEST(MapTest, ReadQueriesCreateNothing) {
+    ulong generated = 0;
+    Map map(true, [&](long, long) { ++generated; });
+    TileSnapshot const missing = map.read_tile(100, -100);
+    EXPECT_TRUE(missing.is_wall);
+    EXPECT_FALSE(missing.is_explored);
+    EXPECT_EQ(missing.scents, 0u);
+    ulong num_read = 0;
+    map.read_chunks(-8, -8, 8, 8, [&](Chunk const& chunk, ulong tiles) {
+        EXPECT_EQ(chunk.is_wall_bits & tiles, tiles);
+        ++num_read;
+    });
+    EXPECT_EQ(num_read, 4u);
+    EXPECT_EQ(map.num_resident_chunks(), 0u);
+    EXPECT_EQ(generated, 0u);
+
+    map.dig(-5, -5, 5, 5);
+    map.explore(2, 3);
+    ulong const num_chunks = map.num_resident_chunks();
+    ThreadPool<MapRangeJob> pool(3);
+    std::vector<uchar> walls(32 * 32);
+    parallel_for(pool, 0, walls.size(), 16, [&](ulong idx) {
+        walls[idx] = map.read_tile(static_cast<long>(idx % 32) - 16,
+                                   static_cast<long>(idx / 32) - 16)
+                         .is_wall;
+    });
+    EXPECT_EQ(map.num_resident_chunks(), num_chunks);
+    EXPECT_TRUE(map.read_tile(2, 3).in_fov);
+    for(ulong idx = 0; idx < walls.size(); ++idx) {
+        long const x = static_cast<long>(idx % 32) - 16;
+        long const y = static_cast<long>(idx / 32) - 16;
+        EXPECT_EQ(walls[idx] != 0, map.is_wall(x, y));
+    }
+}
+
+// A paged out tile is read from the page file and stays paged
+TEST(MapTest, ReadTileOfPagedChunk) {
+    Map map(true, [](long, long) {});
+    map.enable_paging((std::filesystem::temp_directory_path() /
+                       "ants_test_read.pages")
+                          .string());
+    map.dig(0, 0, 7, 7);
+    map.explore(5, 6);
+    map.for_each_chunk(5, 6, 6, 7, [](Chunk& chunk, ulong tiles) {
+        chunk.scents[std::countr_zero(tiles)] = 42;
+    });
+    map.advance_access_clock();
+    std::vector<Chunk*> cold;
+    map.for_each_cold_chunk([&](Chunk& chunk) { cold.push_back(&chunk); });
+    map.page_out(cold);
+
+    TileSnapshot const tile = map.read_tile(5, 6);
+    EXPECT_FALSE(tile.is_wall);
+    EXPECT_TRUE(tile.is_explored);
+    EXPECT_EQ(tile.scents, 42u);
+    EXPECT_EQ(map.read_tile(4, 6).scents, 0u);
+    map.read_chunks(0, 0, 8, 8, [](Chunk const& chunk, ulong) {
+        EXPECT_EQ(chunk.is_wall_bits, 0u);
+    });
+    EXPECT_EQ(map.get_pager()->get_stats().page_ins, 0u);
+    EXPECT_EQ(map.num_resident_chunks(), 0u);
+}
+
+// The spans of a rect cover each of its tiles once, in rows of one chunk
+TEST(MapTest, SpansCoverRectOnce) {
+    Map map(true, [](long, long) {});
+    Rect const rect(-11, -3, 27, 14);
+    std::set<std::pair<long, long>> covered;
+    map.for_each_span(rect, [&](TileSpan const& span) {
+        EXPECT_GT(span.length, 0u);
+        EXPECT_LE(span.idx % globals::CHUNK_LENGTH + span.length,
+                  static_cast<ulong>(globals::CHUNK_LENGTH));
+        EXPECT_EQ(span.chunk.tile_x(span.idx), span.x);
+        EXPECT_EQ(span.chunk.tile_y(span.idx), span.y);
+        for(ulong offset = 0; offset < span.length; ++offset) {
+            long const x = span.x + static_cast<long>(offset);
+            EXPECT_TRUE(covered.insert({x, span.y}).second);
+            EXPECT_TRUE(rect.is_inside(x, span.y));
+        }
+        span.scents()[0] = 1;
+    });
+    EXPECT_EQ(covered.size(), static_cast<ulong>(rect.w * rect.h));
+
+    ulong num_read = 0;
+    map.read_spans(rect, [&](ConstTileSpan const& span) {
+        EXPECT_EQ(span.snapshot(0).scents, 1u);
+        num_read += span.length;
+    });
+    EXPECT_EQ(num_read, covered.size());
+}
+
+TEST(MapTest, StencilMatchesTiles) {
+    Map map(true, [](long, long) {});
+    map.dig(-20, -20, 20, 20);
+    long const len = globals::CHUNK_LENGTH;
+    // a chunk corner, so the stencil spans four chunks
+    TileStencil around = map.get_stencil(len - 1, len - 1);
+    for(long dy = -1; dy <= 1; ++dy) {
+        for(long dx = -1; dx <= 1; ++dx) {
+            around.tile(dx, dy).scents() = static_cast<ulong>(dy * 3 + dx + 5);
+        }
+    }
+    for(long dy = -1; dy <= 1; ++dy) {
+        for(long dx = -1; dx <= 1; ++dx) {
+            EXPECT_EQ(map.get_tile_scents_by_coord(len - 1 + dx, len - 1 + dy),
+                      static_cast<ulong>(dy * 3 + dx + 5));
+        }
+    }
+}
+
+TEST(MapWorldTest, SectionPlanIndexMatchesScan) {
+    Region region(3, 5, Rect(globals::WORLD_LENGTH, -globals::WORLD_LENGTH,
+                             globals::WORLD_LENGTH, globals::WORLD_LENGTH));
+    Rect const& perimeter = region.perimeter;
+    for(long z = 0; z < static_cast<long>(globals::MAX_LEVEL_DEPTH); ++z) {
+        for(long x = perimeter.x1; x <= perimeter.x2; x += 3) {
+            for(long y = perimeter.y1; y <= perimeter.y2; y += 5) {
+                Section_Plan* scanned = nullptr;
+                for(Section_Plan& plan : region.section_plans[z]) {
+                    if(plan.border.is_inside(x, y)) scanned = &plan;
+                }
+                EXPECT_EQ(region.section_plan(x, y, z), scanned);
+            }
+        }
+    }
+    EXPECT_EQ(region.section_plan(perimeter.x1 - 1, perimeter.y1, 0), nullptr);
+    EXPECT_EQ(region.section_plan(perimeter.x1, perimeter.y1, -1), nullptr);
+}
+
+TEST(MapWorldTest, RegionsKeyedByRegion) {
+    long const len = globals::WORLD_LENGTH;
+    Regions regions(7, 11);
+    EXPECT_EQ(&regions.region(len - 1, len - 1), &regions.region(0, 0));
+    for(long idx = -4; idx <= 4; ++idx) {
+        Region& region = regions.region(idx * len + 1, idx * len + 2);
+        EXPECT_EQ(region.perimeter.x1, idx * len);
+        EXPECT_EQ(region.perimeter.y1, idx * len);
+    }
+    EXPECT_EQ(regions.rmap.size(), 9u);
+    EXPECT_NE(&regions.region(-1, 0), &regions.region(0, -1));
+    EXPECT_EQ(regions.rmap.size(), 11u);
+}
+
+TEST(MapWorldTest, QueuedSectionsMatchOnDemandBuilds) {
+    ThreadPool<AsyncProgramJob> pool(2);
+    MapWorld world(Rect(0, 0, 80, 48), true, 7, 11);
+    world.enable_background_generation();
+    world.queue_sections_ahead();
+    SectionGeneratorStats const stats = world.get_generator()->get_stats();
+    ASSERT_GT(stats.queued, 2u);
+
+    // the walls of every queued section, built from its seed on its own
+    std::vector<std::pair<Section_Plan*, Map>> expected;
+    for(auto& [key, region] : world.regions.rmap) {
+        for(Section_Plan& plan : region.section_plans[0]) {
+            if(!plan.is_queued) continue;
+            MapSectionData section(plan.border);
+            TCODRandom rng(plan.seed);
+            plan._generate_section(section, rng);
+            Map map(true, [](long, long) {});
+            map.load_section(section);
+            expected.emplace_back(&plan, std::move(map));
+        }
+    }
+    ASSERT_EQ(expected.size(), stats.queued);
+
+    // one built on demand, the first generated on the pool
+    Section_Plan* on_demand = expected.back().first;
+    world.levels[0].map.create_chunk(on_demand->border.x1,
+                                     on_demand->border.y1);
+    TaskGraph graph;
+    world.add_generation_tasks(graph);
+    graph.run(pool);
+    world.load_generated_sections();
+    SectionGeneratorStats const first_frame =
+        world.get_generator()->get_stats();
+    EXPECT_EQ(first_frame.loaded, 1u);
+    // the window reaches into unplanned regions, one is planned per frame
+    EXPECT_EQ(first_frame.regions_planned, 1u);
+    EXPECT_EQ(world.regions.rmap.size(), 2u);
+    world.queue_sections_ahead();
+    EXPECT_GT(world.get_generator()->get_stats().queued, first_frame.queued);
+
+    ulong num_built = 0;
+    for(auto& [plan, map] : expected) {
+        if(!plan->in_construction) continue;
+        ++num_built;
+        Rect const& border = plan->border;
+        for(long x = border.x1; x <= border.x2; ++x) {
+            for(long y = border.y1; y <= border.y2; ++y) {
+                ASSERT_EQ(world.levels[0].map.is_wall(x, y), map.is_wall(x, y))
+                    << x << ", " << y;
+            }
+        }
+    }
+    EXPECT_EQ(num_built, 2u);
+}
+
+// Every section generated on its own rng - in plan order on one thread and
+// shuffled across a pool, with the global rng drawn from in between - comes
+// out tile for tile the same
+TEST(MapWorldTest, SectionsBuildTheSameInAnyOrder) {
+    Regions regions(7, 11);
+    regions.region(globals::WORLD_LENGTH, 0);
+    regions.region(0, -1);
+    std::vector<std::pair<ulong, Section_Plan*>> plans;
+    for(auto& [key, region] : regions.rmap) {
+        for(ulong z = 0; z < region.section_plans.size(); ++z) {
+            for(Section_Plan& plan : region.section_plans[z]) {
+                plans.emplace_back(z, &plan);
+            }
+        }
+    }
+    ASSERT_GT(plans.size(), 3u);
+    std::set<uint32_t> seeds;
+    for(auto& [z, plan] : plans) seeds.insert(plan->seed);
+    EXPECT_EQ(seeds.size(), plans.size());
+
+    auto make_levels = []() {
+        std::vector<Level> levels;
+        for(ulong z = 0; z < globals::MAX_LEVEL_DEPTH; ++z) {
+            levels.emplace_back(Map(true, [](long, long) {}), z);
+        }
+        return levels;
+    };
+    std::vector<Level> in_order = make_levels();
+    for(auto& [z, plan] : plans) {
+        TCODRandom::getInstance()->getInt(0, 100);
+        plan->build_section(in_order[z]);
+    }
+
+    std::vector<ulong> order(plans.size());
+    for(ulong idx = 0; idx < order.size(); ++idx) order[idx] = idx;
+    std::shuffle(order.begin(), order.end(), std::mt19937(5));
+    std::vector<MapSectionData> sections;
+    for(auto& [z, plan] : plans) sections.emplace_back(plan->border);
+    ThreadPool<MapRangeJob> pool(3);
+    parallel_for(pool, 0, order.size(), 1, [&](ulong idx) {
+        Section_Plan& plan = *plans[order[idx]].second;
+        TCODRandom rng(plan.seed);
+        plan._generate_section(sections[order[idx]], rng);
+    });
+    std::vector<Level> shuffled = make_levels();
+    for(ulong idx : order) {
+        auto& [z, plan] = plans[idx];
+        plan->_load_section(shuffled[z], *plan, sections[idx]);
+    }
+
+    for(auto& [z, plan] : plans) {
+        Rect const& border = plan->border;
+        for(long x = border.x1; x <= border.x2; ++x) {
+            for(long y = border.y1; y <= border.y2; ++y) {
+                ASSERT_EQ(shuffled[z].map.is_wall(x, y),
+                          in_order[z].map.is_wall(x, y))
+                    << x << ", " << y << ", " << z;
+            }
+        }
+    }
+}
+
+namespace {
+struct ShuffleRandomizer {
+    TCODRandom& r;
+    using result_type = uint;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return INT_MAX; }
+    result_type operator()() { return r.getInt(min(), max()); }
+};
+
+// The zone placement of do_blueprint_planning before ZoneGrid - every spot
+// of every level checked chunk by chunk
+std::vector<Zone_Placement> place_zones_by_scan(
+    long length, long depth, std::vector<Zone*> shapes, TCODRandom& randomizer,
+    std::vector<Zone_Placement> placed_zones) {
+    std::vector<bool> taken(length * length * depth);
+    auto at = [&](long x, long y, long z) {
+        return taken[(z * length + x) * length + y];
+    };
+    auto can_place = [&](long x, long y, long z, Zone const& zone) {
+        for(long i = x; i < x + static_cast<long>(zone.w); ++i) {
+            for(long j = y; j < y + static_cast<long>(zone.h); ++j) {
+                for(long k = z; k < z + static_cast<long>(zone.depth); ++k) {
+                    if(at(i, j, k)) return false;
+                }
+            }
+        }
+        return true;
+    };
+    auto place = [&](long x, long y, long z, Zone const& zone) {
+        for(long i = x; i < x + static_cast<long>(zone.w); ++i) {
+            for(long j = y; j < y + static_cast<long>(zone.h); ++j) {
+                for(long k = z; k < z + static_cast<long>(zone.depth); ++k) {
+                    at(i, j, k) = true;
+                }
+            }
+        }
+    };
+    for(Zone_Placement const& zone : placed_zones) {
+        place(zone.chunk_x, zone.chunk_y, zone.chunk_z, *zone.zone);
+    }
+
+    uint failed_attempts = 0;
+    while(failed_attempts < 10) {
+        bool successful_attempt = false;
+        for(Zone* shape : shapes) {
+            bool placed = false;
+            long const w = static_cast<long>(shape->w);
+            long const h = static_cast<long>(shape->h);
+            for(long z = 0; z + static_cast<long>(shape->depth) <= depth;
+                ++z) {
+                for(long x = 0; x <= length - w; ++x) {
+                    for(long y = 0; y <= length - h; ++y) {
+                        if(can_place(x, y, z, *shape)) {
+                            place(x, y, z, *shape);
+                            placed_zones.push_back({x, y, z, shape});
+                            placed = true;
+                            break;
+                        }
+                    }
+                    if(placed) break;
+                }
+            }
+            if(placed) successful_attempt = true;
+        }
+        if(!successful_attempt) failed_attempts++;
+        std::shuffle(shapes.begin(), shapes.end(),
+                     ShuffleRandomizer{randomizer});
+    }
+    return placed_zones;
+}
+}  // namespace
+
+// The bitset placement puts the same zones in the same spots as the chunk
+// by chunk scan - with rows of one word and of several, odd shapes and a
+// zone placed up front
+TEST(MapWorldTest, ZoneGridPlacesLikeScan) {
+    Zone cavern(8, 8, globals::MAX_LEVEL_DEPTH, {}, {});
+    Zone narrow(3, 5, 2, {}, {});
+    Zone flat(7, 2, 4, {}, {});
+    Zone pillar(1, 1, 9, {}, {});
+    for(ulong length : {32ul, 40ul, 64ul, 100ul}) {
+        for(uint32_t seed : {1u, 7u, 12345u}) {
+            std::vector<Zone*> shapes = {&cavern, &narrow, &flat, &pillar};
+            std::vector<Zone_Placement> const start = {{0, 0, 0, &cavern}};
+            TCODRandom scan_rng(seed);
+            std::vector<Zone_Placement> const expected = place_zones_by_scan(
+                static_cast<long>(length), globals::MAX_LEVEL_DEPTH, shapes,
+                scan_rng, start);
+
+            ZoneGrid grid(length, globals::MAX_LEVEL_DEPTH);
+            grid.place(0, 0, 0, cavern.w, cavern.h, cavern.depth);
+            std::vector<Zone_Placement> placed = start;
+            TCODRandom grid_rng(seed);
+            Region::place_zones(grid, shapes, grid_rng, placed);
+
+            ASSERT_EQ(placed.size(), expected.size()) << length << " " << seed;
+            for(ulong idx = 0; idx < placed.size(); ++idx) {
+                EXPECT_EQ(placed[idx].chunk_x, expected[idx].chunk_x);
+                EXPECT_EQ(placed[idx].chunk_y, expected[idx].chunk_y);
+                EXPECT_EQ(placed[idx].chunk_z, expected[idx].chunk_z);
+                EXPECT_EQ(placed[idx].zone, expected[idx].zone);
+            }
+            EXPECT_EQ(grid_rng.getInt(0, INT_MAX), scan_rng.getInt(0, INT_MAX));
+        }
+    }
+}
+
+// A baked world loads the chunks the world builds from the same seeds, on
+// the baked levels of the baked regions, and generates the others
+TEST(MapWorldTest, BakedWorldMatchesGeneratedWorld) {
+    BakeSpec spec;
+    spec.seed_x = 7;
+    spec.seed_y = 11;
+    spec.radius = 1;
+    spec.depth_begin = 1;
+    spec.depth_end = 3;
+    std::string const path =
+        (std::filesystem::temp_directory_path() / "ants_test_world.bake")
+            .string();
+    ThreadPool<MapRangeJob> pool(2);
+    ASSERT_TRUE(BakedWorld::bake(path, spec, pool));
+    std::unique_ptr<BakedWorld> baked = BakedWorld::open(path);
+    std::filesystem::remove(path);
+    ASSERT_NE(baked, nullptr);
+    EXPECT_EQ(baked->size_bytes(),
+              BakedWorld::file_words(spec) * sizeof(ulong));
+
+    MapWorld from_bake(Rect(0, 0, 80, 48), true, std::move(baked));
+    MapWorld generated(Rect(0, 0, 80, 48), true, 7, 11);
+    long const len = globals::WORLD_LENGTH;
+    EXPECT_TRUE(from_bake.is_baked(1, -1, -1));
+    EXPECT_TRUE(from_bake.is_baked(2, 2 * len - 1, 0));
+    EXPECT_FALSE(from_bake.is_baked(0, 0, 0));
+    EXPECT_FALSE(from_bake.is_baked(3, 0, 0));
+    EXPECT_FALSE(from_bake.is_baked(1, 2 * len, 0));
+
+    for(ulong depth = 0; depth < 4; ++depth) {
+        for(long x = -len - 8; x < 2 * len + 8; x += 7) {
+            for(long y = -len - 8; y < 2 * len + 8; y += 5) {
+                ASSERT_EQ(from_bake[depth].map.is_wall(x, y),
+                          generated[depth].map.is_wall(x, y))
+                    << x << ", " << y << ", " << depth;
+            }
+        }
+    }
+    // the baked levels built no section of the origin region
+    Region& origin = from_bake.regions.region(0, 0);
+    for(Section_Plan const& plan : origin.section_plans[1]) {
+        EXPECT_FALSE(plan.in_construction);
+    }
+    EXPECT_TRUE(origin.section_plans[0].front().in_construction);
+}
+
+TEST(MapWorldTest, BakedWorldRejectsOtherFiles) {
+    std::string const path =
+        (std::filesystem::temp_directory_path() / "ants_test_not_baked.bake")
+            .string();
+    std::vector<ulong> words(16, 42);
+    ASSERT_TRUE(BakedWorld::write(path, words));
+    EXPECT_EQ(BakedWorld::open(path), nullptr);
+    std::filesystem::remove(path);
+    EXPECT_EQ(BakedWorld::open(path), nullptr);
+    EXPECT_EQ(BakedWorld::open(""), nullptr);
+}
@@ -289,8 +289,8 @@ class UnitTestRenderer : public Renderer {
    public:
     enum class RenderMode { DEFAULT, SCENT };
 
-    void render_map(LayoutBox const&, Map&, MapWindow const&) override {}
-    void render_ant(LayoutBox const&, Map&, EntityData&,
+    void render_map(LayoutBox const&, Map const&, MapWindow const&) override {}
+    void render_ant(LayoutBox const&, Map const&, EntityData&,
                     MapWindow const&) override {}
     void render_building(LayoutBox const&, Building&,
                          MapWindow const&) override {}
@@ -299,6 +299,8 @@ class UnitTestRenderer : public Renderer {
     void render_help_boxes(LayoutBox const&) override {}
     void render_sidebar(LayoutBox const&, SidebarMenu const&,
                         ClockSpeed) override {}
+    void render_sidebar_stats(LayoutBox const&,
+                              std::vector<std::string> const&) override {}
     void render_toggle_button(bool) override {}
     void present() override {}
     void pixel_to_tile_coordinates(int, int, long& tile_x,
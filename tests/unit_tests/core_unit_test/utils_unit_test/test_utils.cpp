@@ -3,11 +3,16 @@
 #include <filesystem>
 #include <chrono>
 #include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "utils/math.hpp"
+#include "utils/parallel.hpp"
 #include "utils/string.hpp"
 #include "utils/status.hpp"
 #include "utils/serializer.hpp"
+#include "utils/task_graph.hpp"
 #include "utils/thread_pool.hpp"
 #include "proto/utils.pb.h"
 
@@ -187,3 +192,175 @@ TEST(UtilsThreadPoolTest, SubmitsMultipleJobs) {
 
     EXPECT_EQ(count.load(), 2);
 }
+
+TEST(UtilsThreadPoolTest, RunsJobsInlineWithoutThreads) {
+    std::atomic<int> count{0};
+    ThreadPool<SimpleJob> pool(0);
+    for(int i = 0; i < 100; ++i) {
+        SimpleJob job{&count};
+        pool.submit_job(job);
+    }
+    EXPECT_EQ(count.load(), 0);
+    pool.await_jobs();
+
+    EXPECT_EQ(count.load(), 100);
+}
+
+// More jobs than the deques start with, spread over several workers that
+// steal from each other and park between the rounds.
+TEST(UtilsThreadPoolTest, StealsAndParksAcrossRounds) {
+    std::atomic<int> count{0};
+    ThreadPool<SimpleJob> pool(4);
+    for(int round = 0; round < 20; ++round) {
+        for(int i = 0; i < 500; ++i) {
+            SimpleJob job{&count};
+            pool.submit_job(job);
+        }
+        pool.await_jobs();
+        ASSERT_EQ(count.load(), (round + 1) * 500);
+        if(round % 5 == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+}
+
+struct GraphJob {
+    TaskGraph const* graph;
+    TaskGraph::TaskId task;
+    GraphJob(TaskGraph const& graph, TaskGraph::TaskId task)
+        : graph(&graph), task(task) {}
+    void run() { graph->run_task(task); }
+};
+
+TEST(UtilsTaskGraphTest, PlacesTasksAfterTheirDependencies) {
+    TaskGraph graph;
+    auto noop = []() {};
+    TaskGraph::TaskId const a = graph.add("a", noop);
+    TaskGraph::TaskId const b = graph.add("b", noop);
+    TaskGraph::TaskId const c = graph.add("c", noop, {a});
+    graph.add("d", noop, {b, c}, TaskGraph::Affinity::CALLER);
+    graph.add("e", noop, {a});
+
+    std::vector<std::vector<TaskGraph::TaskId>> const expected = {
+        {0, 1}, {2, 4}, {3}};
+    EXPECT_EQ(graph.get_waves(), expected);
+    EXPECT_EQ(graph.describe(),
+              "wave 0: a, b\nwave 1: c, e\nwave 2: d [caller]\n");
+}
+
+// Every task records when it ran - a dependency always ran before
+TEST(UtilsTaskGraphTest, RunsDependenciesFirst) {
+    ThreadPool<GraphJob> pool(4);
+    std::atomic<int> clock{0};
+    std::vector<int> ran_at(40, -1);
+    TaskGraph graph;
+    for(int idx = 0; idx < 40; ++idx) {
+        std::vector<TaskGraph::TaskId> dependencies;
+        if(idx >= 8) dependencies = {static_cast<ulong>(idx - 8)};
+        graph.add("task " + std::to_string(idx),
+                  [&, idx]() { ran_at[idx] = clock.fetch_add(1); },
+                  dependencies);
+    }
+    for(int frame = 0; frame < 10; ++frame) {
+        graph.run(pool);
+        for(int idx = 8; idx < 40; ++idx) {
+            ASSERT_LT(ran_at[idx - 8], ran_at[idx]);
+        }
+    }
+}
+
+TEST(UtilsTaskGraphTest, RunsCallerTasksOnCallingThread) {
+    ThreadPool<GraphJob> pool(2);
+    std::thread::id caller_thread;
+    std::atomic<int> count{0};
+    TaskGraph graph;
+    TaskGraph::TaskId const submit = graph.add(
+        "submit",
+        [&]() {
+            caller_thread = std::this_thread::get_id();
+            count.fetch_add(1);
+        },
+        {}, TaskGraph::Affinity::CALLER);
+    graph.add("after", [&]() { count.fetch_add(1); }, {submit});
+    graph.run(pool);
+
+    EXPECT_EQ(caller_thread, std::this_thread::get_id());
+    EXPECT_EQ(count.load(), 2);
+}
+
+TEST(UtilsThreadPoolTest, StatsCountEveryJob) {
+    std::atomic<int> count{0};
+    ThreadPool<SimpleJob> pool(3);
+    for(int i = 0; i < 300; ++i) {
+        SimpleJob job{&count};
+        pool.submit_job(job);
+    }
+    pool.await_jobs();
+
+    ThreadPoolStats stats = pool.stats();
+    ASSERT_EQ(stats.workers.size(), 3u);
+    ulong jobs = stats.caller.jobs;
+    for(WorkerStats const& worker : stats.workers) {
+        jobs += worker.jobs;
+        EXPECT_LE(worker.steals, worker.jobs);
+        EXPECT_LE(worker.utilization(), 1.0);
+    }
+    EXPECT_EQ(jobs, 300u);
+    EXPECT_EQ(stats.jobs_submitted, 300u);
+    // dealt round robin over the three deques
+    EXPECT_GE(stats.caller.max_queue_depth, 1u);
+    EXPECT_LE(stats.caller.max_queue_depth, 100u);
+    EXPECT_EQ(stats.summary().size(), 5u);
+
+    pool.reset_stats();
+    stats = pool.stats();
+    EXPECT_EQ(stats.jobs_submitted, 0u);
+    EXPECT_EQ(stats.caller.jobs, 0u);
+    EXPECT_EQ(stats.caller.max_queue_depth, 0u);
+}
+
+struct RangeJob {
+    ParallelRange const* range;
+    ulong job;
+    RangeJob(ParallelRange const& range, ulong job) : range(&range), job(job) {}
+    void run() { range->run_job(job); }
+};
+
+// Every index is visited once with either partition, also when the grain
+// does not divide the range
+TEST(UtilsParallelTest, ForVisitsEveryIndexOnce) {
+    for(ulong num_threads : {0ul, 3ul}) {
+        ThreadPool<RangeJob> pool(num_threads);
+        for(Partition partition : {Partition::STATIC, Partition::DYNAMIC}) {
+            std::vector<std::atomic<int>> visits(1000);
+            parallel_for(
+                pool, 0, visits.size(), 7,
+                [&](ulong idx) { visits[idx].fetch_add(1); }, partition);
+            for(std::atomic<int> const& count : visits) {
+                EXPECT_EQ(count.load(), 1);
+            }
+        }
+        int calls = 0;
+        parallel_for(pool, 5, 5, 1, [&](ulong) { ++calls; });
+        EXPECT_EQ(calls, 0);
+    }
+}
+
+TEST(UtilsParallelTest, ReduceMatchesSerialFold) {
+    auto half = [](ulong idx) { return static_cast<double>(idx) * 0.5; };
+    auto add = [](double lhs, double rhs) { return lhs + rhs; };
+    ThreadPool<RangeJob> inline_pool(0);
+    double const expected = parallel_reduce(inline_pool, 0, 10000, 64, 0.0,
+                                            half, add, Partition::STATIC);
+    EXPECT_DOUBLE_EQ(expected, 0.5 * 9999 * 10000 / 2);
+
+    ThreadPool<RangeJob> pool(3);
+    for(int round = 0; round < 5; ++round) {
+        // same chunks, same order - bit for bit the same sum
+        EXPECT_EQ(parallel_reduce(pool, 0, 10000, 64, 0.0, half, add), expected);
+    }
+    EXPECT_EQ(parallel_reduce(pool, 3, 3, 8, 1ul,
+                              [](ulong idx) { return idx; },
+                              [](ulong lhs, ulong rhs) { return lhs * rhs; }),
+              1ul);
+}